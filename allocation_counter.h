@@ -0,0 +1,9 @@
+#pragma once
+
+// Heap allocations made through the global operator new, on any thread, since startup.
+//
+// allocation_counter.cpp replaces operator new / delete with malloc-backed versions that bump
+// a relaxed atomic, so it only counts in executables that link it (the benchmarks, and the app when
+// configured with SPACETIME_COUNT_ALLOCATIONS; the core library leaves the allocator alone). Direct malloc calls, such as a GL driver's,
+// aren't seen.
+unsigned long long allocationCount();
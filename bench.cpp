@@ -0,0 +1,443 @@
+// CPU microbenchmarks for the GL-free core (no window, context or GL library needed).
+//
+// Results go to stdout, or to --out FILE, as JSON in the Google Benchmark layout, so the usual
+// comparison tooling can diff runs across commits. items_per_second is vertices/sec for the
+// mesh builders and operations/sec otherwise. allocations_per_iteration counts heap
+// allocations after the warm-up call; the steady-state cases, the per-frame work of the app,
+// must make none, and the run exits with an error if one does.
+//
+// --filter takes comma-separated substrings and runs the cases whose name contains any of them.
+//
+//   spacetime-bench [--filter SUBSTRING[,SUBSTRING...]] [--min-time SECONDS] [--out FILE]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "allocation_counter.h"
+#include "body_field.h"
+#include "curvature.h"
+#include "grid_culling.h"
+#include "grid_kernel.h"
+#include "grid_topology.h"
+#include "incremental_grid.h"
+#include "lod_grid.h"
+#include "mesh.h"
+#include "mesh_cache.h"
+#include "radial_profile.h"
+#include "satellite_swarm.h"
+#include "simulation.h"
+#include "thread_pool.h"
+#include "transform.h"
+
+namespace {
+
+struct BenchResult {
+    std::string name;
+    long long   iterations;
+    double      nsPerOp;
+    double      itemsPerSecond;
+    const char* itemLabel;
+    double      allocationsPerOp;
+};
+
+volatile float benchSink;
+double minTimeSeconds = 0.2;
+std::vector<std::string> filters;
+std::vector<BenchResult> results;
+std::vector<std::string> allocatingSteadyStateCases;
+
+// Runs op in growing batches until one batch takes at least minTimeSeconds. Returns the
+// result, or null when the filter skipped it.
+template <typename Op>
+const BenchResult* runBenchmark(const std::string& name, double itemsPerOp, const char* itemLabel, Op&& op) {
+    if (!filters.empty() && std::none_of(filters.begin(), filters.end(), [&](const std::string& f) { return name.find(f) != std::string::npos; })) {
+        return nullptr;
+    }
+
+    typedef std::chrono::steady_clock Clock;
+    op();
+
+    long long iterations = 1;
+    long long totalIterations = 0;
+    double elapsed = 0.0;
+    unsigned long long startAllocations = allocationCount();
+    for (;;) {
+        Clock::time_point start = Clock::now();
+        for (long long i = 0; i < iterations; ++i) {
+            op();
+        }
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        totalIterations += iterations;
+        if (elapsed >= minTimeSeconds || iterations >= (1LL << 40)) {
+            break;
+        }
+        iterations *= elapsed > 0.0 ? std::max(2LL, std::min(100LL, (long long)(1.4 * minTimeSeconds / elapsed))) : 100;
+    }
+
+    double allocationsPerOp = (double)(allocationCount() - startAllocations) / totalIterations;
+
+    BenchResult result = { name, iterations, elapsed * 1e9 / iterations, itemsPerOp * iterations / elapsed, itemLabel, allocationsPerOp };
+    std::fprintf(stderr, "%-52s %14.1f ns %16.0f %s/s %10.2f allocs\n", name.c_str(), result.nsPerOp, result.itemsPerSecond, itemLabel, allocationsPerOp);
+    results.push_back(result);
+    return &results.back();
+}
+
+// Steady-state cases reuse their buffers, so once warmed up they must not touch the heap.
+void expectNoAllocations(const BenchResult* result) {
+    if (result && result->allocationsPerOp > 0.0) {
+        std::fprintf(stderr, "  FAIL: %s allocates %.2f times per iteration\n", result->name.c_str(), result->allocationsPerOp);
+        allocatingSteadyStateCases.push_back(result->name);
+    }
+}
+
+void writeResults(FILE* out) {
+    std::fprintf(out, "{\n  \"context\": {\n");
+    std::fprintf(out, "    \"executable\": \"spacetime-bench\",\n");
+    std::fprintf(out, "    \"grid_kernel\": \"%s\",\n", gridKernelName());
+    std::fprintf(out, "    \"num_cpus\": %u\n", std::thread::hardware_concurrency());
+    std::fprintf(out, "  },\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        std::fprintf(out,
+            "    { \"name\": \"%s\", \"iterations\": %lld, \"real_time\": %.3f, \"time_unit\": \"ns\", "
+            "\"items_per_second\": %.1f, \"item_label\": \"%s\", \"allocations_per_iteration\": %.3f }%s\n",
+            r.name.c_str(), r.iterations, r.nsPerOp, r.itemsPerSecond, r.itemLabel, r.allocationsPerOp, i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+}
+
+}
+
+int main(int argc, char** argv) {
+    const char* outPath = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            std::string list = argv[++i];
+            for (size_t start = 0; start <= list.size();) {
+                size_t end = std::min(list.find(',', start), list.size());
+                if (end > start) {
+                    filters.push_back(list.substr(start, end - start));
+                }
+                start = end + 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            minTimeSeconds = std::atof(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+        }
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--filter SUBSTRING[,SUBSTRING...]] [--min-time SECONDS] [--out FILE]" << std::endl;
+            return -1;
+        }
+    }
+
+    const int gridSizes[] = { 200, 1000, 2000, 4000 };
+    const float masses[] = { 0.5f, 5.0f, 50.0f };
+    const float sphereRadius = 5.0f;
+    const float minDeformation = -5.0f;
+
+    std::vector<int> threadCounts = { 1 };
+    int hardwareThreads = (int)std::thread::hardware_concurrency();
+    if (hardwareThreads > 1) {
+        threadCounts.push_back(hardwareThreads);
+    }
+
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+
+    for (int threads : threadCounts) {
+        ThreadPool pool(threads);
+        for (int gridSize : gridSizes) {
+            for (float mass : masses) {
+                char name[128];
+                std::snprintf(name, sizeof(name), "generateGrid/size:%d/mass:%g/threads:%d", gridSize, mass, threads);
+                expectNoAllocations(runBenchmark(name, (double)gridSize * gridSize, "vertices", [&] {
+                    benchSink = generateGrid(vertices, 0.0f, 0.0f, sphereRadius, mass, minDeformation, gridSize, pool);
+                }));
+            }
+        }
+    }
+
+    // Planet plus scattered bodies, as with the app's --bodies.
+    for (int bodyCount : { 1, 100, 1000 }) {
+        std::vector<Body> bodies = { { 0.0f, 0.0f, sphereRadius, 5.0f } };
+        scatterBodies(bodies, bodyCount - 1);
+        BodyBins bins;
+        for (int gridSize : { 200, 1000, 2000 }) {
+            char name[128];
+            std::snprintf(name, sizeof(name), "binBodies/bodies:%d/size:%d", bodyCount, gridSize);
+            expectNoAllocations(runBenchmark(name, bodyCount, "bodies", [&] {
+                binBodies(bodies, gridSize, bins);
+                benchSink = bins.farField;
+            }));
+
+            binBodies(bodies, gridSize, bins);
+            ThreadPool pool(threadCounts.back());
+            std::snprintf(name, sizeof(name), "generateField/bodies:%d/size:%d/threads:%d", bodyCount, gridSize, threadCounts.back());
+            expectNoAllocations(runBenchmark(name, (double)gridSize * gridSize, "vertices", [&] {
+                benchSink = generateField(vertices, bodies, bins, minDeformation, pool);
+            }));
+
+            // The same field through the baked profiles: table lookups instead of sqrt/divide.
+            for (RadialProfile profile : { RadialProfile::Softened, RadialProfile::Plummer, RadialProfile::Flamm }) {
+                ProfileTable table(profile);
+                BodyBins tableBins = bins;
+                tableBins.profile = &table;
+                std::snprintf(name, sizeof(name), "generateField/bodies:%d/size:%d/threads:%d/profile:%s", bodyCount, gridSize, threadCounts.back(), radialProfileName(profile));
+                expectNoAllocations(runBenchmark(name, (double)gridSize * gridSize, "vertices", [&] {
+                    benchSink = generateField(vertices, bodies, tableBins, minDeformation, pool);
+                }));
+            }
+
+            // A planet mass change: only its footprint is recomputed.
+            IncrementalGrid incremental(gridSize);
+            incremental.update(bodies, bins, pool);
+            std::snprintf(name, sizeof(name), "IncrementalGrid::update/bodies:%d/size:%d/threads:%d", bodyCount, gridSize, threadCounts.back());
+            expectNoAllocations(runBenchmark(name, (double)gridSize * gridSize, "vertices", [&] {
+                bodies[0].strength = bodies[0].strength == 5.0f ? 5.5f : 5.0f;
+                binBodies(bodies, gridSize, bins);
+                benchSink = (float)incremental.update(bodies, bins, pool).area();
+            }));
+            bodies[0].strength = 5.0f;
+            binBodies(bodies, gridSize, bins);
+
+            std::snprintf(name, sizeof(name), "computeSettleHeight/bodies:%d/size:%d", bodyCount, gridSize);
+            expectNoAllocations(runBenchmark(name, bodyCount, "bodies", [&] {
+                float lowest = 0.0f;
+                for (int b = 0; b < bodyCount; ++b) {
+                    lowest = std::min(lowest, computeSettleHeight(bodies, b, bins, minDeformation));
+                }
+                benchSink = lowest;
+            }));
+        }
+    }
+
+    // One 60 Hz frame of the swarm: two fixed steps plus the interpolated instance write.
+    for (int satelliteCount : { 10000, 100000 }) {
+        std::vector<Body> bodies = { { 0.0f, 0.0f, sphereRadius, 5.0f } };
+        BodyBins bins;
+        binBodies(bodies, GRID_SIZE, bins);
+        std::vector<float> instances(satelliteCount * 3);
+        for (int threads : threadCounts) {
+            ThreadPool pool(threads);
+            SatelliteSwarm swarm;
+            seedSatellites(swarm, satelliteCount, bodies[0], 10.0f);
+            launchSatellites(swarm, bodies, bins, minDeformation, pool);
+
+            char name[128];
+            std::snprintf(name, sizeof(name), "advanceSatellites/count:%d/threads:%d", satelliteCount, threads);
+            expectNoAllocations(runBenchmark(name, satelliteCount, "satellites", [&] {
+                advanceSatellites(swarm, 2.0f * SATELLITE_TIMESTEP, bodies, bins, minDeformation, pool);
+                writeSatelliteInstances(swarm, 0.3f, instances.data(), pool);
+                benchSink = instances[0];
+            }));
+        }
+    }
+
+    // A whole simulation step as the app runs it, into frames reserved the way SimulationThread
+    // reserves them: the mass changing every frame (the worst case for the CPU grid), and held
+    // (only the satellites move, as when the app idles).
+    {
+        std::vector<Body> bodies = { { 0.0f, 0.0f, sphereRadius, 5.0f } };
+        scatterBodies(bodies, 99);
+        ProfileTable table(RadialProfile::Softened);
+        std::vector<float> lodVertices;
+        GridIndices lodIndices;
+        buildLodGrid(bodies, GridTopology::Lines, lodVertices, lodIndices);
+        ThreadPool pool(threadCounts.back());
+
+        const char* grids[] = { "gpu", "lattice", "lattice-half", "lod" };
+        for (const char* grid : grids) {
+            for (bool held : { false, true }) {
+                bool lod = std::strcmp(grid, "lod") == 0;
+                Simulation simulation(bodies, GRID_SIZE, lod ? lodVertices.data() : nullptr, lodVertices.size() / 3, &table, std::strcmp(grid, "lattice-half") == 0, 1000, 10.0f, 0.3f, minDeformation, pool);
+                SimulationFrame frame;
+                simulation.reserve(frame);
+                SimulationInput input;
+                input.cpuGrid = std::strcmp(grid, "gpu") != 0;
+                input.mass = 5.0f;
+
+                char name[128];
+                std::snprintf(name, sizeof(name), "Simulation::step/%s%s/bodies:100/satellites:1000/threads:%d", grid, held ? "/mass-held" : "", threadCounts.back());
+                expectNoAllocations(runBenchmark(name, 1.0, "steps", [&] {
+                    if (!held) {
+                        input.mass = input.mass == 5.0f ? 5.5f : 5.0f;
+                    }
+                    simulation.step(input, 1.0f / 60.0f, frame);
+                    benchSink = frame.settleY[0];
+                }));
+            }
+        }
+    }
+    vertices = std::vector<float>();
+
+    GridIndices gridIndices;
+    for (GridTopology topology : { GridTopology::Triangles, GridTopology::Lines, GridTopology::LineStrips }) {
+        for (int gridSize : gridSizes) {
+            char name[128];
+            std::snprintf(name, sizeof(name), "buildGridIndices/%s/size:%d", gridTopologyName(topology), gridSize);
+            runBenchmark(name, (double)gridSize * gridSize, "vertices", [&] {
+                buildGridIndices(gridSize, topology, gridIndices);
+                benchSink = (float)gridIndices.count;
+            });
+        }
+    }
+
+    // The app's startup mesh, the flat lattice with its strip indices: built from scratch, or
+    // mapped from a mesh cache file (page cache warm, checksum included) the way a warm start
+    // gets it.
+    {
+        std::error_code error;
+        std::filesystem::path cacheDirectory = std::filesystem::temp_directory_path(error) / "spacetime-bench-cache";
+        ThreadPool pool(threadCounts.back());
+        MappedMesh mapped;
+        for (int gridSize : { 1000, 4000 }) {
+            char name[128];
+            std::snprintf(name, sizeof(name), "meshCache/lattice/size:%d/generate", gridSize);
+            runBenchmark(name, (double)gridSize * gridSize, "vertices", [&] {
+                buildGridIndices(gridSize, GridTopology::LineStrips, gridIndices, GRID_CHUNK_SIZE);
+                benchSink = generateGrid(vertices, 0.0f, 0.0f, sphereRadius, 0.0f, minDeformation, gridSize, pool);
+            });
+
+            std::string path = cacheFilePath(cacheDirectory.string(), (uint64_t)gridSize, ".mesh");
+            if (!writeMeshFile(path, (uint64_t)gridSize, meshView(vertices, gridIndices))) {
+                std::cerr << "Failed to write " << path << std::endl;
+                continue;
+            }
+            vertices = std::vector<float>();
+            gridIndices = GridIndices();
+            std::snprintf(name, sizeof(name), "meshCache/lattice/size:%d/mapped", gridSize);
+            runBenchmark(name, (double)gridSize * gridSize, "vertices", [&] {
+                mapped.open(path, (uint64_t)gridSize);
+                benchSink = mapped.view().vertices[1];
+            });
+            mapped.close();
+            std::filesystem::remove(path, error);
+        }
+    }
+
+    // LOD build cost; the vertex count it reaches is printed alongside (vs 2049^2 uniform).
+    for (int bodyCount : { 1, 10, 100 }) {
+        std::vector<Body> bodies = { { 0.0f, 0.0f, sphereRadius, 5.0f } };
+        scatterBodies(bodies, bodyCount - 1);
+        vertices.clear();
+        char name[128];
+        std::snprintf(name, sizeof(name), "buildLodGrid/bodies:%d", bodyCount);
+        runBenchmark(name, 1.0, "grids", [&] {
+            buildLodGrid(bodies, GridTopology::Lines, vertices, gridIndices);
+            benchSink = (float)gridIndices.count;
+        });
+        if (!vertices.empty()) {
+            std::fprintf(stderr, "  %zu LOD vertices, %.2f%% of a 2049x2049 lattice\n", vertices.size() / 3, 100.0 * (vertices.size() / 3) / (2049.0 * 2049.0));
+        }
+    }
+    vertices = std::vector<float>();
+
+    // Per-frame culling of the chunked lattice from the app's camera, with bounds estimated
+    // from 100 bodies' bins; the fraction of chunks kept is printed alongside.
+    {
+        float view[16], projection[16], viewProjection[16], planes[6][4];
+        lookAtMatrix(0.0f, 20.0f, 40.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, view);
+        perspectiveMatrix(45.0f * PI / 180.0f, 16.0f / 9.0f, 0.1f, 100.0f, projection);
+        multiplyMatrix(view, projection, viewProjection);
+        extractFrustumPlanes(viewProjection, planes);
+
+        std::vector<Body> bodies = { { 0.0f, 0.0f, sphereRadius, 5.0f } };
+        scatterBodies(bodies, 99);
+        BodyBins bins;
+        TileBounds bounds;
+        std::vector<int> visible;
+        for (int gridSize : { 200, 1000, 2000 }) {
+            binBodies(bodies, gridSize, bins);
+            buildGridIndices(gridSize, GridTopology::LineStrips, gridIndices, GRID_CHUNK_SIZE);
+            char name[128];
+            std::snprintf(name, sizeof(name), "cullGridChunks/size:%d", gridSize);
+            expectNoAllocations(runBenchmark(name, (double)gridIndices.chunks.size(), "chunks", [&] {
+                estimateTileBounds(bodies, bins, minDeformation, bounds);
+                visible.clear();
+                benchSink = (float)cullGridChunks(gridIndices.chunks, bins, bounds, planes, visible);
+            }));
+            if (!visible.empty()) {
+                std::fprintf(stderr, "  %zu of %zu chunks visible\n", visible.size(), gridIndices.chunks.size());
+            }
+        }
+    }
+    gridIndices = GridIndices();
+
+    for (int gridSize : gridSizes) {
+        for (float mass : masses) {
+            char name[128];
+            std::snprintf(name, sizeof(name), "computeLowestGridY/size:%d/mass:%g", gridSize, mass);
+            runBenchmark(name, 1.0, "queries", [&] {
+                benchSink = computeLowestGridY(0.0f, 0.0f, sphereRadius, mass, minDeformation, gridSize);
+            });
+        }
+        char name[128];
+        std::snprintf(name, sizeof(name), "computeLowestGridYScan/size:%d/mass:5", gridSize);
+        runBenchmark(name, (double)gridSize * gridSize, "vertices", [&] {
+            benchSink = computeLowestGridYScan(0.0f, 0.0f, sphereRadius, 5.0f, minDeformation, gridSize);
+        });
+    }
+
+    for (int segments : { 20, 30, 100, 500 }) {
+        char name[128];
+        std::snprintf(name, sizeof(name), "generateSphere/segments:%d", segments);
+        expectNoAllocations(runBenchmark(name, (double)(segments + 1) * (segments + 1), "vertices", [&] {
+            generateSphere(vertices, indices, 1.0f, segments);
+            benchSink = vertices[0];
+        }));
+    }
+
+    for (int count : { NUM_STARS, 100000 }) {
+        char name[128];
+        std::snprintf(name, sizeof(name), "generateStars/count:%d", count);
+        runBenchmark(name, count, "vertices", [&] {
+            generateStars(vertices, count);
+            benchSink = vertices[0];
+        });
+    }
+
+    float a[16], b[16], result[16];
+    for (int i = 0; i < 16; ++i) {
+        a[i] = 0.5f + i;
+        b[i] = 1.0f - 0.25f * i;
+    }
+    runBenchmark("multiplyMatrix", 1.0, "ops", [&] {
+        multiplyMatrix(a, b, result);
+        benchSink = result[5];
+        a[0] = result[0] * 1e-9f;
+    });
+    runBenchmark("lookAtMatrix", 1.0, "ops", [&] {
+        lookAtMatrix(0.0f, 20.0f, 40.0f + benchSink * 1e-9f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, result);
+        benchSink = result[14];
+    });
+    runBenchmark("perspectiveMatrix", 1.0, "ops", [&] {
+        perspectiveMatrix(45.0f * PI / 180.0f, 16.0f / 9.0f + benchSink * 1e-9f, 0.1f, 100.0f, result);
+        benchSink = result[0];
+    });
+
+    FILE* out = outPath ? std::fopen(outPath, "w") : stdout;
+    if (!out) {
+        std::cerr << "Failed to write " << outPath << std::endl;
+        return -1;
+    }
+    writeResults(out);
+    if (outPath) {
+        std::fclose(out);
+    }
+    if (!allocatingSteadyStateCases.empty()) {
+        std::cerr << allocatingSteadyStateCases.size() << " steady-state benchmarks allocated on the heap" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,339 @@
+#include "body_field.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <random>
+
+#include "curvature.h"
+#include "grid_kernel.h"
+#include "radial_profile.h"
+#include "thread_pool.h"
+
+namespace {
+
+// Lattice index range [first, last] a world-space interval can touch, widened by one vertex
+// to absorb rounding and one more so that a tile listing a body also covers the 3x3
+// neighbourhood of every vertex the body reaches (computeSettleHeight() relies on it).
+void latticeRange(float low, float high, int gridSize, int& first, int& last) {
+    float halfGrid = gridSize / 2.0f;
+    first = std::max(0, (int)std::floor(low / GRID_SCALE * halfGrid + halfGrid) - 2);
+    last = std::min(gridSize - 1, (int)std::ceil(high / GRID_SCALE * halfGrid + halfGrid) + 2);
+}
+
+float resolveHeight(float deformation, float coveredFarField, float farField, float minDeformation) {
+    float yPos = deformation + (farField - coveredFarField);
+    return yPos < minDeformation ? minDeformation : yPos;
+}
+
+}
+
+void bodyFootprint(const Body& body, int gridSize, int& firstX, int& lastX, int& firstZ, int& lastZ) {
+    float influence = body.radius * 2.5f;
+    latticeRange(body.x - influence, body.x + influence, gridSize, firstX, lastX);
+    latticeRange(body.z - influence, body.z + influence, gridSize, firstZ, lastZ);
+}
+
+void binBodies(const std::vector<Body>& bodies, int gridSize, BodyBins& bins) {
+    int tilesPerSide = (gridSize + BODY_TILE_SIZE - 1) / BODY_TILE_SIZE;
+    bins.gridSize = gridSize;
+    bins.tilesPerSide = tilesPerSide;
+    bins.farField = 0.0f;
+    bins.tileStart.assign(tilesPerSide * tilesPerSide + 1, 0);
+
+    // Count footprints per tile, prefix-sum into offsets, then fill.
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int b = 0; b < (int)bodies.size(); ++b) {
+            int firstX, lastX, firstZ, lastZ;
+            bodyFootprint(bodies[b], gridSize, firstX, lastX, firstZ, lastZ);
+            if (firstX > lastX || firstZ > lastZ) {
+                continue;
+            }
+            for (int tileZ = firstZ / BODY_TILE_SIZE; tileZ <= lastZ / BODY_TILE_SIZE; ++tileZ) {
+                for (int tileX = firstX / BODY_TILE_SIZE; tileX <= lastX / BODY_TILE_SIZE; ++tileX) {
+                    int tile = tileZ * tilesPerSide + tileX;
+                    if (pass == 0)
+                        ++bins.tileStart[tile + 1];
+                    else
+                        bins.bodyIndices[bins.tileStart[tile]++] = b;
+                }
+            }
+        }
+
+        if (pass == 0) {
+            for (int tile = 0; tile < tilesPerSide * tilesPerSide; ++tile) {
+                bins.tileStart[tile + 1] += bins.tileStart[tile];
+            }
+            bins.bodyIndices.resize(bins.tileStart.back());
+        }
+    }
+    // The fill pass advanced every start to the next tile's start; shift them back.
+    for (int tile = tilesPerSide * tilesPerSide; tile > 0; --tile) {
+        bins.tileStart[tile] = bins.tileStart[tile - 1];
+    }
+    bins.tileStart[0] = 0;
+
+    for (const Body& body : bodies) {
+        bins.farField += -body.strength * 0.1f;
+    }
+}
+
+void accumulateBodyField(const float* xs, float zPos, int count, const Body& body, const BodyBins& bins, float* deformation, float* coveredFarField) {
+    if (bins.profile)
+        accumulateBodyRowTable(xs, zPos, count, body.x, body.z, body.radius, body.strength, *bins.profile, deformation, coveredFarField);
+    else
+        accumulateBodyRow(xs, zPos, count, body.x, body.z, body.radius, body.strength, deformation, coveredFarField);
+}
+
+float fieldHeightAt(int x, int z, const std::vector<Body>& bodies, const BodyBins& bins, float minDeformation) {
+    float xPos = gridCoordinate(x, bins.gridSize);
+    float zPos = gridCoordinate(z, bins.gridSize);
+    int tile = (z / BODY_TILE_SIZE) * bins.tilesPerSide + x / BODY_TILE_SIZE;
+
+    float deformation = 0.0f;
+    float coveredFarField = 0.0f;
+    for (int i = bins.tileStart[tile]; i < bins.tileStart[tile + 1]; ++i) {
+        const Body& body = bodies[bins.bodyIndices[i]];
+        accumulateBodyField(&xPos, zPos, 1, body, bins, &deformation, &coveredFarField);
+    }
+    return resolveHeight(deformation, coveredFarField, bins.farField, minDeformation);
+}
+
+float sampleField(float xPos, float zPos, const std::vector<Body>& bodies, const BodyBins& bins, float minDeformation, float& gradX, float& gradZ) {
+    int gridSize = bins.gridSize;
+    float halfGrid = gridSize / 2.0f;
+    int x = std::min(std::max((int)std::floor(xPos / GRID_SCALE * halfGrid + halfGrid), 0), gridSize - 1);
+    int z = std::min(std::max((int)std::floor(zPos / GRID_SCALE * halfGrid + halfGrid), 0), gridSize - 1);
+    int tile = (z / BODY_TILE_SIZE) * bins.tilesPerSide + x / BODY_TILE_SIZE;
+
+    float deformation = 0.0f;
+    float coveredFarField = 0.0f;
+    gradX = 0.0f;
+    gradZ = 0.0f;
+    for (int i = bins.tileStart[tile]; i < bins.tileStart[tile + 1]; ++i) {
+        const Body& body = bodies[bins.bodyIndices[i]];
+        float influence = body.radius * 2.5f;
+        float distX = xPos - body.x;
+        float distZ = zPos - body.z;
+        if (bins.profile) {
+            // depth(u) with u = dist^2 / influence^2, so d/dx is depth'(u) * 2 * distX / influence^2.
+            float u = (distX * distX + distZ * distZ) / (influence * influence);
+            if (u < 1.0f) {
+                deformation += -body.strength * bins.profile->depth(u);
+                coveredFarField += -body.strength * 0.1f;
+                float slope = -body.strength * bins.profile->slope(u) * 2.0f / (influence * influence);
+                gradX += slope * distX;
+                gradZ += slope * distZ;
+            }
+            continue;
+        }
+        float dist = std::sqrt(distX * distX + distZ * distZ);
+        float normalizedDist = dist / influence;
+        if (dist < influence && normalizedDist < 1.0f) {
+            float softened = normalizedDist * normalizedDist + 0.1f;
+            deformation += -body.strength * 2.0f * (1.0f / std::sqrt(softened) - 1.0f);
+            coveredFarField += -body.strength * 0.1f;
+
+            // d/dr of the well is 2 * strength * n / (influence * softened^1.5); times (dx, dz) / r.
+            float slope = 2.0f * body.strength / (influence * influence * softened * std::sqrt(softened));
+            gradX += slope * distX;
+            gradZ += slope * distZ;
+        }
+    }
+
+    float yPos = deformation + (bins.farField - coveredFarField);
+    if (yPos < minDeformation) {
+        gradX = 0.0f;
+        gradZ = 0.0f;
+        return minDeformation;
+    }
+    return yPos;
+}
+
+float generateField(std::vector<float>& vertices, const std::vector<Body>& bodies, const BodyBins& bins, float minDeformation, ThreadPool& pool, TileBounds* bounds) {
+    vertices.resize(bins.gridSize * bins.gridSize * 3);
+    return generateField(vertices.data(), bodies, bins, minDeformation, pool, bounds);
+}
+
+float generateField(float* vertices, const std::vector<Body>& bodies, const BodyBins& bins, float minDeformation, ThreadPool& pool, TileBounds* bounds) {
+    int gridSize = bins.gridSize;
+    const float* rowX = gridCoordinates(gridSize);
+    std::atomic<float> lowest{ 0.0f };
+    int rowsPerBlock = std::max(1, gridSize / (pool.size() * 8));
+    if (bounds) {
+        // Whole tile rows per block, so each tile's range is written by one participant.
+        rowsPerBlock = (rowsPerBlock + BODY_TILE_SIZE - 1) / BODY_TILE_SIZE * BODY_TILE_SIZE;
+        bounds->minY.resize(bins.tilesPerSide * bins.tilesPerSide);
+        bounds->maxY.resize(bins.tilesPerSide * bins.tilesPerSide);
+    }
+
+    pool.parallelFor(gridSize, rowsPerBlock, [&](int, int firstRow, int lastRow) {
+        float deformation[BODY_TILE_SIZE];
+        float coveredFarField[BODY_TILE_SIZE];
+        float lowestY = 0.0f;
+
+        for (int z = firstRow; z < lastRow; ++z) {
+            float zPos = gridCoordinate(z, gridSize);
+            float* row = &vertices[z * gridSize * 3];
+            const int* tileStart = &bins.tileStart[(z / BODY_TILE_SIZE) * bins.tilesPerSide];
+            float* tileMinY = bounds ? &bounds->minY[(z / BODY_TILE_SIZE) * bins.tilesPerSide] : nullptr;
+            float* tileMaxY = bounds ? &bounds->maxY[(z / BODY_TILE_SIZE) * bins.tilesPerSide] : nullptr;
+            if (bounds && z % BODY_TILE_SIZE == 0) {
+                std::fill(tileMinY, tileMinY + bins.tilesPerSide, FLT_MAX);
+                std::fill(tileMaxY, tileMaxY + bins.tilesPerSide, -FLT_MAX);
+            }
+
+            for (int tileX = 0; tileX < bins.tilesPerSide; ++tileX) {
+                int first = tileX * BODY_TILE_SIZE;
+                int count = std::min(BODY_TILE_SIZE, gridSize - first);
+                std::fill(deformation, deformation + count, 0.0f);
+                std::fill(coveredFarField, coveredFarField + count, 0.0f);
+
+                for (int i = tileStart[tileX]; i < tileStart[tileX + 1]; ++i) {
+                    const Body& body = bodies[bins.bodyIndices[i]];
+                    accumulateBodyField(&rowX[first], zPos, count, body, bins, deformation, coveredFarField);
+                }
+
+                float tileLowY = FLT_MAX;
+                float tileHighY = -FLT_MAX;
+                for (int i = 0; i < count; ++i) {
+                    int x = first + i;
+                    float yPos = resolveHeight(deformation[i], coveredFarField[i], bins.farField, minDeformation);
+                    row[x * 3 + 0] = rowX[x];
+                    row[x * 3 + 1] = yPos;
+                    row[x * 3 + 2] = zPos;
+                    tileLowY = std::min(tileLowY, yPos);
+                    tileHighY = std::max(tileHighY, yPos);
+                }
+                lowestY = std::min(lowestY, tileLowY);
+                if (bounds) {
+                    tileMinY[tileX] = std::min(tileMinY[tileX], tileLowY);
+                    tileMaxY[tileX] = std::max(tileMaxY[tileX], tileHighY);
+                }
+            }
+        }
+
+        atomicMin(lowest, lowestY);
+    });
+
+    float lowestY = lowest.load(std::memory_order_relaxed);
+    if (lowestY < minDeformation) {
+        lowestY = minDeformation;
+    }
+    return lowestY;
+}
+
+float generateFieldHeights(float* heights, int firstRow, int lastRow, const std::vector<Body>& bodies, const BodyBins& bins, float minDeformation) {
+    int gridSize = bins.gridSize;
+    const float* rowX = gridCoordinates(gridSize);
+    float deformation[BODY_TILE_SIZE];
+    float coveredFarField[BODY_TILE_SIZE];
+    float lowestY = FLT_MAX;
+
+    for (int z = firstRow; z < lastRow; ++z) {
+        float zPos = gridCoordinate(z, gridSize);
+        float* row = &heights[(size_t)(z - firstRow) * gridSize];
+        const int* tileStart = &bins.tileStart[(z / BODY_TILE_SIZE) * bins.tilesPerSide];
+        for (int tileX = 0; tileX < bins.tilesPerSide; ++tileX) {
+            int first = tileX * BODY_TILE_SIZE;
+            int count = std::min(BODY_TILE_SIZE, gridSize - first);
+            std::fill(deformation, deformation + count, 0.0f);
+            std::fill(coveredFarField, coveredFarField + count, 0.0f);
+
+            for (int i = tileStart[tileX]; i < tileStart[tileX + 1]; ++i) {
+                accumulateBodyField(&rowX[first], zPos, count, bodies[bins.bodyIndices[i]], bins, deformation, coveredFarField);
+            }
+            for (int i = 0; i < count; ++i) {
+                float yPos = resolveHeight(deformation[i], coveredFarField[i], bins.farField, minDeformation);
+                row[first + i] = yPos;
+                lowestY = std::min(lowestY, yPos);
+            }
+        }
+    }
+    return std::max(lowestY, minDeformation);
+}
+
+void estimateTileBounds(const std::vector<Body>& bodies, const BodyBins& bins, float minDeformation, TileBounds& bounds) {
+    int tileCount = bins.tilesPerSide * bins.tilesPerSide;
+    bounds.minY.resize(tileCount);
+    bounds.maxY.resize(tileCount);
+    const float centreWell = bins.profile ? bins.profile->centreDepth() : 2.0f * (1.0f / std::sqrt(0.1f) - 1.0f);
+    const float rimWell = bins.profile ? bins.profile->rimDepth() : 2.0f * (1.0f / std::sqrt(1.1f) - 1.0f);
+
+    for (int tile = 0; tile < tileCount; ++tile) {
+        float low = bins.farField;
+        float high = bins.farField;
+        for (int i = bins.tileStart[tile]; i < bins.tileStart[tile + 1]; ++i) {
+            float strength = bodies[bins.bodyIndices[i]].strength;
+            float atCentre = -strength * centreWell + strength * 0.1f;
+            float atRim = -strength * rimWell + strength * 0.1f;
+            low += std::min(0.0f, std::min(atCentre, atRim));
+            high += std::max(0.0f, std::max(atCentre, atRim));
+        }
+        // Pad for the float rounding of the per-vertex sums.
+        bounds.minY[tile] = std::max(low - 1e-3f, minDeformation);
+        bounds.maxY[tile] = std::max(high + 1e-3f, minDeformation);
+    }
+}
+
+void displaceVertices(const float* flatVertices, int count, float* vertices, const std::vector<Body>& bodies, const BodyBins& bins, float minDeformation, ThreadPool& pool) {
+    pool.parallelFor(count, 4096, [&](int, int first, int last) {
+        for (int i = first; i < last; ++i) {
+            float gradX, gradZ;
+            vertices[i * 3 + 0] = flatVertices[i * 3 + 0];
+            vertices[i * 3 + 1] = sampleField(flatVertices[i * 3 + 0], flatVertices[i * 3 + 2], bodies, bins, minDeformation, gradX, gradZ);
+            vertices[i * 3 + 2] = flatVertices[i * 3 + 2];
+        }
+    });
+}
+
+float computeSettleHeight(const std::vector<Body>& bodies, int bodyIndex, const BodyBins& bins, float minDeformation) {
+    const Body& body = bodies[bodyIndex];
+    int gridSize = bins.gridSize;
+    float halfGrid = gridSize / 2.0f;
+    int nearestX = (int)std::lround(body.x / GRID_SCALE * halfGrid + halfGrid);
+    int nearestZ = (int)std::lround(body.z / GRID_SCALE * halfGrid + halfGrid);
+
+    // Every body reaching the neighbourhood is in the nearest vertex's tile list, so one pass
+    // over that list per row gives the same sums as fieldHeightAt() per vertex.
+    float xs[3];
+    for (int i = 0; i < 3; ++i) {
+        xs[i] = gridCoordinate(std::min(std::max(nearestX - 1 + i, 0), gridSize - 1), gridSize);
+    }
+    int tileX = std::min(std::max(nearestX, 0), gridSize - 1) / BODY_TILE_SIZE;
+    int tileZ = std::min(std::max(nearestZ, 0), gridSize - 1) / BODY_TILE_SIZE;
+    int tile = tileZ * bins.tilesPerSide + tileX;
+
+    float lowestY = 0.0f;
+    for (int z = nearestZ - 1; z <= nearestZ + 1; ++z) {
+        float zPos = gridCoordinate(std::min(std::max(z, 0), gridSize - 1), gridSize);
+        float deformation[3] = { 0.0f, 0.0f, 0.0f };
+        float coveredFarField[3] = { 0.0f, 0.0f, 0.0f };
+        for (int i = bins.tileStart[tile]; i < bins.tileStart[tile + 1]; ++i) {
+            const Body& other = bodies[bins.bodyIndices[i]];
+            accumulateBodyField(xs, zPos, 3, other, bins, deformation, coveredFarField);
+        }
+        for (int i = 0; i < 3; ++i) {
+            lowestY = std::min(lowestY, resolveHeight(deformation[i], coveredFarField[i], bins.farField, minDeformation));
+        }
+    }
+    return lowestY;
+}
+
+void scatterBodies(std::vector<Body>& bodies, int count) {
+    std::mt19937 gen(1234);
+    std::uniform_real_distribution<float> position(-0.8f * GRID_SCALE, 0.8f * GRID_SCALE);
+    std::uniform_real_distribution<float> radius(0.5f, 2.5f);
+    std::uniform_real_distribution<float> strength(0.2f, 2.0f);
+
+    bodies.reserve(bodies.size() + count);
+    for (int i = 0; i < count; ++i) {
+        Body body;
+        body.x = position(gen);
+        body.z = position(gen);
+        body.radius = radius(gen);
+        body.strength = strength(gen);
+        bodies.push_back(body);
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vector>
+
+class ProfileTable;
+class ThreadPool;
+
+const int BODY_TILE_SIZE = 32;
+
+// A massive body on the grid. Its well reaches 2.5 * radius from (x, z); everywhere else it
+// only lowers the grid by its flat far-field offset, -0.1 * strength.
+struct Body {
+    float x;
+    float z;
+    float radius;
+    float strength;
+};
+
+// The superposed field at a vertex is
+//     sum of covering bodies' wells + (sum of all far fields - sum of covering bodies' far fields)
+// clamped to minDeformation, where the covering bodies are those whose influence disk contains
+// the vertex. For a single body this is bit-for-bit the one-body field of curvature.h.
+//
+// The far-field sum is one constant, so a vertex only has to look at the bodies that reach it.
+// BodyBins buckets body footprints into BODY_TILE_SIZE x BODY_TILE_SIZE vertex tiles of the
+// lattice, and cost scales with the footprints overlapping each tile, not bodies x vertices.
+// The lists are stored CSR-style: tile t holds bodyIndices[tileStart[t], tileStart[t + 1]),
+// in ascending body order so every evaluation sums in the same order.
+//
+// profile picks the well shape every evaluation below uses: a baked radial profile
+// (radial_profile.h), or when null the original falloff evaluated exactly as curvature.h does.
+// binBodies() leaves it alone.
+struct BodyBins {
+    int   gridSize = 0;
+    int   tilesPerSide = 0;
+    float farField = 0.0f;
+    const ProfileTable* profile = nullptr;
+    std::vector<int> tileStart;
+    std::vector<int> bodyIndices;
+};
+
+// Height range [minY[t], maxY[t]] of the lattice vertices in each bin tile, for culling.
+struct TileBounds {
+    std::vector<float> minY;
+    std::vector<float> maxY;
+};
+
+// Lattice vertices [firstX, lastX] x [firstZ, lastZ] a body's well can reach, with the same
+// margin the bins use; first > last when it misses the grid.
+void bodyFootprint(const Body& body, int gridSize, int& firstX, int& lastX, int& firstZ, int& lastZ);
+
+// Rebuilds bins for the current bodies, reusing the bins' storage.
+void binBodies(const std::vector<Body>& bodies, int gridSize, BodyBins& bins);
+
+// Adds one body's well to a row of vertices at zPos, as accumulateBodyRow() does, with the
+// bins' profile.
+void accumulateBodyField(const float* xs, float zPos, int count, const Body& body, const BodyBins& bins, float* deformation, float* coveredFarField);
+
+// Superposed height at lattice vertex (x, z).
+float fieldHeightAt(int x, int z, const std::vector<Body>& bodies, const BodyBins& bins, float minDeformation);
+
+// Superposed height at any point of the grid plane, between lattice vertices too, and its
+// gradient (zero where the minDeformation floor applies).
+float sampleField(float xPos, float zPos, const std::vector<Body>& bodies, const BodyBins& bins, float minDeformation, float& gradX, float& gradZ);
+
+// generateGrid() for many bodies: writes gridSize * gridSize xyz vertices tile row by tile row
+// across the pool and returns the lowest height. With bounds, also records the exact height
+// range of every tile.
+float generateField(std::vector<float>& vertices, const std::vector<Body>& bodies, const BodyBins& bins, float minDeformation, ThreadPool& pool, TileBounds* bounds = nullptr);
+float generateField(float* vertices, const std::vector<Body>& bodies, const BodyBins& bins, float minDeformation, ThreadPool& pool, TileBounds* bounds = nullptr);
+
+// Heights alone (gridSize floats per row, row z at heights[(z - firstRow) * gridSize]) for
+// lattice rows [firstRow, lastRow), on the calling thread; returns their lowest height, which
+// is above 0 where negative masses raise the whole range. Lets a caller spread the rows of
+// many fields over one parallelFor, as the sweep tool does.
+float generateFieldHeights(float* heights, int firstRow, int lastRow, const std::vector<Body>& bodies, const BodyBins& bins, float minDeformation);
+
+// Conservative tile height ranges from the bins alone, for when the heights are never
+// computed on the CPU: each listed body can move a vertex by anything between its well's
+// centre and rim values (relative to its far field), or not at all.
+void estimateTileBounds(const std::vector<Body>& bodies, const BodyBins& bins, float minDeformation, TileBounds& bounds);
+
+// Displaces count flat xyz positions (any layout, e.g. the LOD grid) by the superposed field.
+void displaceVertices(const float* flatVertices, int count, float* vertices, const std::vector<Body>& bodies, const BodyBins& bins, float minDeformation, ThreadPool& pool);
+
+// Height a body rests at: the lowest superposed height over the 3x3 lattice vertices around
+// its centre (never above the flat plane). For a single body of non-negative strength this is
+// what computeLowestGridY() returns.
+float computeSettleHeight(const std::vector<Body>& bodies, int bodyIndex, const BodyBins& bins, float minDeformation);
+
+// Appends count smaller bodies scattered over the grid. Seeded, so runs are repeatable.
+void scatterBodies(std::vector<Body>& bodies, int count);
@@ -0,0 +1,163 @@
+#include "curvature.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#include "grid_kernel.h"
+#include "thread_pool.h"
+
+float gridCoordinate(int index, int gridSize) {
+    return (index - gridSize / 2.0f) / (float)(gridSize / 2.0f) * GRID_SCALE;
+}
+
+const float* gridCoordinates(int gridSize) {
+    thread_local std::vector<float> coordinates;
+    thread_local int coordinatesFor = 0;
+    if (coordinatesFor != gridSize) {
+        coordinates.resize(gridSize);
+        for (int x = 0; x < gridSize; ++x) {
+            coordinates[x] = gridCoordinate(x, gridSize);
+        }
+        coordinatesFor = gridSize;
+    }
+    return coordinates.data();
+}
+
+float gridHeightAt(float xPos, float zPos, float sphereX, float sphereZ, float sphereRadius, float sphereStrength, float minDeformation) {
+    float yPos = 0.0f;
+
+    float distX = xPos - sphereX;
+    float distZ = zPos - sphereZ;
+    float dist = std::sqrt(distX * distX + distZ * distZ);
+    float normalizedDist = dist / (sphereRadius * 2.5f);
+
+    if (dist < sphereRadius * 2.5f) {
+        float deformation = -sphereStrength * 2.0f * (1.0f / (std::sqrt(std::pow(normalizedDist, 2.0f) + 0.1f)) - 1.0f);
+
+        if (normalizedDist < 1.0f)
+            yPos = deformation;
+        else
+            yPos = -sphereStrength * 0.1f;
+    }
+    else {
+        yPos = -sphereStrength * 0.1f;
+    }
+
+    if (yPos < minDeformation) {
+        yPos = minDeformation;
+    }
+    return yPos;
+}
+
+float generateGrid(std::vector<float>& vertices, float sphereX, float sphereZ, float sphereRadius, float sphereStrength, float minDeformation, int gridSize, ThreadPool& pool) {
+    vertices.resize(gridSize * gridSize * 3);
+    return generateGrid(vertices.data(), sphereX, sphereZ, sphereRadius, sphereStrength, minDeformation, gridSize, pool);
+}
+
+float generateGrid(float* vertices, float sphereX, float sphereZ, float sphereRadius, float sphereStrength, float minDeformation, int gridSize, ThreadPool& pool) {
+    const float* rowX = gridCoordinates(gridSize);
+
+    const int ROW_CHUNK = 256;
+    std::atomic<float> lowest{ 0.0f };
+    int rowsPerBlock = std::max(1, gridSize / (pool.size() * 8));
+
+    pool.parallelFor(gridSize, rowsPerBlock, [&](int, int firstRow, int lastRow) {
+        float rowY[ROW_CHUNK];
+        float lowestY = 0.0f;
+
+        for (int z = firstRow; z < lastRow; ++z) {
+            float zPos = gridCoordinate(z, gridSize);
+            float* row = &vertices[z * gridSize * 3];
+
+            for (int first = 0; first < gridSize; first += ROW_CHUNK) {
+                int count = std::min(ROW_CHUNK, gridSize - first);
+                computeGridRowHeights(&rowX[first], zPos, count, sphereX, sphereZ, sphereRadius, sphereStrength, minDeformation, rowY);
+
+                for (int i = 0; i < count; ++i) {
+                    int x = first + i;
+                    row[x * 3 + 0] = rowX[x];
+                    row[x * 3 + 1] = rowY[i];
+                    row[x * 3 + 2] = zPos;
+                    lowestY = std::min(lowestY, rowY[i]);
+                }
+            }
+        }
+
+        atomicMin(lowest, lowestY);
+    });
+
+    float lowestY = lowest.load(std::memory_order_relaxed);
+    if (lowestY < minDeformation) {
+        lowestY = minDeformation;
+    }
+    return lowestY;
+}
+
+float computeLowestGridYScan(float sphereX, float sphereZ, float sphereRadius, float sphereStrength, float minDeformation, int gridSize) {
+    float lowestY = 0.0f;
+    for (int z = 0; z < gridSize; ++z) {
+        for (int x = 0; x < gridSize; ++x) {
+            float xPos = (x - gridSize / 2.0f) / (float)(gridSize / 2.0f) * GRID_SCALE;
+            float zPos = (z - gridSize / 2.0f) / (float)(gridSize / 2.0f) * GRID_SCALE;
+
+            float distX = xPos - sphereX;
+            float distZ = zPos - sphereZ;
+            float dist = std::sqrt(distX * distX + distZ * distZ);
+
+            float normalizedDist = dist / (sphereRadius * 2.5f);
+
+            if (dist < sphereRadius * 2.5f) {
+                float deformation = -sphereStrength * 2.0f * (1.0f / (std::sqrt(std::pow(normalizedDist, 2.0f) + 0.1f)) - 1.0f);
+                if (normalizedDist < 1.0f && deformation < lowestY) {
+                    lowestY = deformation;
+                }
+                else if (deformation < lowestY) {
+                    lowestY = -sphereStrength * 0.1f;
+                }
+            }
+            else if ((-sphereStrength * 0.1f) < lowestY) {
+                lowestY = -sphereStrength * 0.1f;
+            }
+
+            if (lowestY < minDeformation) {
+                lowestY = minDeformation;
+            }
+        }
+    }
+    return lowestY;
+}
+
+// For non-negative strength the well deepens monotonically towards the centre, so the
+// minimum sits at the lattice vertex nearest the centre (a 3x3 neighbourhood absorbs
+// rounding ties) or, if any vertex lies outside the influence disk, at the flat far-field
+// height; the farthest vertices are the grid corners.
+float computeLowestGridY(float sphereX, float sphereZ, float sphereRadius, float sphereStrength, float minDeformation, int gridSize) {
+    if (sphereStrength < 0.0f) {
+        return computeLowestGridYScan(sphereX, sphereZ, sphereRadius, sphereStrength, minDeformation, gridSize);
+    }
+
+    float lowestY = 0.0f;
+    float halfGrid = gridSize / 2.0f;
+    int nearestX = (int)std::lround(sphereX / GRID_SCALE * halfGrid + halfGrid);
+    int nearestZ = (int)std::lround(sphereZ / GRID_SCALE * halfGrid + halfGrid);
+    for (int z = nearestZ - 1; z <= nearestZ + 1; ++z) {
+        for (int x = nearestX - 1; x <= nearestX + 1; ++x) {
+            float xPos = gridCoordinate(std::min(std::max(x, 0), gridSize - 1), gridSize);
+            float zPos = gridCoordinate(std::min(std::max(z, 0), gridSize - 1), gridSize);
+            lowestY = std::min(lowestY, gridHeightAt(xPos, zPos, sphereX, sphereZ, sphereRadius, sphereStrength, minDeformation));
+        }
+    }
+
+    const int corners[2] = { 0, gridSize - 1 };
+    for (int z : corners) {
+        for (int x : corners) {
+            lowestY = std::min(lowestY, gridHeightAt(gridCoordinate(x, gridSize), gridCoordinate(z, gridSize), sphereX, sphereZ, sphereRadius, sphereStrength, minDeformation));
+        }
+    }
+
+    if (lowestY < minDeformation) {
+        lowestY = minDeformation;
+    }
+    return lowestY;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+
+class ThreadPool;
+
+const int   GRID_SIZE = 200;
+const float GRID_SCALE = 100.0f;
+// Largest gridSize whose counts fit the ints the grid code and GL draws keep them in; the
+// biggest is the triangle or line index count, about 6 * gridSize^2.
+const int   MAX_GRID_SIZE = 18000;
+
+// The grid is a gridSize x gridSize lattice spanning [-GRID_SCALE, GRID_SCALE) on X and Z,
+// displaced in Y by a clamped radial falloff around the massive body.
+
+// World X (or Z) of lattice column (or row) index.
+float gridCoordinate(int index, int gridSize);
+// gridCoordinate of every index, cached per thread: worked out when gridSize changes, then
+// reused without touching the heap. Valid until the next call on the same thread.
+const float* gridCoordinates(int gridSize);
+
+// Clamped grid height at (xPos, zPos) for a body at (sphereX, sphereZ).
+float gridHeightAt(float xPos, float zPos, float sphereX, float sphereZ, float sphereRadius, float sphereStrength, float minDeformation);
+
+// Builds the grid vertices in row blocks spread over the pool, writing each row straight into
+// its slice of the preallocated buffer (the topology comes from buildGridIndices()). Returns the lowest grid height (what computeLowestGridY() gives
+// for the same body), reduced per participant in the same pass.
+float generateGrid(std::vector<float>& vertices, float sphereX, float sphereZ, float sphereRadius, float sphereStrength, float minDeformation, int gridSize, ThreadPool& pool);
+
+// Same, writing gridSize * gridSize xyz vertices to caller-owned memory such as a mapped GL buffer.
+float generateGrid(float* vertices, float sphereX, float sphereZ, float sphereRadius, float sphereStrength, float minDeformation, int gridSize, ThreadPool& pool);
+
+// Lowest grid height under a body centred at (sphereX, sphereZ) in O(1), without scanning the
+// grid. Returns exactly what computeLowestGridYScan() does.
+float computeLowestGridY(float sphereX, float sphereZ, float sphereRadius, float sphereStrength, float minDeformation, int gridSize);
+
+// Reference O(gridSize^2) scan over every grid vertex.
+float computeLowestGridYScan(float sphereX, float sphereZ, float sphereRadius, float sphereStrength, float minDeformation, int gridSize);
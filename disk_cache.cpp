@@ -0,0 +1,304 @@
+#include "disk_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char CACHE_MAGIC[8] = { 'S', 'T', 'C', 'A', 'C', 'H', 'E', '\0' };
+const uint32_t CACHE_VERSION = 2;
+
+struct CacheHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t tag;
+    uint64_t key;
+    uint64_t size;
+    uint64_t checksum;
+    unsigned char reserved[24];   // pads the payload to a 64-byte boundary
+};
+static_assert(sizeof(CacheHeader) == MappedCacheFile::CACHE_HEADER_SIZE, "cache header must stay 64 bytes");
+
+// A name next to path that no other writer uses: concurrent processes (and threads) warming the
+// same key each write their own file, and the last rename wins with a complete one.
+std::string temporaryPath(const std::string& path) {
+    static std::atomic<unsigned> sequence(0);
+#ifdef _WIN32
+    unsigned long process = GetCurrentProcessId();
+#else
+    unsigned long process = (unsigned long)getpid();
+#endif
+    return path + "." + std::to_string(process) + "." + std::to_string(sequence++) + ".tmp";
+}
+
+const uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+const uint64_t PRIME3 = 0x165667B19E3779F9ull;
+
+uint64_t rotateLeft(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t mixLane(uint64_t lane, uint64_t word) {
+    return rotateLeft(lane + word * PRIME2, 31) * PRIME1;
+}
+
+// checksumBytes() fed in pieces: whole 32-byte stripes go through the four lanes, and a partial
+// stripe waits in tail for the next piece.
+class PayloadChecksum {
+public:
+    void add(const void* data, size_t size) {
+        if (size == 0) {
+            return;
+        }
+        const unsigned char* bytes = (const unsigned char*)data;
+        total += size;
+        if (tailSize > 0) {
+            size_t take = std::min(size, sizeof(tail) - tailSize);
+            std::memcpy(tail + tailSize, bytes, take);
+            tailSize += take;
+            bytes += take;
+            size -= take;
+            if (tailSize < sizeof(tail)) {
+                return;
+            }
+            addStripe(tail);
+            tailSize = 0;
+        }
+        for (; size >= sizeof(tail); bytes += sizeof(tail), size -= sizeof(tail)) {
+            addStripe(bytes);
+        }
+        std::memcpy(tail, bytes, size);
+        tailSize = size;
+    }
+
+    uint64_t finish() const {
+        uint64_t hash = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) + rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+        hash = hashBytes(tail, tailSize, hash ^ total);
+        hash ^= hash >> 33;
+        hash *= PRIME2;
+        hash ^= hash >> 29;
+        return hash;
+    }
+
+private:
+    void addStripe(const unsigned char* stripe) {
+        for (int lane = 0; lane < 4; ++lane) {
+            uint64_t word;
+            std::memcpy(&word, stripe + lane * 8, 8);
+            lanes[lane] = mixLane(lanes[lane], word);
+        }
+    }
+
+    uint64_t lanes[4] = { PRIME1 + PRIME2, PRIME2, 0, PRIME3 };
+    unsigned char tail[32];
+    size_t tailSize = 0;
+    uint64_t total = 0;
+};
+
+bool validHeader(const CacheHeader& header, uint64_t key) {
+    return std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0
+        && header.version == CACHE_VERSION
+        && header.key == key;
+}
+
+}
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t hashString(const char* text, uint64_t seed) {
+    // The terminator is hashed too, so "ab" + "c" and "a" + "bc" differ.
+    return hashBytes(text, std::strlen(text) + 1, seed);
+}
+
+uint64_t checksumBytes(const void* data, size_t size) {
+    PayloadChecksum checksum;
+    checksum.add(data, size);
+    return checksum.finish();
+}
+
+std::string defaultCacheDirectory() {
+#ifdef _WIN32
+    if (const char* local = std::getenv("LOCALAPPDATA")) {
+        return std::string(local) + "\\spacetime-curvature";
+    }
+#else
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME")) {
+        if (*xdg) {
+            return std::string(xdg) + "/spacetime-curvature";
+        }
+    }
+    if (const char* home = std::getenv("HOME")) {
+        return std::string(home) + "/.cache/spacetime-curvature";
+    }
+#endif
+    return std::string();
+}
+
+std::string cacheFilePath(const std::string& directory, uint64_t key, const char* extension) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+    return (std::filesystem::path(directory) / (std::string(name) + extension)).string();
+}
+
+bool readCacheFile(const std::string& path, uint64_t key, uint32_t& tag, std::vector<unsigned char>& payload) {
+    // The header's size is only trusted once it matches the file, so a damaged header can't
+    // make us allocate more than the file holds.
+    std::error_code error;
+    uint64_t fileSize = std::filesystem::file_size(path, error);
+    if (error || fileSize < sizeof(CacheHeader)) {
+        return false;
+    }
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    CacheHeader header;
+    bool valid = std::fread(&header, sizeof(header), 1, file) == 1 && validHeader(header, key)
+        && header.size == fileSize - sizeof(CacheHeader);
+    std::vector<unsigned char> data;
+    if (valid) {
+        data.resize((size_t)header.size);
+        valid = std::fread(data.data(), 1, data.size(), file) == data.size()
+            && std::fgetc(file) == EOF
+            && checksumBytes(data.data(), data.size()) == header.checksum;
+    }
+    std::fclose(file);
+    if (!valid) {
+        return false;
+    }
+    tag = header.tag;
+    payload.swap(data);
+    return true;
+}
+
+bool writeCacheFile(const std::string& path, uint64_t key, uint32_t tag, const void* payload, size_t size) {
+    CachePiece piece = { payload, size };
+    return writeCacheFile(path, key, tag, &piece, 1);
+}
+
+bool writeCacheFile(const std::string& path, uint64_t key, uint32_t tag, const CachePiece* pieces, int count) {
+    std::error_code error;
+    std::filesystem::path target(path);
+    if (target.has_parent_path()) {
+        std::filesystem::create_directories(target.parent_path(), error);
+    }
+
+    CacheHeader header = {};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.tag = tag;
+    header.key = key;
+    PayloadChecksum checksum;
+    for (int i = 0; i < count; ++i) {
+        checksum.add(pieces[i].data, pieces[i].size);
+        header.size += pieces[i].size;
+    }
+    header.checksum = checksum.finish();
+
+    std::string temporary = temporaryPath(path);
+    FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int i = 0; i < count && written; ++i) {
+        written = std::fwrite(pieces[i].data, 1, pieces[i].size, file) == pieces[i].size;
+    }
+    written = std::fclose(file) == 0 && written;
+    if (written) {
+        std::filesystem::rename(temporary, target, error);
+        written = !error;
+    }
+    if (!written) {
+        std::filesystem::remove(temporary, error);
+    }
+    return written;
+}
+
+bool MappedCacheFile::open(const std::string& path, uint64_t key, uint32_t& tag) {
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    bool sized = GetFileSizeEx(file, &fileSize) && (uint64_t)fileSize.QuadPart >= sizeof(CacheHeader);
+    HANDLE view = sized ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    CloseHandle(file);
+    if (!view) {
+        return false;
+    }
+    mapping = MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+    if (!mapping) {
+        CloseHandle(view);
+        return false;
+    }
+    fileMapping = view;
+    mappingSize = (size_t)fileSize.QuadPart;
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+    struct stat status;
+    bool sized = fstat(file, &status) == 0 && (uint64_t)status.st_size >= sizeof(CacheHeader);
+    void* view = sized ? mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+    ::close(file);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    mapping = view;
+    mappingSize = (size_t)status.st_size;
+    // The checksum reads the whole file front to back.
+    madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+#endif
+
+    CacheHeader header;
+    std::memcpy(&header, mapping, sizeof(header));
+    if (!validHeader(header, key) || header.size != payloadSize() || checksumBytes(payload(), payloadSize()) != header.checksum) {
+        close();
+        return false;
+    }
+    tag = header.tag;
+    return true;
+}
+
+void MappedCacheFile::close() {
+    if (!mapping) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(mapping);
+    CloseHandle(fileMapping);
+    fileMapping = nullptr;
+#else
+    munmap(mapping, mappingSize);
+#endif
+    mapping = nullptr;
+    mappingSize = 0;
+}
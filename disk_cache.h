@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Small files of derived data kept between runs, e.g. linked shader binaries.
+//
+// Each file is a 64-byte header (magic, format version, the caller's 64-bit key and tag, payload
+// size and checksum) followed by the payload, so a mapped payload starts 64-byte aligned.
+// readCacheFile() and MappedCacheFile only accept a file whose header and checksum all match, so
+// a stale, truncated or foreign file reads as a miss, never as data. Files are written to a
+// temporary name and renamed into place, so a reader never sees one half-written.
+
+// FNV-1a over size bytes, continuing from seed (pass the result of a previous call to hash
+// several pieces as one).
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+uint64_t hashString(const char* text, uint64_t seed = 14695981039346656037ull);
+
+// $XDG_CACHE_HOME/spacetime-curvature, ~/.cache/spacetime-curvature, or
+// %LOCALAPPDATA%\spacetime-curvature on Windows; empty if none of those is set.
+std::string defaultCacheDirectory();
+
+// <directory>/<key as 16 hex digits><extension>
+std::string cacheFilePath(const std::string& directory, uint64_t key, const char* extension);
+
+// Payload checksum: four interleaved 64-bit multiply-rotate lanes over 8-byte words, several
+// times faster than hashBytes() on large payloads.
+uint64_t checksumBytes(const void* data, size_t size);
+
+// False (and payload untouched) unless path holds a valid file for this key.
+bool readCacheFile(const std::string& path, uint64_t key, uint32_t& tag, std::vector<unsigned char>& payload);
+// Creates the directory if needed. False if the file couldn't be written.
+bool writeCacheFile(const std::string& path, uint64_t key, uint32_t tag, const void* payload, size_t size);
+
+// One contiguous piece of a payload written with the gathering writeCacheFile().
+struct CachePiece {
+    const void* data;
+    size_t      size;
+};
+
+// As above, with the payload given as pieces written back to back, so callers needn't assemble
+// large payloads in memory first.
+bool writeCacheFile(const std::string& path, uint64_t key, uint32_t tag, const CachePiece* pieces, int count);
+
+// A cache file mapped read-only instead of read, so a large payload is used straight from the
+// page cache with no copy. open() checks the header and the payload checksum like
+// readCacheFile(), which touches every page once.
+class MappedCacheFile {
+public:
+    MappedCacheFile() = default;
+    ~MappedCacheFile() { close(); }
+
+    MappedCacheFile(const MappedCacheFile&) = delete;
+    MappedCacheFile& operator=(const MappedCacheFile&) = delete;
+
+    // False (and nothing mapped) unless path holds a valid file for this key.
+    bool open(const std::string& path, uint64_t key, uint32_t& tag);
+    void close();
+
+    bool isOpen() const { return mapping != nullptr; }
+    const unsigned char* payload() const { return (const unsigned char*)mapping + CACHE_HEADER_SIZE; }
+    size_t payloadSize() const { return mappingSize - CACHE_HEADER_SIZE; }
+
+    static const size_t CACHE_HEADER_SIZE = 64;
+
+private:
+    void*  mapping = nullptr;
+    size_t mappingSize = 0;
+#ifdef _WIN32
+    void*  fileMapping = nullptr;
+#endif
+};
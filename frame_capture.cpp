@@ -0,0 +1,85 @@
+#include "frame_capture.h"
+
+#include "frame_writer.h"
+
+#include <chrono>
+
+FrameCapture::FrameCapture(FrameWriter& writer, int width, int height)
+    : writer(writer), width(width), height(height), frameBytes((size_t)width * height * 4) {
+    glGenBuffers(CAPTURE_PBO_COUNT, buffers);
+    for (GLuint buffer : buffers) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+FrameCapture::~FrameCapture() {
+    finish();
+    glDeleteBuffers(CAPTURE_PBO_COUNT, buffers);
+}
+
+void FrameCapture::capture() {
+    auto start = std::chrono::steady_clock::now();
+
+    release(next);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[next]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    fences[next] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    retire((next + CAPTURE_PBO_COUNT - CAPTURE_LATENCY) % CAPTURE_PBO_COUNT);
+    next = (next + 1) % CAPTURE_PBO_COUNT;
+    ++captureStats.frames;
+
+    captureStats.lastMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void FrameCapture::finish() {
+    // Oldest first, so frames reach the writer in order.
+    for (int i = CAPTURE_LATENCY - 1; i >= 0; --i) {
+        retire((next + CAPTURE_PBO_COUNT - 1 - i) % CAPTURE_PBO_COUNT);
+    }
+    for (int slot = 0; slot < CAPTURE_PBO_COUNT; ++slot) {
+        release(slot);
+    }
+}
+
+void FrameCapture::retire(int slot) {
+    GLsync& sync = fences[slot];
+    if (!sync) {
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    GLenum status = glClientWaitSync(sync, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        ++captureStats.stalls;
+        do {
+            status = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        } while (status == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(sync);
+    sync = nullptr;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[slot]);
+    const unsigned char* pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes, GL_MAP_READ_BIT);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    captureStats.waitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (pixels) {
+        tickets[slot] = writer.submit(pixels);
+    }
+}
+
+// Waits for the writer to finish with a mapped slot and unmaps it.
+void FrameCapture::release(int slot) {
+    if (!tickets[slot]) {
+        return;
+    }
+    writer.waitUntilWritten(tickets[slot]);
+    tickets[slot] = 0;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[slot]);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
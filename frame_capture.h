@@ -0,0 +1,52 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstddef>
+
+class FrameWriter;
+
+// Reads each frame back into a ring of pixel pack buffers so glReadPixels only queues a copy
+// instead of stalling until the frame is rendered. A readback is retired CAPTURE_LATENCY frames
+// later, by then normally finished: its fence is waited on and the buffer mapped and handed to
+// the FrameWriter as is, with no copy. The buffer stays mapped until the writer is done with it,
+// which is checked when the ring comes round to it again.
+class FrameCapture {
+public:
+    struct Stats {
+        unsigned long long frames = 0;
+        unsigned long long stalls = 0;    // retires whose readback hadn't finished yet
+        double             waitMs = 0.0;  // total time waiting on fences and mapping
+        double             lastMs = 0.0;  // render-thread cost of the last capture()
+    };
+
+    static const int CAPTURE_PBO_COUNT = 4;
+    static const int CAPTURE_LATENCY = 2;
+
+    FrameCapture(FrameWriter& writer, int width, int height);
+    // Calls finish().
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    // Call after the frame's draws, before the swap.
+    void capture();
+    // Hands every readback still in flight to the writer and waits until it's all written.
+    void finish();
+
+    const Stats& stats() const { return captureStats; }
+
+private:
+    void retire(int slot);
+    void release(int slot);
+
+    FrameWriter& writer;
+    int    width;
+    int    height;
+    size_t frameBytes;
+    GLuint buffers[CAPTURE_PBO_COUNT];
+    GLsync fences[CAPTURE_PBO_COUNT] = {};                   // readback issued, not yet retired
+    unsigned long long tickets[CAPTURE_PBO_COUNT] = {};      // mapped and queued on the writer
+    int    next = 0;
+    Stats  captureStats;
+};
@@ -0,0 +1,261 @@
+#include "frame_report.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+GpuFrameTimer::GpuFrameTimer() {
+    glGenQueries(GPU_TIMER_LATENCY, queries);
+    for (int i = 0; i < GPU_TIMER_LATENCY; ++i) {
+        queryFrames[i] = -1;
+    }
+}
+
+GpuFrameTimer::~GpuFrameTimer() {
+    glDeleteQueries(GPU_TIMER_LATENCY, queries);
+}
+
+void GpuFrameTimer::begin(int frame, std::vector<FrameSample>& samples) {
+    int slot = frame % GPU_TIMER_LATENCY;
+    retire(slot, samples);
+    queryFrames[slot] = frame;
+    glBeginQuery(GL_TIME_ELAPSED, queries[slot]);
+}
+
+void GpuFrameTimer::end() {
+    glEndQuery(GL_TIME_ELAPSED);
+}
+
+void GpuFrameTimer::drain(std::vector<FrameSample>& samples) {
+    for (int slot = 0; slot < GPU_TIMER_LATENCY; ++slot) {
+        retire(slot, samples);
+    }
+}
+
+void GpuFrameTimer::retire(int slot, std::vector<FrameSample>& samples) {
+    int frame = queryFrames[slot];
+    if (frame < 0) {
+        return;
+    }
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &elapsed);
+    if (frame < (int)samples.size()) {
+        samples[frame].gpuMs = elapsed / 1.0e6;
+    }
+    queryFrames[slot] = -1;
+}
+
+namespace {
+
+// The first frames include shader JIT and the initial uploads; they stay in the CSV but are
+// left out of the summary statistics.
+const int REPORT_WARMUP_FRAMES = 3;
+
+struct Percentiles {
+    double p50, p95, p99, mean;
+};
+
+Percentiles computePercentiles(std::vector<double> values) {
+    Percentiles result = { 0.0, 0.0, 0.0, 0.0 };
+    if (values.empty()) {
+        return result;
+    }
+    std::sort(values.begin(), values.end());
+    auto rank = [&](double p) {
+        size_t index = (size_t)(p * (values.size() - 1) + 0.5);
+        return values[std::min(index, values.size() - 1)];
+    };
+    double sum = 0.0;
+    for (double value : values) {
+        sum += value;
+    }
+    result.p50 = rank(0.50);
+    result.p95 = rank(0.95);
+    result.p99 = rank(0.99);
+    result.mean = sum / values.size();
+    return result;
+}
+
+// Escapes text for the inside of a JSON string; the renderer string and the --capture path
+// come from outside and may hold quotes, backslashes or control characters.
+std::string jsonEscape(const char* text) {
+    std::string escaped;
+    for (const char* c = text; *c; ++c) {
+        switch (*c) {
+        case '"':  escaped += "\\\""; break;
+        case '\\': escaped += "\\\\"; break;
+        case '\n': escaped += "\\n"; break;
+        case '\r': escaped += "\\r"; break;
+        case '\t': escaped += "\\t"; break;
+        default:
+            if ((unsigned char)*c < 0x20) {
+                char code[8];
+                std::snprintf(code, sizeof(code), "\\u%04x", (unsigned char)*c);
+                escaped += code;
+            }
+            else {
+                escaped += *c;
+            }
+        }
+    }
+    return escaped;
+}
+
+}
+
+long long steadyStateAllocations(const std::vector<FrameSample>& samples) {
+    long long allocations = 0;
+    for (const FrameSample& sample : samples) {
+        if (sample.frame >= REPORT_WARMUP_FRAMES || (int)samples.size() <= REPORT_WARMUP_FRAMES) {
+            allocations += sample.allocations;
+        }
+    }
+    return allocations;
+}
+
+bool writeFrameReport(const std::string& prefix, const std::vector<FrameSample>& samples, const FrameReportInfo& info) {
+    std::vector<double> cpuTimes;
+    std::vector<double> gpuTimes;
+    std::vector<double> uploadWaits;
+    std::vector<double> simTimes;
+    std::vector<double> inputLatencies;
+    std::vector<double> captureTimes;
+    int uploadStalls = 0;
+    double culledChunks = 0.0;
+    double dirtyVertices = 0.0;
+    double uploadBytes = 0.0;
+    double glCalls = 0.0;
+    double drawCalls = 0.0;
+    double stateChanges = 0.0;
+    for (const FrameSample& sample : samples) {
+        if (sample.frame < REPORT_WARMUP_FRAMES && (int)samples.size() > REPORT_WARMUP_FRAMES) {
+            continue;
+        }
+        cpuTimes.push_back(sample.cpuMs);
+        if (sample.gpuMs >= 0.0) {
+            gpuTimes.push_back(sample.gpuMs);
+        }
+        uploadWaits.push_back(sample.uploadWaitMs);
+        uploadStalls += sample.uploadStalls;
+        culledChunks += sample.culledChunks;
+        dirtyVertices += sample.dirtyVertices;
+        uploadBytes += sample.uploadBytes;
+        glCalls += sample.glCalls;
+        drawCalls += sample.drawCalls;
+        stateChanges += sample.stateChanges;
+        if (sample.simMs >= 0.0) {
+            simTimes.push_back(sample.simMs);
+        }
+        if (sample.inputLatencyMs >= 0.0) {
+            inputLatencies.push_back(sample.inputLatencyMs);
+        }
+        if (sample.captureMs >= 0.0) {
+            captureTimes.push_back(sample.captureMs);
+        }
+    }
+    if (!cpuTimes.empty()) {
+        culledChunks /= cpuTimes.size();
+        dirtyVertices /= cpuTimes.size();
+        uploadBytes /= cpuTimes.size();
+        glCalls /= cpuTimes.size();
+        drawCalls /= cpuTimes.size();
+        stateChanges /= cpuTimes.size();
+    }
+    long long allocations = steadyStateAllocations(samples);
+    Percentiles cpu = computePercentiles(cpuTimes);
+    Percentiles gpu = computePercentiles(gpuTimes);
+    Percentiles upload = computePercentiles(uploadWaits);
+    Percentiles sim = computePercentiles(simTimes);
+    Percentiles latency = computePercentiles(inputLatencies);
+    Percentiles capture = computePercentiles(captureTimes);
+
+    std::string csvPath = prefix + ".csv";
+    FILE* csv = std::fopen(csvPath.c_str(), "w");
+    if (!csv) {
+        std::cerr << "Failed to write " << csvPath << std::endl;
+        return false;
+    }
+    std::fprintf(csv, "frame,mass,cpu_ms,gpu_ms,upload_wait_ms,upload_stalls,culled_chunks,sim_ms,input_latency_ms,dirty_vertices,upload_bytes,allocations,capture_ms,gl_calls,draw_calls,state_changes\n");
+    for (const FrameSample& sample : samples) {
+        std::fprintf(csv, "%d,%.4f,%.4f,%.4f,%.4f,%d,%d,%.4f,%.4f,%d,%d,%d,%.4f,%d,%d,%d\n", sample.frame, sample.mass, sample.cpuMs, sample.gpuMs, sample.uploadWaitMs, sample.uploadStalls, sample.culledChunks,
+            sample.simMs, sample.inputLatencyMs, sample.dirtyVertices, sample.uploadBytes, sample.allocations, sample.captureMs,
+            sample.glCalls, sample.drawCalls, sample.stateChanges);
+    }
+    std::fclose(csv);
+
+    std::string jsonPath = prefix + ".json";
+    FILE* json = std::fopen(jsonPath.c_str(), "w");
+    if (!json) {
+        std::cerr << "Failed to write " << jsonPath << std::endl;
+        return false;
+    }
+    std::fprintf(json,
+        "{\n"
+        "  \"renderer\": \"%s\",\n"
+        "  \"context\": \"%s\",\n"
+        "  \"deformation\": \"%s\",\n"
+        "  \"curvature\": \"%s\",\n"
+        "  \"simulation\": \"%s\",\n"
+        "  \"upload\": \"%s\",\n"
+        "  \"vertex_format\": \"%s\",\n"
+        "  \"grid_size\": %d,\n"
+        "  \"grid_vertices\": %d,\n"
+        "  \"grid_chunks\": %d,\n"
+        "  \"threads\": %d,\n"
+        "  \"bodies\": %d,\n"
+        "  \"startup_ms\": %.1f,\n"
+        "  \"shader_build_ms\": %.1f,\n"
+        "  \"shader_cache\": \"%s\",\n"
+        "  \"shader_cache_hits\": %d,\n"
+        "  \"parallel_shader_compile\": %s,\n"
+        "  \"mesh_build_ms\": %.1f,\n"
+        "  \"mesh_cache\": \"%s\",\n"
+        "  \"mesh_cache_hits\": %d,\n"
+        "  \"lens_scale\": %.2f,\n"
+        "  \"pacing\": { \"mode\": \"%s\", \"max_fps\": %.1f, \"animation_fps\": %.1f, \"swap_interval\": %d, \"seconds\": %.2f, \"frames\": %llu, \"cpu_percent\": %.2f, \"asleep_percent\": %.1f },\n"
+        "  \"frames\": %d,\n"
+        "  \"warmup_frames\": %d,\n"
+        "  \"cpu_ms\": { \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f },\n"
+        "  \"gpu_ms\": { \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f },\n"
+        "  \"upload_wait_ms\": { \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f },\n"
+        "  \"sim_ms\": { \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f },\n"
+        "  \"input_latency_ms\": { \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"count\": %d },\n"
+        "  \"upload_stalls\": %d,\n"
+        "  \"culled_chunks_mean\": %.2f,\n"
+        "  \"dirty_vertices_mean\": %.1f,\n"
+        "  \"upload_bytes_mean\": %.0f,\n"
+        "  \"gl_calls_mean\": %.1f,\n"
+        "  \"draw_calls_mean\": %.1f,\n"
+        "  \"state_changes_mean\": %.1f,\n"
+        "  \"allocations\": %lld,\n"
+        "  \"capture\": \"%s\",\n"
+        "  \"capture_ms\": { \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f },\n"
+        "  \"capture_readback_stalls\": %llu,\n"
+        "  \"capture_writer_stalls\": %llu,\n"
+        "  \"capture_writer_stall_ms\": %.4f,\n"
+        "  \"capture_write_ms_mean\": %.4f\n"
+        "}\n",
+        jsonEscape(info.renderer).c_str(), jsonEscape(info.context).c_str(), jsonEscape(info.deformation).c_str(), jsonEscape(info.curvature).c_str(),
+        jsonEscape(info.simulation).c_str(), jsonEscape(info.upload).c_str(), jsonEscape(info.vertexFormat).c_str(), info.gridSize, info.gridVertices, info.gridChunks, info.threads, info.bodies,
+        info.startupMs, info.shaderBuildMs, jsonEscape(info.shaderCache).c_str(), info.shaderCacheHits, info.parallelShaderCompile ? "true" : "false",
+        info.meshBuildMs, jsonEscape(info.meshCache).c_str(), info.meshCacheHits, info.lensScale,
+        jsonEscape(info.pacing).c_str(), info.maxFps, info.animationFps, info.swapInterval, info.scheduleSeconds, info.scheduleFrames, info.scheduleCpuPercent, info.scheduleSleepPercent,
+        (int)samples.size(), REPORT_WARMUP_FRAMES,
+        cpu.mean, cpu.p50, cpu.p95, cpu.p99,
+        gpu.mean, gpu.p50, gpu.p95, gpu.p99,
+        upload.mean, upload.p50, upload.p95, upload.p99,
+        sim.mean, sim.p50, sim.p95, sim.p99,
+        latency.mean, latency.p50, latency.p95, latency.p99, (int)inputLatencies.size(),
+        uploadStalls, culledChunks, dirtyVertices, uploadBytes, glCalls, drawCalls, stateChanges, allocations,
+        jsonEscape(info.capture).c_str(), capture.mean, capture.p50, capture.p95, capture.p99,
+        info.captureReadbackStalls, info.captureWriterStalls, info.captureWriterStallMs, info.captureWriteMsMean);
+    std::fclose(json);
+
+    std::printf("%d frames | CPU ms p50 %.3f p95 %.3f p99 %.3f | GPU ms p50 %.3f p95 %.3f p99 %.3f | sim ms p50 %.3f | upload stalls %d | culled chunks %.1f/%d | GL calls %.0f (%.0f draws, %.0f state changes) | allocations %lld\n",
+        (int)samples.size(), cpu.p50, cpu.p95, cpu.p99, gpu.p50, gpu.p95, gpu.p99, sim.p50, uploadStalls, culledChunks, info.gridChunks, glCalls, drawCalls, stateChanges, allocations);
+    if (!captureTimes.empty()) {
+        std::printf("Capture %s | ms p50 %.3f p95 %.3f (%.1f%% of CPU frame p50) | readback stalls %llu | writer stalls %llu (%.1f ms) | write ms %.3f/frame\n",
+            info.capture, capture.p50, capture.p95, cpu.p50 > 0.0 ? 100.0 * capture.p50 / cpu.p50 : 0.0, info.captureReadbackStalls, info.captureWriterStalls, info.captureWriterStallMs, info.captureWriteMsMean);
+    }
+    return true;
+}
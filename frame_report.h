@@ -0,0 +1,96 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+
+struct FrameSample {
+    int    frame;
+    float  mass;
+    double cpuMs;
+    double gpuMs;
+    double uploadWaitMs;
+    int    uploadStalls;
+    int    culledChunks;   // grid chunks skipped by frustum culling
+    double simMs;          // simulation step behind a newly shown frame, else -1
+    double inputLatencyMs; // input-to-display latency on the frame that first shows it, else -1
+    int    dirtyVertices;  // CPU lattice vertices recomputed and re-uploaded for a new frame
+    int    uploadBytes;    // CPU grid bytes uploaded for a new frame
+    int    allocations;    // heap allocations over the frame, on any thread; 0 unless counted (allocation_counter.h)
+    double captureMs;      // render-thread time spent in FrameCapture::capture(), else -1
+    int    glCalls;        // draw-side GL calls (see RenderState)
+    int    drawCalls;
+    int    stateChanges;   // binds, polygon mode and uniform changes actually issued
+};
+
+// Times each frame's GL work with GL_TIME_ELAPSED queries kept in a small ring. A query is
+// only read back when its slot comes round again, GPU_TIMER_LATENCY frames later, so the
+// readback does not stall on work the GPU has just been handed.
+class GpuFrameTimer {
+public:
+    static const int GPU_TIMER_LATENCY = 4;
+
+    GpuFrameTimer();
+    ~GpuFrameTimer();
+
+    GpuFrameTimer(const GpuFrameTimer&) = delete;
+    GpuFrameTimer& operator=(const GpuFrameTimer&) = delete;
+
+    // Retires the query last issued in this slot into samples[frame].gpuMs and starts a new one.
+    void begin(int frame, std::vector<FrameSample>& samples);
+    void end();
+    // Reads back every query still in flight.
+    void drain(std::vector<FrameSample>& samples);
+
+private:
+    void retire(int slot, std::vector<FrameSample>& samples);
+
+    GLuint queries[GPU_TIMER_LATENCY];
+    int    queryFrames[GPU_TIMER_LATENCY];
+};
+
+struct FrameReportInfo {
+    const char* renderer;
+    const char* context;
+    const char* deformation;
+    const char* curvature;     // radial profile name
+    const char* simulation;
+    const char* upload;
+    const char* vertexFormat;  // "float" or "compact"
+    int         gridSize;
+    int         gridVertices;
+    int         gridChunks;
+    int         threads;
+    int         bodies;
+    const char* capture;                // --capture path, or "none"
+    unsigned long long captureReadbackStalls;
+    unsigned long long captureWriterStalls;
+    double      captureWriterStallMs;
+    double      captureWriteMsMean;     // writer thread time per frame
+    double      startupMs;              // process start to the first frame finished
+    double      shaderBuildMs;
+    const char* shaderCache;            // "off", "cold", "partial" or "warm"
+    int         shaderCacheHits;
+    bool        parallelShaderCompile;
+    double      meshBuildMs;            // grid and sphere meshes, generated or mapped from the cache
+    const char* meshCache;              // as shaderCache
+    int         meshCacheHits;
+    float       lensScale;              // lensing resolution relative to the frame, 0 with --no-lens
+    const char* pacing;                 // "continuous" or "on demand" (see FrameScheduler)
+    double      maxFps;                 // 0: uncapped
+    double      animationFps;
+    int         swapInterval;
+    // Over the windowed run, or headless over the --idle-seconds phase (0 without one).
+    double      scheduleSeconds;
+    unsigned long long scheduleFrames;
+    double      scheduleCpuPercent;     // process CPU time, all threads, as % of one core
+    double      scheduleSleepPercent;   // time the render loop spent waiting for a frame to be due
+};
+
+// Heap allocations summed over the frames after the warm-up, the ones the report summarises.
+long long steadyStateAllocations(const std::vector<FrameSample>& samples);
+
+// Writes <prefix>.csv (one row per frame) and <prefix>.json (p50/p95/p99 of CPU and GPU frame
+// time, upload waits, simulation steps, input latency and frame capture, the mean culled chunk and GL call counts after the warm-up frames, plus run
+// metadata), and prints the summary. Returns false if either file can't be written.
+bool writeFrameReport(const std::string& prefix, const std::vector<FrameSample>& samples, const FrameReportInfo& info);
@@ -0,0 +1,75 @@
+#include "frame_scheduler.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+FrameScheduler::FrameScheduler(bool continuous, double maxFps, double animationFps)
+    : alwaysDraw(continuous), minInterval(maxFps > 0.0 ? 1.0 / maxFps : 0.0), animationInterval(animationFps > 0.0 ? 1.0 / animationFps : 0.0) {
+}
+
+double FrameScheduler::frameInterval() const {
+    if (alwaysDraw || requested) {
+        return minInterval;
+    }
+    if (animating) {
+        return std::max(minInterval, animationInterval);
+    }
+    return -1.0;
+}
+
+double FrameScheduler::timeUntilFrame(double now) const {
+    double interval = frameInterval();
+    if (interval < 0.0) {
+        return -1.0;
+    }
+    if (!started) {
+        return 0.0;
+    }
+    return std::max(0.0, lastFrame + interval - now);
+}
+
+void FrameScheduler::beginFrame(double now) {
+    double interval = frameInterval();
+    // Stay on the interval's grid while frames keep up; after a late frame or an idle spell,
+    // start again from now rather than drawing a burst to catch up.
+    if (started && interval > 0.0 && now - lastFrame < 2.0 * interval) {
+        lastFrame += interval;
+    }
+    else {
+        lastFrame = now;
+    }
+    started = true;
+    requested = false;
+    ++schedulerStats.frames;
+}
+
+void FrameScheduler::recordWait(double seconds) {
+    schedulerStats.waitSeconds += seconds;
+    ++schedulerStats.waits;
+}
+
+double processCpuSeconds() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        return 0.0;
+    }
+    auto seconds = [](const FILETIME& time) {
+        return (((unsigned long long)time.dwHighDateTime << 32) | time.dwLowDateTime) * 1.0e-7;
+    };
+    return seconds(kernel) + seconds(user);
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0.0;
+    }
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1.0e-6;
+#endif
+}
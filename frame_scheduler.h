@@ -0,0 +1,51 @@
+#pragma once
+
+// Decides when the render loop draws its next frame.
+//
+// Continuous, it draws back to back, paced only by the swap interval and the frame cap, as the
+// loop always did. On demand, a frame is only due when something on screen has changed: an
+// input or window event (requestFrame()), or a running animation (the satellites), which is
+// drawn at its own, lower rate. In between the loop sleeps, in glfwWaitEventsTimeout so an
+// event ends the wait early. Due times are kept on a fixed grid of the frame interval, so
+// oversleeping one frame doesn't push back the next.
+class FrameScheduler {
+public:
+    struct Stats {
+        unsigned long long frames = 0;
+        unsigned long long waits = 0;     // more than frames when events wake the loop early
+        double             waitSeconds = 0.0;
+    };
+
+    // maxFps caps every frame (0: only the swap interval paces them); animationFps is the rate
+    // while an animation is all that's changing.
+    FrameScheduler(bool continuous, double maxFps, double animationFps);
+
+    // Something on screen must be redrawn: input, a resize, an exposed window.
+    void requestFrame() { requested = true; }
+    void setAnimating(bool running) { animating = running; }
+
+    // Seconds from now until the next frame is due: 0 to draw now, negative when none is and
+    // the loop can wait for an event.
+    double timeUntilFrame(double now) const;
+    // Call as each frame starts, with the time timeUntilFrame() last returned 0 for.
+    void beginFrame(double now);
+    void recordWait(double seconds);
+
+    bool continuous() const { return alwaysDraw; }
+    const Stats& stats() const { return schedulerStats; }
+
+private:
+    double frameInterval() const;
+
+    bool   alwaysDraw;
+    double minInterval;        // 1 / maxFps, or 0
+    double animationInterval;
+    bool   requested = true;   // the first frame is always drawn
+    bool   animating = false;
+    bool   started = false;
+    double lastFrame = 0.0;
+    Stats  schedulerStats;
+};
+
+// CPU time the process has used so far, summed over its threads, in seconds.
+double processCpuSeconds();
@@ -0,0 +1,278 @@
+#include "frame_writer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const unsigned char PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+const size_t DEFLATE_STORED_BLOCK = 65535;
+
+struct Crc32Table {
+    unsigned int entries[256];
+    Crc32Table() {
+        for (unsigned int n = 0; n < 256; ++n) {
+            unsigned int c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            entries[n] = c;
+        }
+    }
+};
+
+unsigned int crc32(const unsigned char* data, size_t size, unsigned int crc = 0) {
+    static const Crc32Table table;
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+unsigned int adler32(const unsigned char* data, size_t size) {
+    // 5552 is the longest run whose sums can't overflow 32 bits before the modulo.
+    unsigned int a = 1, b = 0;
+    while (size > 0) {
+        size_t run = std::min<size_t>(size, 5552);
+        for (size_t i = 0; i < run; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += run;
+        size -= run;
+    }
+    return (b << 16) | a;
+}
+
+unsigned char* putBigEndian(unsigned char* out, unsigned int value) {
+    out[0] = (unsigned char)(value >> 24);
+    out[1] = (unsigned char)(value >> 16);
+    out[2] = (unsigned char)(value >> 8);
+    out[3] = (unsigned char)value;
+    return out + 4;
+}
+
+// Chunk length, type and data are already at chunk; appends the CRC and returns the end.
+unsigned char* finishChunk(unsigned char* chunk, size_t dataSize) {
+    putBigEndian(chunk, (unsigned int)dataSize);
+    return putBigEndian(chunk + 8 + dataSize, crc32(chunk + 4, dataSize + 4));
+}
+
+bool endsWith(const std::string& text, const char* suffix) {
+    size_t length = std::strlen(suffix);
+    return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+}
+
+FrameWriter::FrameWriter(const std::string& path, int width, int height, int framesPerSecond)
+    : width(width), height(height), y4m(endsWith(path, ".y4m")) {
+    if (y4m) {
+        int chromaSize = ((width + 1) / 2) * ((height + 1) / 2);
+        encoded.resize((size_t)width * height + 2 * chromaSize);
+        video = std::fopen(path.c_str(), "wb");
+        if (!video || std::fprintf(video, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, framesPerSecond) < 0) {
+            std::cerr << "Failed to write " << path << std::endl;
+            frameStats.failed = true;
+        }
+    }
+    else {
+        pngPrefix = endsWith(path, ".png") ? path.substr(0, path.size() - 4) : path;
+        fileName.resize(pngPrefix.size() + 32);
+        scanlines.resize((size_t)height * (1 + (size_t)width * 3));
+        size_t blocks = std::max<size_t>(1, (scanlines.size() + DEFLATE_STORED_BLOCK - 1) / DEFLATE_STORED_BLOCK);
+        size_t zlibSize = 2 + scanlines.size() + blocks * 5 + 4;
+        encoded.resize(sizeof(PNG_SIGNATURE) + (12 + 13) + (12 + zlibSize) + 12);
+    }
+
+    worker = std::thread(&FrameWriter::run, this);
+}
+
+FrameWriter::~FrameWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    frameQueued.notify_one();
+    worker.join();
+    if (video) {
+        std::fclose(video);
+    }
+}
+
+unsigned long long FrameWriter::submit(const unsigned char* rgba) {
+    unsigned long long ticket;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (queued == FRAME_WRITER_QUEUE) {
+            auto start = std::chrono::steady_clock::now();
+            ++frameStats.stalls;
+            frameWritten.wait(lock, [&] { return queued < FRAME_WRITER_QUEUE; });
+            frameStats.stallMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+        queue[(queueHead + queued++) % FRAME_WRITER_QUEUE] = rgba;
+        ticket = ++frameStats.submitted;
+    }
+    frameQueued.notify_one();
+    return ticket;
+}
+
+void FrameWriter::waitUntilWritten(unsigned long long ticket) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (frameStats.written < ticket) {
+        auto start = std::chrono::steady_clock::now();
+        ++frameStats.stalls;
+        frameWritten.wait(lock, [&] { return frameStats.written >= ticket; });
+        frameStats.stallMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+FrameWriter::Stats FrameWriter::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return frameStats;
+}
+
+void FrameWriter::run() {
+    for (;;) {
+        const unsigned char* rgba;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            frameQueued.wait(lock, [&] { return queued > 0 || stopping; });
+            if (queued == 0) {
+                return;
+            }
+            rgba = queue[queueHead];
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        bool failed = !writeFrame(rgba);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queueHead = (queueHead + 1) % FRAME_WRITER_QUEUE;
+            --queued;
+            ++frameStats.written;
+            frameStats.writeMs += ms;
+            if (!failed) {
+                frameStats.bytes += encoded.size();
+            }
+            else if (!frameStats.failed) {
+                std::cerr << "Failed to write captured frame " << frameNumber - 1 << std::endl;
+                frameStats.failed = true;
+            }
+        }
+        frameWritten.notify_all();
+    }
+}
+
+bool FrameWriter::writeFrame(const unsigned char* rgba) {
+    ++frameNumber;
+    return y4m ? writeY4mFrame(rgba) : writePngFrame(rgba);
+}
+
+bool FrameWriter::writeY4mFrame(const unsigned char* rgba) {
+    if (!video) {
+        return false;
+    }
+    // Integer BT.601 studio-range conversion; chroma averages each 2x2 block. Rows are flipped
+    // from glReadPixels' bottom-up order.
+    int chromaWidth = (width + 1) / 2;
+    int chromaHeight = (height + 1) / 2;
+    unsigned char* yPlane = encoded.data();
+    unsigned char* uPlane = yPlane + (size_t)width * height;
+    unsigned char* vPlane = uPlane + (size_t)chromaWidth * chromaHeight;
+    size_t stride = (size_t)width * 4;
+
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* row = rgba + (height - 1 - y) * stride;
+        unsigned char* out = yPlane + (size_t)y * width;
+        for (int x = 0; x < width; ++x) {
+            int r = row[x * 4], g = row[x * 4 + 1], b = row[x * 4 + 2];
+            out[x] = (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        }
+    }
+    for (int cy = 0; cy < chromaHeight; ++cy) {
+        const unsigned char* row0 = rgba + (height - 1 - 2 * cy) * stride;
+        const unsigned char* row1 = rgba + (height - 1 - std::min(2 * cy + 1, height - 1)) * stride;
+        for (int cx = 0; cx < chromaWidth; ++cx) {
+            int x0 = cx * 8;
+            int x1 = std::min(2 * cx + 1, width - 1) * 4;
+            int r = row0[x0] + row0[x1] + row1[x0] + row1[x1];
+            int g = row0[x0 + 1] + row0[x1 + 1] + row1[x0 + 1] + row1[x1 + 1];
+            int b = row0[x0 + 2] + row0[x1 + 2] + row1[x0 + 2] + row1[x1 + 2];
+            uPlane[cy * chromaWidth + cx] = (unsigned char)(((-38 * r - 74 * g + 112 * b + 512) >> 10) + 128);
+            vPlane[cy * chromaWidth + cx] = (unsigned char)(((112 * r - 94 * g - 18 * b + 512) >> 10) + 128);
+        }
+    }
+
+    return std::fwrite("FRAME\n", 1, 6, video) == 6 && std::fwrite(encoded.data(), 1, encoded.size(), video) == encoded.size();
+}
+
+bool FrameWriter::writePngFrame(const unsigned char* rgba) {
+    // Scanlines top row first, each behind a "None" filter byte.
+    size_t rowBytes = 1 + (size_t)width * 3;
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* row = rgba + (size_t)(height - 1 - y) * width * 4;
+        unsigned char* out = &scanlines[y * rowBytes];
+        *out++ = 0;
+        for (int x = 0; x < width; ++x) {
+            *out++ = row[x * 4];
+            *out++ = row[x * 4 + 1];
+            *out++ = row[x * 4 + 2];
+        }
+    }
+
+    unsigned char* out = encoded.data();
+    std::memcpy(out, PNG_SIGNATURE, sizeof(PNG_SIGNATURE));
+    out += sizeof(PNG_SIGNATURE);
+
+    unsigned char* chunk = out;
+    std::memcpy(chunk + 4, "IHDR", 4);
+    unsigned char* header = putBigEndian(putBigEndian(chunk + 8, width), height);
+    const unsigned char format[5] = { 8, 2, 0, 0, 0 };   // 8-bit RGB, deflate, no interlace
+    std::memcpy(header, format, sizeof(format));
+    out = finishChunk(chunk, 13);
+
+    // zlib stream of stored deflate blocks.
+    chunk = out;
+    std::memcpy(chunk + 4, "IDAT", 4);
+    unsigned char* zlib = chunk + 8;
+    unsigned char* data = zlib;
+    *data++ = 0x78;
+    *data++ = 0x01;
+    size_t remaining = scanlines.size();
+    const unsigned char* source = scanlines.data();
+    do {
+        size_t length = std::min(remaining, DEFLATE_STORED_BLOCK);
+        remaining -= length;
+        *data++ = remaining == 0 ? 1 : 0;
+        data[0] = (unsigned char)length;
+        data[1] = (unsigned char)(length >> 8);
+        data[2] = (unsigned char)~length;
+        data[3] = (unsigned char)(~length >> 8);
+        std::memcpy(data + 4, source, length);
+        data += 4 + length;
+        source += length;
+    } while (remaining > 0);
+    data = putBigEndian(data, adler32(scanlines.data(), scanlines.size()));
+    out = finishChunk(chunk, data - zlib);
+
+    chunk = out;
+    std::memcpy(chunk + 4, "IEND", 4);
+    out = finishChunk(chunk, 0);
+
+    std::snprintf(fileName.data(), fileName.size(), "%s_%05llu.png", pngPrefix.c_str(), frameNumber - 1);
+    FILE* file = std::fopen(fileName.data(), "wb");
+    if (!file) {
+        return false;
+    }
+    size_t size = out - encoded.data();
+    bool written = std::fwrite(encoded.data(), 1, size, file) == size;
+    return std::fclose(file) == 0 && written;
+}
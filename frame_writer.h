@@ -0,0 +1,79 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Streams captured frames to disk on its own thread, so encoding and file I/O never run on the
+// render thread. A path ending in .y4m gets one raw YUV4MPEG2 video (4:2:0, BT.601 studio
+// range, the frame rate given); any other path, e.g. run.png, a numbered PNG sequence
+// run_00000.png, run_00001.png, ... (RGB, stored uncompressed, so encoding is a copy and two
+// checksums).
+//
+// Frames are caller-owned RGBA buffers, bottom row first (glReadPixels order), and are not
+// copied: submit() queues one and returns a ticket, and the buffer must stay valid until
+// waitUntilWritten(ticket) returns. When the writer falls behind, those waits (and submit()
+// with a full queue) block; that backpressure is what stats() counts. Nothing is allocated per
+// frame.
+class FrameWriter {
+public:
+    struct Stats {
+        unsigned long long submitted = 0;
+        unsigned long long written = 0;
+        unsigned long long stalls = 0;     // submit() / waitUntilWritten() calls that had to wait
+        double             stallMs = 0.0;  // total time spent waiting on the writer
+        double             writeMs = 0.0;  // writer thread time encoding and writing
+        unsigned long long bytes = 0;
+        bool               failed = false; // a file couldn't be opened or written
+    };
+
+    static const int FRAME_WRITER_QUEUE = 8;
+
+    FrameWriter(const std::string& path, int width, int height, int framesPerSecond);
+    // Writes every submitted frame before returning.
+    ~FrameWriter();
+
+    FrameWriter(const FrameWriter&) = delete;
+    FrameWriter& operator=(const FrameWriter&) = delete;
+
+    // False if the output couldn't be opened.
+    bool ok() const { return !stats().failed; }
+
+    // Queues a width * height * 4 RGBA frame. Tickets count up from 1.
+    unsigned long long submit(const unsigned char* rgba);
+    // Blocks until the frame with this ticket, and every one before it, has been written.
+    void waitUntilWritten(unsigned long long ticket);
+
+    Stats stats() const;
+
+private:
+    void run();
+    bool writeFrame(const unsigned char* rgba);
+    bool writeY4mFrame(const unsigned char* rgba);
+    bool writePngFrame(const unsigned char* rgba);
+
+    int width;
+    int height;
+    bool y4m;
+    std::string pngPrefix;
+    FILE* video = nullptr;
+    unsigned long long frameNumber = 0;   // writer thread only
+
+    std::vector<unsigned char> encoded;   // writer thread's output buffer
+    std::vector<unsigned char> scanlines; // PNG only: filtered rows ahead of deflate framing
+    std::vector<char> fileName;           // PNG only: the current frame's path
+
+    mutable std::mutex mutex;
+    std::condition_variable frameWritten;
+    std::condition_variable frameQueued;
+    const unsigned char* queue[FRAME_WRITER_QUEUE];   // ring, oldest at queueHead
+    int queueHead = 0;
+    int queued = 0;
+    bool stopping = false;
+    Stats frameStats;
+
+    std::thread worker;
+};
@@ -0,0 +1,30 @@
+#include "grid_culling.h"
+
+#include <algorithm>
+
+#include "curvature.h"
+#include "transform.h"
+
+int cullGridChunks(const std::vector<GridChunk>& chunks, const BodyBins& bins, const TileBounds& bounds, const float planes[6][4], std::vector<int>& visible) {
+    int culled = 0;
+    for (int c = 0; c < (int)chunks.size(); ++c) {
+        const GridChunk& chunk = chunks[c];
+        int firstTileX = chunk.x0 / BODY_TILE_SIZE, lastTileX = chunk.x1 / BODY_TILE_SIZE;
+        int firstTileZ = chunk.z0 / BODY_TILE_SIZE, lastTileZ = chunk.z1 / BODY_TILE_SIZE;
+        int firstTile = firstTileZ * bins.tilesPerSide + firstTileX;
+        float boxMin[3] = { gridCoordinate(chunk.x0, bins.gridSize), bounds.minY[firstTile], gridCoordinate(chunk.z0, bins.gridSize) };
+        float boxMax[3] = { gridCoordinate(chunk.x1, bins.gridSize), bounds.maxY[firstTile], gridCoordinate(chunk.z1, bins.gridSize) };
+        for (int tileZ = firstTileZ; tileZ <= lastTileZ; ++tileZ) {
+            for (int tileX = firstTileX; tileX <= lastTileX; ++tileX) {
+                boxMin[1] = std::min(boxMin[1], bounds.minY[tileZ * bins.tilesPerSide + tileX]);
+                boxMax[1] = std::max(boxMax[1], bounds.maxY[tileZ * bins.tilesPerSide + tileX]);
+            }
+        }
+
+        if (boxInFrustum(planes, boxMin, boxMax))
+            visible.push_back(c);
+        else
+            ++culled;
+    }
+    return culled;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <vector>
+
+#include "body_field.h"
+#include "grid_topology.h"
+
+// Frustum culling for the chunked uniform lattice. A chunk's box spans its lattice XZ extent
+// and the height ranges of the bin tiles its vertices fall in, so it follows the deformation
+// as the bounds are refreshed. Appends the indices of the chunks that may be visible and
+// returns how many were culled.
+int cullGridChunks(const std::vector<GridChunk>& chunks, const BodyBins& bins, const TileBounds& bounds, const float planes[6][4], std::vector<int>& visible);
@@ -0,0 +1,353 @@
+#include "grid_kernel.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "radial_profile.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define GRID_KERNEL_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define GRID_KERNEL_TARGET(isa)
+#else
+#define GRID_KERNEL_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+namespace {
+
+typedef void (*RowKernel)(const float*, float, int, float, float, float, float, float, float*);
+typedef void (*AccumulateKernel)(const float*, float, int, float, float, float, float, float*, float*);
+typedef void (*AccumulateTableKernel)(const float*, float, int, float, float, float, float, const ProfileTable&, float*, float*);
+
+void rowHeightsScalar(const float* xs, float zPos, int count,
+    float sphereX, float sphereZ, float sphereRadius, float sphereStrength, float minDeformation,
+    float* heights) {
+    float influence = sphereRadius * 2.5f;
+    float scale = -sphereStrength * 2.0f;
+    float farField = -sphereStrength * 0.1f;
+    float distZ = zPos - sphereZ;
+
+    for (int i = 0; i < count; ++i) {
+        float distX = xs[i] - sphereX;
+        float dist = std::sqrt(distX * distX + distZ * distZ);
+        float normalizedDist = dist / influence;
+        float deformation = scale * (1.0f / std::sqrt(normalizedDist * normalizedDist + 0.1f) - 1.0f);
+
+        float yPos = (dist < influence && normalizedDist < 1.0f) ? deformation : farField;
+        heights[i] = yPos < minDeformation ? minDeformation : yPos;
+    }
+}
+
+void accumulateBodyScalar(const float* xs, float zPos, int count,
+    float bodyX, float bodyZ, float bodyRadius, float bodyStrength,
+    float* deformation, float* coveredFarField) {
+    float influence = bodyRadius * 2.5f;
+    float scale = -bodyStrength * 2.0f;
+    float farField = -bodyStrength * 0.1f;
+    float distZ = zPos - bodyZ;
+
+    for (int i = 0; i < count; ++i) {
+        float distX = xs[i] - bodyX;
+        float dist = std::sqrt(distX * distX + distZ * distZ);
+        float normalizedDist = dist / influence;
+        if (dist < influence && normalizedDist < 1.0f) {
+            deformation[i] += scale * (1.0f / std::sqrt(normalizedDist * normalizedDist + 0.1f) - 1.0f);
+            coveredFarField[i] += farField;
+        }
+    }
+}
+
+void accumulateTableScalar(const float* xs, float zPos, int count,
+    float bodyX, float bodyZ, float bodyRadius, float bodyStrength, const ProfileTable& table,
+    float* deformation, float* coveredFarField) {
+    float influence = bodyRadius * 2.5f;
+    float inverseInfluence2 = 1.0f / (influence * influence);
+    float farField = -bodyStrength * 0.1f;
+    float distZ = zPos - bodyZ;
+
+    for (int i = 0; i < count; ++i) {
+        float distX = xs[i] - bodyX;
+        float u = (distX * distX + distZ * distZ) * inverseInfluence2;
+        if (u < 1.0f) {
+            deformation[i] += -bodyStrength * table.depth(u);
+            coveredFarField[i] += farField;
+        }
+    }
+}
+
+struct KernelChoice {
+    const char* name;
+    RowKernel kernel;
+    AccumulateKernel accumulate;
+    AccumulateTableKernel accumulateTable;
+};
+
+const KernelChoice scalarKernels = { "scalar", rowHeightsScalar, accumulateBodyScalar, accumulateTableScalar };
+
+
+#ifdef GRID_KERNEL_X86
+
+GRID_KERNEL_TARGET("sse4.1")
+void rowHeightsSse41(const float* xs, float zPos, int count,
+    float sphereX, float sphereZ, float sphereRadius, float sphereStrength, float minDeformation,
+    float* heights) {
+    float influence = sphereRadius * 2.5f;
+    float scale = -sphereStrength * 2.0f;
+    float farField = -sphereStrength * 0.1f;
+    float distZ = zPos - sphereZ;
+
+    const __m128 vSphereX = _mm_set1_ps(sphereX);
+    const __m128 vDistZ2 = _mm_set1_ps(distZ * distZ);
+    const __m128 vInfluence = _mm_set1_ps(influence);
+    const __m128 vScale = _mm_set1_ps(scale);
+    const __m128 vFarField = _mm_set1_ps(farField);
+    const __m128 vMin = _mm_set1_ps(minDeformation);
+    const __m128 vOne = _mm_set1_ps(1.0f);
+    const __m128 vSoftening = _mm_set1_ps(0.1f);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 distX = _mm_sub_ps(_mm_loadu_ps(xs + i), vSphereX);
+        __m128 dist = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(distX, distX), vDistZ2));
+        __m128 normalizedDist = _mm_div_ps(dist, vInfluence);
+        __m128 root = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(normalizedDist, normalizedDist), vSoftening));
+        __m128 deformation = _mm_mul_ps(vScale, _mm_sub_ps(_mm_div_ps(vOne, root), vOne));
+
+        __m128 inside = _mm_and_ps(_mm_cmplt_ps(dist, vInfluence), _mm_cmplt_ps(normalizedDist, vOne));
+        __m128 yPos = _mm_blendv_ps(vFarField, deformation, inside);
+        yPos = _mm_blendv_ps(yPos, vMin, _mm_cmplt_ps(yPos, vMin));
+        _mm_storeu_ps(heights + i, yPos);
+    }
+    rowHeightsScalar(xs + i, zPos, count - i, sphereX, sphereZ, sphereRadius, sphereStrength, minDeformation, heights + i);
+}
+
+GRID_KERNEL_TARGET("avx2")
+void rowHeightsAvx2(const float* xs, float zPos, int count,
+    float sphereX, float sphereZ, float sphereRadius, float sphereStrength, float minDeformation,
+    float* heights) {
+    float influence = sphereRadius * 2.5f;
+    float scale = -sphereStrength * 2.0f;
+    float farField = -sphereStrength * 0.1f;
+    float distZ = zPos - sphereZ;
+
+    const __m256 vSphereX = _mm256_set1_ps(sphereX);
+    const __m256 vDistZ2 = _mm256_set1_ps(distZ * distZ);
+    const __m256 vInfluence = _mm256_set1_ps(influence);
+    const __m256 vScale = _mm256_set1_ps(scale);
+    const __m256 vFarField = _mm256_set1_ps(farField);
+    const __m256 vMin = _mm256_set1_ps(minDeformation);
+    const __m256 vOne = _mm256_set1_ps(1.0f);
+    const __m256 vSoftening = _mm256_set1_ps(0.1f);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 distX = _mm256_sub_ps(_mm256_loadu_ps(xs + i), vSphereX);
+        __m256 dist = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(distX, distX), vDistZ2));
+        __m256 normalizedDist = _mm256_div_ps(dist, vInfluence);
+        __m256 root = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(normalizedDist, normalizedDist), vSoftening));
+        __m256 deformation = _mm256_mul_ps(vScale, _mm256_sub_ps(_mm256_div_ps(vOne, root), vOne));
+
+        __m256 inside = _mm256_and_ps(_mm256_cmp_ps(dist, vInfluence, _CMP_LT_OQ), _mm256_cmp_ps(normalizedDist, vOne, _CMP_LT_OQ));
+        __m256 yPos = _mm256_blendv_ps(vFarField, deformation, inside);
+        yPos = _mm256_blendv_ps(yPos, vMin, _mm256_cmp_ps(yPos, vMin, _CMP_LT_OQ));
+        _mm256_storeu_ps(heights + i, yPos);
+    }
+    rowHeightsScalar(xs + i, zPos, count - i, sphereX, sphereZ, sphereRadius, sphereStrength, minDeformation, heights + i);
+}
+
+GRID_KERNEL_TARGET("sse4.1")
+void accumulateBodySse41(const float* xs, float zPos, int count,
+    float bodyX, float bodyZ, float bodyRadius, float bodyStrength,
+    float* deformation, float* coveredFarField) {
+    float influence = bodyRadius * 2.5f;
+    float scale = -bodyStrength * 2.0f;
+    float farField = -bodyStrength * 0.1f;
+    float distZ = zPos - bodyZ;
+
+    const __m128 vBodyX = _mm_set1_ps(bodyX);
+    const __m128 vDistZ2 = _mm_set1_ps(distZ * distZ);
+    const __m128 vInfluence = _mm_set1_ps(influence);
+    const __m128 vScale = _mm_set1_ps(scale);
+    const __m128 vFarField = _mm_set1_ps(farField);
+    const __m128 vOne = _mm_set1_ps(1.0f);
+    const __m128 vSoftening = _mm_set1_ps(0.1f);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 distX = _mm_sub_ps(_mm_loadu_ps(xs + i), vBodyX);
+        __m128 dist = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(distX, distX), vDistZ2));
+        __m128 normalizedDist = _mm_div_ps(dist, vInfluence);
+        __m128 root = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(normalizedDist, normalizedDist), vSoftening));
+        __m128 well = _mm_mul_ps(vScale, _mm_sub_ps(_mm_div_ps(vOne, root), vOne));
+
+        __m128 inside = _mm_and_ps(_mm_cmplt_ps(dist, vInfluence), _mm_cmplt_ps(normalizedDist, vOne));
+        _mm_storeu_ps(deformation + i, _mm_add_ps(_mm_loadu_ps(deformation + i), _mm_and_ps(well, inside)));
+        _mm_storeu_ps(coveredFarField + i, _mm_add_ps(_mm_loadu_ps(coveredFarField + i), _mm_and_ps(vFarField, inside)));
+    }
+    accumulateBodyScalar(xs + i, zPos, count - i, bodyX, bodyZ, bodyRadius, bodyStrength, deformation + i, coveredFarField + i);
+}
+
+GRID_KERNEL_TARGET("avx2")
+void accumulateBodyAvx2(const float* xs, float zPos, int count,
+    float bodyX, float bodyZ, float bodyRadius, float bodyStrength,
+    float* deformation, float* coveredFarField) {
+    float influence = bodyRadius * 2.5f;
+    float scale = -bodyStrength * 2.0f;
+    float farField = -bodyStrength * 0.1f;
+    float distZ = zPos - bodyZ;
+
+    const __m256 vBodyX = _mm256_set1_ps(bodyX);
+    const __m256 vDistZ2 = _mm256_set1_ps(distZ * distZ);
+    const __m256 vInfluence = _mm256_set1_ps(influence);
+    const __m256 vScale = _mm256_set1_ps(scale);
+    const __m256 vFarField = _mm256_set1_ps(farField);
+    const __m256 vOne = _mm256_set1_ps(1.0f);
+    const __m256 vSoftening = _mm256_set1_ps(0.1f);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 distX = _mm256_sub_ps(_mm256_loadu_ps(xs + i), vBodyX);
+        __m256 dist = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(distX, distX), vDistZ2));
+        __m256 normalizedDist = _mm256_div_ps(dist, vInfluence);
+        __m256 root = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(normalizedDist, normalizedDist), vSoftening));
+        __m256 well = _mm256_mul_ps(vScale, _mm256_sub_ps(_mm256_div_ps(vOne, root), vOne));
+
+        __m256 inside = _mm256_and_ps(_mm256_cmp_ps(dist, vInfluence, _CMP_LT_OQ), _mm256_cmp_ps(normalizedDist, vOne, _CMP_LT_OQ));
+        _mm256_storeu_ps(deformation + i, _mm256_add_ps(_mm256_loadu_ps(deformation + i), _mm256_and_ps(well, inside)));
+        _mm256_storeu_ps(coveredFarField + i, _mm256_add_ps(_mm256_loadu_ps(coveredFarField + i), _mm256_and_ps(vFarField, inside)));
+    }
+    accumulateBodyScalar(xs + i, zPos, count - i, bodyX, bodyZ, bodyRadius, bodyStrength, deformation + i, coveredFarField + i);
+}
+
+GRID_KERNEL_TARGET("avx2")
+void accumulateTableAvx2(const float* xs, float zPos, int count,
+    float bodyX, float bodyZ, float bodyRadius, float bodyStrength, const ProfileTable& table,
+    float* deformation, float* coveredFarField) {
+    float influence = bodyRadius * 2.5f;
+    float inverseInfluence2 = 1.0f / (influence * influence);
+    float farField = -bodyStrength * 0.1f;
+    float distZ = zPos - bodyZ;
+    const float* samples = table.data();
+
+    const __m256 vBodyX = _mm256_set1_ps(bodyX);
+    const __m256 vDistZ2 = _mm256_set1_ps(distZ * distZ);
+    const __m256 vInverseInfluence2 = _mm256_set1_ps(inverseInfluence2);
+    const __m256 vScale = _mm256_set1_ps(-bodyStrength);
+    const __m256 vFarField = _mm256_set1_ps(farField);
+    const __m256 vOne = _mm256_set1_ps(1.0f);
+    const __m256 vTableSize = _mm256_set1_ps((float)ProfileTable::PROFILE_TABLE_SIZE);
+    const __m256i vLastInterval = _mm256_set1_epi32(ProfileTable::PROFILE_TABLE_SIZE - 1);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 distX = _mm256_sub_ps(_mm256_loadu_ps(xs + i), vBodyX);
+        __m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(distX, distX), vDistZ2), vInverseInfluence2);
+        __m256 inside = _mm256_cmp_ps(u, vOne, _CMP_LT_OQ);
+        // Tile lists are conservative, so many blocks miss the disk entirely; skip their gathers.
+        if (_mm256_movemask_ps(inside) == 0) {
+            continue;
+        }
+
+        // Lanes outside the disk are clamped to the rim so their (discarded) lookup stays in the table.
+        __m256 scaled = _mm256_mul_ps(_mm256_min_ps(u, vOne), vTableSize);
+        __m256i index = _mm256_min_epi32(_mm256_cvttps_epi32(scaled), vLastInterval);
+        __m256 t = _mm256_sub_ps(scaled, _mm256_cvtepi32_ps(index));
+        __m256 low = _mm256_i32gather_ps(samples, index, 4);
+        __m256 high = _mm256_i32gather_ps(samples + 1, index, 4);
+        __m256 depth = _mm256_add_ps(low, _mm256_mul_ps(t, _mm256_sub_ps(high, low)));
+
+        __m256 well = _mm256_mul_ps(vScale, depth);
+        _mm256_storeu_ps(deformation + i, _mm256_add_ps(_mm256_loadu_ps(deformation + i), _mm256_and_ps(well, inside)));
+        _mm256_storeu_ps(coveredFarField + i, _mm256_add_ps(_mm256_loadu_ps(coveredFarField + i), _mm256_and_ps(vFarField, inside)));
+    }
+    // The tail call is compiled without AVX; leave the upper halves clean so its SSE code
+    // doesn't pay the transition penalty (GCC omits the vzeroupper on this sibling call).
+    _mm256_zeroupper();
+    accumulateTableScalar(xs + i, zPos, count - i, bodyX, bodyZ, bodyRadius, bodyStrength, table, deformation + i, coveredFarField + i);
+}
+
+#if defined(_MSC_VER) && !defined(__clang__)
+bool cpuSupports(int leaf, int subleaf, int reg, int bit) {
+    int info[4];
+    __cpuidex(info, 0, 0);
+    if (info[0] < leaf) return false;
+    __cpuidex(info, leaf, subleaf);
+    return (info[reg] >> bit) & 1;
+}
+#endif
+
+const KernelChoice sse41Kernels = { "sse4.1", rowHeightsSse41, accumulateBodySse41, accumulateTableScalar };
+const KernelChoice avx2Kernels = { "avx2", rowHeightsAvx2, accumulateBodyAvx2, accumulateTableAvx2 };
+
+// The kernels this CPU can run, best first.
+std::vector<const KernelChoice*> supportedKernels() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    bool osSavesYmm = cpuSupports(1, 0, 2, 27) && (_xgetbv(0) & 0x6) == 0x6;
+    bool hasAvx2 = osSavesYmm && cpuSupports(1, 0, 2, 28) && cpuSupports(7, 0, 1, 5);
+    bool hasSse41 = cpuSupports(1, 0, 2, 19);
+#else
+    __builtin_cpu_init();
+    bool hasAvx2 = __builtin_cpu_supports("avx2");
+    bool hasSse41 = __builtin_cpu_supports("sse4.1");
+#endif
+    std::vector<const KernelChoice*> kernels;
+    if (hasAvx2) {
+        kernels.push_back(&avx2Kernels);
+    }
+    if (hasSse41) {
+        kernels.push_back(&sse41Kernels);
+    }
+    kernels.push_back(&scalarKernels);
+    return kernels;
+}
+
+#else
+
+std::vector<const KernelChoice*> supportedKernels() {
+    return { &scalarKernels };
+}
+
+#endif
+
+const KernelChoice*& kernelChoice() {
+    static const KernelChoice* choice = supportedKernels().front();
+    return choice;
+}
+
+}
+
+void computeGridRowHeights(const float* xs, float zPos, int count,
+    float sphereX, float sphereZ, float sphereRadius, float sphereStrength, float minDeformation,
+    float* heights) {
+    kernelChoice()->kernel(xs, zPos, count, sphereX, sphereZ, sphereRadius, sphereStrength, minDeformation, heights);
+}
+
+void accumulateBodyRow(const float* xs, float zPos, int count,
+    float bodyX, float bodyZ, float bodyRadius, float bodyStrength,
+    float* deformation, float* coveredFarField) {
+    kernelChoice()->accumulate(xs, zPos, count, bodyX, bodyZ, bodyRadius, bodyStrength, deformation, coveredFarField);
+}
+
+void accumulateBodyRowTable(const float* xs, float zPos, int count,
+    float bodyX, float bodyZ, float bodyRadius, float bodyStrength, const ProfileTable& table,
+    float* deformation, float* coveredFarField) {
+    kernelChoice()->accumulateTable(xs, zPos, count, bodyX, bodyZ, bodyRadius, bodyStrength, table, deformation, coveredFarField);
+}
+
+const char* gridKernelName() {
+    return kernelChoice()->name;
+}
+
+bool forceGridKernel(const char* name) {
+    for (const KernelChoice* kernels : supportedKernels()) {
+        if (std::strcmp(kernels->name, name) == 0) {
+            kernelChoice() = kernels;
+            return true;
+        }
+    }
+    return false;
+}
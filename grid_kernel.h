@@ -0,0 +1,42 @@
+#pragma once
+
+class ProfileTable;
+
+// Vectorized grid height evaluation.
+//
+// computeGridRowHeights() evaluates one row of the deformation field on structure-of-arrays
+// input: heights[i] is the clamped height of the vertex at (xs[i], zPos). The in/out-of-disk
+// branches of the scalar code become masked selects, and the kernel is picked at runtime:
+// AVX2 (8 lanes), SSE4.1 (4 lanes) or a portable scalar loop.
+//
+// Tolerance: every path uses the same IEEE operations in the same order as gridHeightAt()
+// in curvature.cpp, except that pow(normalizedDist, 2) is computed as normalizedDist * normalizedDist.
+// Results therefore agree with the scalar reference to within 1 ULP of the height (and are
+// bit-identical wherever the C library's powf is correctly rounded, as on glibc).
+
+void computeGridRowHeights(const float* xs, float zPos, int count,
+    float sphereX, float sphereZ, float sphereRadius, float sphereStrength, float minDeformation,
+    float* heights);
+
+// Multi-body variant: for every vertex inside the body's influence disk, adds the body's well
+// depth to deformation[i] and its far-field offset to coveredFarField[i]; vertices outside are
+// left untouched. Same operations and tolerance as above.
+void accumulateBodyRow(const float* xs, float zPos, int count,
+    float bodyX, float bodyZ, float bodyRadius, float bodyStrength,
+    float* deformation, float* coveredFarField);
+
+// Same again with the well read from a profile table (radial_profile.h) instead of evaluated,
+// so there is no square root or divide per vertex whatever the profile: every vertex with
+// (distance / influence)^2 = u < 1 gets strength * table.depth(u) taken off deformation[i].
+// AVX2 gathers eight lookups at a time; other CPUs use the scalar loop.
+void accumulateBodyRowTable(const float* xs, float zPos, int count,
+    float bodyX, float bodyZ, float bodyRadius, float bodyStrength, const ProfileTable& table,
+    float* deformation, float* coveredFarField);
+
+// Name of the kernel selected for this CPU: "avx2", "sse4.1" or "scalar".
+const char* gridKernelName();
+
+// Switches every call above to the kernel of that name, for tests that check each one the CPU
+// can run. Returns false, leaving the selection alone, if the name is unknown or the CPU
+// lacks the instructions. Not synchronized: call it while no rows are being computed.
+bool forceGridKernel(const char* name);
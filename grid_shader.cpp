@@ -0,0 +1,85 @@
+#include "grid_shader.h"
+
+const char* const GRID_VERTEX_SHADER_SOURCE = R"(
+    #version 330 core
+    layout (location = 0) in vec3 aPos;
+    layout (location = 1) in float aHeight;
+
+    uniform mat4 model;
+    layout(std140) uniform Camera {
+        mat4 view;
+        mat4 projection;
+        mat4 viewProjection;
+    };
+
+    uniform bool  deformOnGpu;
+    uniform bool  relativeHeights;   // CPU lattice heights still lack the far field
+    // Compact vertices: the lattice has no position attribute and rebuilds xz from
+    // gl_VertexID, and CPU heights arrive on their own in aHeight.
+    uniform bool  latticeFromVertexId;
+    uniform bool  separateHeights;
+    uniform float minDeformation;
+
+    // Body bins (see body_field.h): bodies holds (x, z, radius, strength) per body,
+    // tileStart and tileBodies the per-tile body lists.
+    uniform samplerBuffer  bodies;
+    uniform isamplerBuffer tileStart;
+    uniform isamplerBuffer tileBodies;
+    // Well depth per unit strength over u = (distance / influence)^2, profileTableSize + 1
+    // texels (see radial_profile.h).
+    uniform sampler1D profileTable;
+    uniform float profileTableSize;
+    uniform int   gridSize;
+    uniform float gridScale;
+    uniform int   tileSize;
+    uniform int   tilesPerSide;
+    uniform float farField;
+
+    void main() {
+        vec3 pos = aPos;
+        float halfGrid = float(gridSize) / 2.0;
+        if (latticeFromVertexId) {
+            pos.xz = (vec2(gl_VertexID % gridSize, gl_VertexID / gridSize) - halfGrid) / halfGrid * gridScale;
+        }
+        if (separateHeights) {
+            pos.y = aHeight;
+        }
+        if (deformOnGpu) {
+            // Bins are laid out on the gridSize lattice; any mesh finds its tile by position.
+            ivec2 lattice = clamp(ivec2(floor(pos.xz / gridScale * halfGrid + halfGrid + 0.5)), ivec2(0), ivec2(gridSize - 1));
+            int tile = (lattice.y / tileSize) * tilesPerSide + lattice.x / tileSize;
+            float deformation = 0.0;
+            float coveredFarField = 0.0;
+
+            int last = texelFetch(tileStart, tile + 1).r;
+            for (int i = texelFetch(tileStart, tile).r; i < last; ++i) {
+                vec4 body = texelFetch(bodies, texelFetch(tileBodies, i).r);
+                float distX = pos.x - body.x;
+                float distZ = pos.z - body.y;
+                float influence = body.z * 2.5;
+                float u = (distX * distX + distZ * distZ) / (influence * influence);
+
+                if (u < 1.0) {
+                    float depth = texture(profileTable, (u * profileTableSize + 0.5) / (profileTableSize + 1.0)).r;
+                    deformation += -body.w * depth;
+                    coveredFarField += -body.w * 0.1;
+                }
+            }
+
+            pos.y = max(deformation + (farField - coveredFarField), minDeformation);
+        }
+        else if (relativeHeights) {
+            pos.y = max(pos.y + farField, minDeformation);
+        }
+        gl_Position = viewProjection * model * vec4(pos, 1.0);
+    }
+)";
+
+const char* const GRID_FRAGMENT_SHADER_SOURCE = R"(
+    #version 330 core
+    out vec4 FragColor;
+
+    void main() {
+        FragColor = vec4(0.8f, 0.8f, 0.8f, 1.0f);
+    }
+)";
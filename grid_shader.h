@@ -0,0 +1,7 @@
+#pragma once
+
+// GLSL of the grid program, kept out of main.cpp so spacetime-test-grid-shader can run the
+// same vertex shader against generateGrid(). The vertex shader displaces the lattice (or any
+// flat mesh) by the body bins when deformOnGpu is set; main.cpp sets its uniforms.
+extern const char* const GRID_VERTEX_SHADER_SOURCE;
+extern const char* const GRID_FRAGMENT_SHADER_SOURCE;
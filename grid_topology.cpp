@@ -0,0 +1,162 @@
+#include "grid_topology.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Each emitter appends one chunk: the quads between lattice vertices [x0, x1] x [z0, z1].
+// Edges on a chunk's -x / -z side belong to it, those on its +x / +z side to the next chunk
+// unless it is on the grid border, so every edge is emitted exactly once across chunks.
+
+template <typename Index>
+void emitTriangles(int gridSize, int x0, int z0, int x1, int z1, std::vector<Index>& indices) {
+    for (int z = z0; z < z1; ++z) {
+        for (int x = x0; x < x1; ++x) {
+            Index current = (Index)(z * gridSize + x);
+
+            indices.push_back(current);
+            indices.push_back(current + 1);
+            indices.push_back(current + gridSize);
+
+            indices.push_back(current + 1);
+            indices.push_back(current + gridSize + 1);
+            indices.push_back(current + gridSize);
+        }
+    }
+}
+
+template <typename Index>
+void emitLines(int gridSize, int x0, int z0, int x1, int z1, std::vector<Index>& indices) {
+    int lastX = x1 == gridSize - 1 ? x1 : x1 - 1;
+    int lastZ = z1 == gridSize - 1 ? z1 : z1 - 1;
+    for (int z = z0; z <= lastZ; ++z) {
+        for (int x = x0; x <= lastX; ++x) {
+            Index current = (Index)(z * gridSize + x);
+            if (x < x1) {
+                indices.push_back(current);
+                indices.push_back(current + 1);
+            }
+            if (z < z1) {
+                indices.push_back(current);
+                indices.push_back(current + gridSize);
+            }
+            if (x < x1 && z < z1) {
+                indices.push_back(current + 1);
+                indices.push_back(current + gridSize);
+            }
+        }
+    }
+}
+
+template <typename Index>
+void emitLineStrips(int gridSize, int x0, int z0, int x1, int z1, Index restart, std::vector<Index>& indices) {
+    int lastX = x1 == gridSize - 1 ? x1 : x1 - 1;
+    int lastZ = z1 == gridSize - 1 ? z1 : z1 - 1;
+    for (int z = z0; z <= lastZ; ++z) {
+        for (int x = x0; x <= x1; ++x) {
+            indices.push_back((Index)(z * gridSize + x));
+        }
+        indices.push_back(restart);
+    }
+    for (int x = x0; x <= lastX; ++x) {
+        for (int z = z0; z <= z1; ++z) {
+            indices.push_back((Index)(z * gridSize + x));
+        }
+        indices.push_back(restart);
+    }
+    // Anti-diagonals x + z = sum carry the quad diagonals; the two corner sums are single points.
+    for (int sum = x0 + z0 + 1; sum <= x1 + z1 - 1; ++sum) {
+        int firstX = std::max(x0, sum - z1);
+        int lastDiagonalX = std::min(x1, sum - z0);
+        for (int x = firstX; x <= lastDiagonalX; ++x) {
+            indices.push_back((Index)((sum - x) * gridSize + x));
+        }
+        indices.push_back(restart);
+    }
+    // The chunk's range ends on its last strip; the restart before the next chunk stays in
+    // the buffer so the whole buffer still draws in one call.
+    indices.pop_back();
+}
+
+template <typename Index>
+void emitChunks(int gridSize, int chunkSize, GridTopology topology, Index restart, std::vector<Index>& indices, std::vector<GridChunk>& chunks) {
+    indices.clear();
+    chunks.clear();
+    size_t quads = (size_t)(gridSize - 1) * (gridSize - 1);
+    indices.reserve(topology == GridTopology::Triangles ? quads * 6 : topology == GridTopology::Lines ? quads * 6 + gridSize * 4 : quads * 3 + gridSize * 8);
+
+    for (int z0 = 0; z0 < gridSize - 1; z0 += chunkSize) {
+        for (int x0 = 0; x0 < gridSize - 1; x0 += chunkSize) {
+            if (topology == GridTopology::LineStrips && !indices.empty()) {
+                indices.push_back(restart);
+            }
+            GridChunk chunk;
+            chunk.firstIndex = indices.size();
+            chunk.x0 = x0;
+            chunk.z0 = z0;
+            chunk.x1 = std::min(x0 + chunkSize, gridSize - 1);
+            chunk.z1 = std::min(z0 + chunkSize, gridSize - 1);
+            switch (topology) {
+            case GridTopology::Triangles:
+                emitTriangles(gridSize, chunk.x0, chunk.z0, chunk.x1, chunk.z1, indices);
+                break;
+            case GridTopology::Lines:
+                emitLines(gridSize, chunk.x0, chunk.z0, chunk.x1, chunk.z1, indices);
+                break;
+            case GridTopology::LineStrips:
+                emitLineStrips(gridSize, chunk.x0, chunk.z0, chunk.x1, chunk.z1, restart, indices);
+                break;
+            }
+            chunk.count = indices.size() - chunk.firstIndex;
+            chunks.push_back(chunk);
+        }
+    }
+}
+
+}
+
+void buildGridIndices(int gridSize, GridTopology topology, GridIndices& out, int chunkSize) {
+    out.topology = topology;
+    out.shortIndices.clear();
+    out.intIndices.clear();
+    if (chunkSize <= 0 || chunkSize > gridSize - 1) {
+        chunkSize = gridSize - 1;
+    }
+
+    if ((long long)gridSize * gridSize <= 0xFFFF) {
+        out.indexSize = 2;
+        out.restartIndex = 0xFFFF;
+        emitChunks(gridSize, chunkSize, topology, (unsigned short)0xFFFF, out.shortIndices, out.chunks);
+        out.count = out.shortIndices.size();
+    }
+    else {
+        out.indexSize = 4;
+        out.restartIndex = 0xFFFFFFFFu;
+        emitChunks(gridSize, chunkSize, topology, 0xFFFFFFFFu, out.intIndices, out.chunks);
+        out.count = out.intIndices.size();
+    }
+}
+
+const char* gridTopologyName(GridTopology topology) {
+    switch (topology) {
+    case GridTopology::Triangles:
+        return "triangles";
+    case GridTopology::Lines:
+        return "lines";
+    case GridTopology::LineStrips:
+        return "strips";
+    }
+    return "unknown";
+}
+
+bool parseGridTopology(const char* name, GridTopology& topology) {
+    const GridTopology all[] = { GridTopology::Triangles, GridTopology::Lines, GridTopology::LineStrips };
+    for (GridTopology candidate : all) {
+        if (std::strcmp(name, gridTopologyName(candidate)) == 0) {
+            topology = candidate;
+            return true;
+        }
+    }
+    return false;
+}
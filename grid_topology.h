@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Wireframe topologies for the gridSize x gridSize lattice. All three draw the same set of
+// edges (every row and column segment plus the (x+1, z)-(x, z+1) diagonal of each quad), so
+// they rasterize to the same image:
+//   Triangles  - two triangles per quad, drawn with glPolygonMode(GL_LINE); shared edges and
+//                diagonals are rasterized twice. Kept as the reference.
+//   Lines      - GL_LINES, each edge exactly once.
+//   LineStrips - GL_LINE_STRIP with primitive restart: one strip per row, column and
+//                anti-diagonal, about half the indices of Triangles.
+enum class GridTopology {
+    Triangles,
+    Lines,
+    LineStrips
+};
+
+// Quads per chunk side for culling. Equal to BODY_TILE_SIZE, so a chunk's vertices fall in at
+// most 2 x 2 bin tiles.
+const int GRID_CHUNK_SIZE = 32;
+
+// A square block of quads whose indices are contiguous: firstIndex and count (in indices)
+// select its range, and it spans lattice vertices [x0, x1] x [z0, z1].
+struct GridChunk {
+    size_t firstIndex;
+    size_t count;
+    int    x0, z0, x1, z1;
+};
+
+// Index data for one topology. Indices are 16-bit whenever the vertex count leaves room for
+// the restart index, and 32-bit otherwise.
+struct GridIndices {
+    GridTopology topology = GridTopology::LineStrips;
+    int          indexSize = 4;
+    size_t       count = 0;
+    unsigned int restartIndex = 0xFFFFFFFFu;
+    std::vector<unsigned short> shortIndices;
+    std::vector<unsigned int>   intIndices;
+    std::vector<GridChunk>      chunks;
+
+    const void* data() const { return indexSize == 2 ? (const void*)shortIndices.data() : (const void*)intIndices.data(); }
+    size_t byteSize() const { return count * indexSize; }
+};
+
+// Emits the lattice chunk by chunk, row-major, with chunkSize quads per side (0 for a single
+// chunk). LineStrips separates chunks with a restart index that no chunk range includes, so
+// the whole buffer still draws as one call.
+void buildGridIndices(int gridSize, GridTopology topology, GridIndices& out, int chunkSize = 0);
+
+// "triangles", "lines" or "strips"; parseGridTopology() returns false for anything else.
+const char* gridTopologyName(GridTopology topology);
+bool parseGridTopology(const char* name, GridTopology& topology);
@@ -0,0 +1,128 @@
+#include "headless_context.h"
+
+#include <GLFW/glfw3.h>
+#include <iostream>
+
+#ifdef SPACETIME_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+namespace {
+
+const char* contextKind = "none";
+GLFWwindow* hiddenWindow = nullptr;
+
+#ifdef SPACETIME_HAS_EGL
+EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+EGLContext eglContext = EGL_NO_CONTEXT;
+
+EGLDisplay openSurfacelessDisplay() {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay) {
+        EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (display != EGL_NO_DISPLAY) {
+            return display;
+        }
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+bool createEglContext() {
+    eglDisplay = openSurfacelessDisplay();
+    if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, nullptr, nullptr)) {
+        eglDisplay = EGL_NO_DISPLAY;
+        return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        eglTerminate(eglDisplay);
+        eglDisplay = EGL_NO_DISPLAY;
+        return false;
+    }
+
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config = nullptr;
+    EGLint configCount = 0;
+    eglChooseConfig(eglDisplay, configAttributes, &config, 1, &configCount);
+
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    eglContext = eglCreateContext(eglDisplay, configCount > 0 ? config : (EGLConfig)nullptr, EGL_NO_CONTEXT, contextAttributes);
+    if (eglContext == EGL_NO_CONTEXT || !eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext)) {
+        std::cerr << "EGL surfaceless context unavailable (0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+        if (eglContext != EGL_NO_CONTEXT) {
+            eglDestroyContext(eglDisplay, eglContext);
+            eglContext = EGL_NO_CONTEXT;
+        }
+        eglTerminate(eglDisplay);
+        eglDisplay = EGL_NO_DISPLAY;
+        return false;
+    }
+    return true;
+}
+#endif
+
+bool createHiddenWindowContext() {
+    if (!glfwInit()) {
+        return false;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    hiddenWindow = glfwCreateWindow(1, 1, "Spacetime Curvature (headless)", nullptr, nullptr);
+    if (!hiddenWindow) {
+        glfwTerminate();
+        return false;
+    }
+    glfwMakeContextCurrent(hiddenWindow);
+    glfwSwapInterval(0);
+    return true;
+}
+
+}
+
+bool createHeadlessContext() {
+#ifdef SPACETIME_HAS_EGL
+    if (createEglContext()) {
+        contextKind = "EGL surfaceless";
+        return true;
+    }
+#endif
+    if (createHiddenWindowContext()) {
+        contextKind = "hidden GLFW window";
+        return true;
+    }
+    std::cerr << "Failed to create a headless OpenGL context" << std::endl;
+    return false;
+}
+
+void destroyHeadlessContext() {
+#ifdef SPACETIME_HAS_EGL
+    if (eglDisplay != EGL_NO_DISPLAY) {
+        eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(eglDisplay, eglContext);
+        eglTerminate(eglDisplay);
+        eglDisplay = EGL_NO_DISPLAY;
+        eglContext = EGL_NO_CONTEXT;
+    }
+#endif
+    if (hiddenWindow) {
+        glfwDestroyWindow(hiddenWindow);
+        hiddenWindow = nullptr;
+        glfwTerminate();
+    }
+}
+
+const char* headlessContextKind() {
+    return contextKind;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+// Windowless OpenGL 3.3 core context for offscreen rendering.
+//
+// Uses an EGL surfaceless context where EGL is available (this works on Mesa llvmpipe with
+// no GPU or display server) and falls back to a hidden GLFW window otherwise. There is no
+// default framebuffer to draw into, so callers render into their own FBO.
+
+bool createHeadlessContext();
+void destroyHeadlessContext();
+
+// "EGL surfaceless" or "hidden GLFW window"; valid after createHeadlessContext() succeeds.
+const char* headlessContextKind();
@@ -0,0 +1,161 @@
+#include "incremental_grid.h"
+
+#include <algorithm>
+#include <cfloat>
+
+#include "curvature.h"
+#include "thread_pool.h"
+#include "vertex_format.h"
+
+namespace {
+
+bool sameBody(const Body& a, const Body& b) {
+    return a.x == b.x && a.z == b.z && a.radius == b.radius && a.strength == b.strength;
+}
+
+void includeFootprint(const Body& body, int gridSize, GridRect& rect) {
+    int firstX, lastX, firstZ, lastZ;
+    bodyFootprint(body, gridSize, firstX, lastX, firstZ, lastZ);
+    if (firstX > lastX || firstZ > lastZ) {
+        return;
+    }
+    if (rect.empty()) {
+        rect = { firstX, firstZ, lastX + 1, lastZ + 1 };
+        return;
+    }
+    rect.x0 = std::min(rect.x0, firstX);
+    rect.z0 = std::min(rect.z0, firstZ);
+    rect.x1 = std::max(rect.x1, lastX + 1);
+    rect.z1 = std::max(rect.z1, lastZ + 1);
+}
+
+}
+
+IncrementalGrid::IncrementalGrid(int gridSize)
+    : gridSize(gridSize), tilesPerSide((gridSize + BODY_TILE_SIZE - 1) / BODY_TILE_SIZE) {
+    grid.resize(gridSize * gridSize * 3);
+    for (int z = 0; z < gridSize; ++z) {
+        for (int x = 0; x < gridSize; ++x) {
+            float* vertex = &grid[(z * gridSize + x) * 3];
+            vertex[0] = gridCoordinate(x, gridSize);
+            vertex[1] = 0.0f;
+            vertex[2] = gridCoordinate(z, gridSize);
+        }
+    }
+    tileLow.assign(tilesPerSide * tilesPerSide, 0.0f);
+    tileHigh.assign(tilesPerSide * tilesPerSide, 0.0f);
+}
+
+GridRect IncrementalGrid::update(const std::vector<Body>& bodies, const BodyBins& bins, ThreadPool& pool) {
+    GridRect rect;
+    if (!built || bodies.size() != builtFor.size()) {
+        rect = { 0, 0, gridSize, gridSize };
+    }
+    else {
+        // Both footprints, in case a body moved or grew.
+        for (size_t b = 0; b < bodies.size(); ++b) {
+            if (!sameBody(bodies[b], builtFor[b])) {
+                includeFootprint(builtFor[b], gridSize, rect);
+                includeFootprint(bodies[b], gridSize, rect);
+            }
+        }
+    }
+    if (!rect.empty()) {
+        recompute(rect, bodies, bins, pool);
+    }
+    builtFor = bodies;
+    built = true;
+    return rect;
+}
+
+void IncrementalGrid::recompute(const GridRect& rect, const std::vector<Body>& bodies, const BodyBins& bins, ThreadPool& pool) {
+    int rows = rect.z1 - rect.z0;
+    pool.parallelFor(rows, std::max(1, rows / (pool.size() * 4)), [&](int, int firstRow, int lastRow) {
+        float xs[BODY_TILE_SIZE];
+        float deformation[BODY_TILE_SIZE];
+        float coveredFarField[BODY_TILE_SIZE];
+
+        for (int z = rect.z0 + firstRow; z < rect.z0 + lastRow; ++z) {
+            float zPos = gridCoordinate(z, gridSize);
+            float* row = &grid[z * gridSize * 3];
+            const int* tileStart = &bins.tileStart[(z / BODY_TILE_SIZE) * tilesPerSide];
+
+            for (int tileX = rect.x0 / BODY_TILE_SIZE; tileX <= (rect.x1 - 1) / BODY_TILE_SIZE; ++tileX) {
+                int first = std::max(rect.x0, tileX * BODY_TILE_SIZE);
+                int count = std::min(rect.x1, (tileX + 1) * BODY_TILE_SIZE) - first;
+                for (int i = 0; i < count; ++i) {
+                    xs[i] = row[(first + i) * 3];
+                }
+                std::fill(deformation, deformation + count, 0.0f);
+                std::fill(coveredFarField, coveredFarField + count, 0.0f);
+
+                for (int i = tileStart[tileX]; i < tileStart[tileX + 1]; ++i) {
+                    const Body& body = bodies[bins.bodyIndices[i]];
+                    accumulateBodyField(xs, zPos, count, body, bins, deformation, coveredFarField);
+                }
+                for (int i = 0; i < count; ++i) {
+                    row[(first + i) * 3 + 1] = deformation[i] - coveredFarField[i];
+                }
+            }
+        }
+    });
+
+    // Rescan the whole of every tile the rectangle touched.
+    int firstTileX = rect.x0 / BODY_TILE_SIZE;
+    int tileColumns = (rect.x1 - 1) / BODY_TILE_SIZE - firstTileX + 1;
+    int firstTileZ = rect.z0 / BODY_TILE_SIZE;
+    int tileRows = (rect.z1 - 1) / BODY_TILE_SIZE - firstTileZ + 1;
+    pool.parallelFor(tileColumns * tileRows, 1, [&](int, int firstTile, int lastTile) {
+        for (int t = firstTile; t < lastTile; ++t) {
+            int tileX = firstTileX + t % tileColumns;
+            int tileZ = firstTileZ + t / tileColumns;
+            int lastX = std::min(gridSize, (tileX + 1) * BODY_TILE_SIZE);
+            int lastZ = std::min(gridSize, (tileZ + 1) * BODY_TILE_SIZE);
+            float low = FLT_MAX;
+            float high = -FLT_MAX;
+            for (int z = tileZ * BODY_TILE_SIZE; z < lastZ; ++z) {
+                for (int x = tileX * BODY_TILE_SIZE; x < lastX; ++x) {
+                    float y = grid[(z * gridSize + x) * 3 + 1];
+                    low = std::min(low, y);
+                    high = std::max(high, y);
+                }
+            }
+            tileLow[tileZ * tilesPerSide + tileX] = low;
+            tileHigh[tileZ * tilesPerSide + tileX] = high;
+        }
+    });
+}
+
+void IncrementalGrid::copyRect(const GridRect& rect, std::vector<float>& out) const {
+    out.resize(rect.area() * 3);
+    if (rect.empty()) {
+        return;
+    }
+    int width = rect.x1 - rect.x0;
+    for (int z = rect.z0; z < rect.z1; ++z) {
+        const float* row = &grid[(z * gridSize + rect.x0) * 3];
+        std::copy(row, row + width * 3, &out[(z - rect.z0) * width * 3]);
+    }
+}
+
+void IncrementalGrid::copyRectHeights(const GridRect& rect, std::vector<uint16_t>& out) const {
+    out.resize(rect.area());
+    if (rect.empty()) {
+        return;
+    }
+    int width = rect.x1 - rect.x0;
+    for (int z = rect.z0; z < rect.z1; ++z) {
+        floatsToHalves(&grid[(z * gridSize + rect.x0) * 3 + 1], width, 3, &out[(z - rect.z0) * width]);
+    }
+}
+
+void IncrementalGrid::tileBounds(float farField, float minDeformation, TileBounds& bounds) const {
+    int tileCount = tilesPerSide * tilesPerSide;
+    bounds.minY.resize(tileCount);
+    bounds.maxY.resize(tileCount);
+    // Adding the far field and clamping is monotonic, so it maps the relative range exactly.
+    for (int tile = 0; tile < tileCount; ++tile) {
+        bounds.minY[tile] = std::max(tileLow[tile] + farField, minDeformation);
+        bounds.maxY[tile] = std::max(tileHigh[tile] + farField, minDeformation);
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "body_field.h"
+
+class ThreadPool;
+
+// Lattice vertices [x0, x1) x [z0, z1).
+struct GridRect {
+    int x0 = 0;
+    int z0 = 0;
+    int x1 = 0;
+    int z1 = 0;
+
+    bool empty() const { return x0 >= x1 || z0 >= z1; }
+    int area() const { return empty() ? 0 : (x1 - x0) * (z1 - z0); }
+};
+
+// The CPU grid of the uniform lattice, kept from step to step and only recomputed where a
+// body changed.
+//
+// Heights are stored relative to the far field and unclamped,
+//     relative = sum of covering bodies' wells - sum of covering bodies' far fields
+// so the drawn height is max(relative + bins.farField, minDeformation) (the field of
+// body_field.h, summed in a different order). A mass change moves every vertex outside the
+// wells by the far-field term alone, which the shader adds as a uniform; only the changed
+// body's footprint is recomputed. Vertices no body reaches stay at 0 and are never touched.
+class IncrementalGrid {
+public:
+    explicit IncrementalGrid(int gridSize);
+
+    // Recomputes every vertex a body changed since the last update could reach (all of them on
+    // the first call) and returns that rectangle, empty when no body changed. bins must be
+    // binned from bodies.
+    GridRect update(const std::vector<Body>& bodies, const BodyBins& bins, ThreadPool& pool);
+
+    // xyz per lattice vertex, y relative as above.
+    const std::vector<float>& vertices() const { return grid; }
+
+    // Copies the rectangle's vertices into out, row by row.
+    void copyRect(const GridRect& rect, std::vector<float>& out) const;
+    // The same, heights only, as half floats (see vertex_format.h).
+    void copyRectHeights(const GridRect& rect, std::vector<uint16_t>& out) const;
+
+    // Exact height range of every bin tile for the given far field.
+    void tileBounds(float farField, float minDeformation, TileBounds& bounds) const;
+
+private:
+    void recompute(const GridRect& rect, const std::vector<Body>& bodies, const BodyBins& bins, ThreadPool& pool);
+
+    int gridSize;
+    int tilesPerSide;
+    std::vector<float> grid;
+    std::vector<float> tileLow;    // relative height range per bin tile
+    std::vector<float> tileHigh;
+    std::vector<Body>  builtFor;   // the bodies the heights are up to date with
+    bool built = false;
+};
@@ -0,0 +1,56 @@
+#include "lensing.h"
+
+#include <algorithm>
+#include <random>
+
+namespace {
+
+const unsigned int STAR_BACKGROUND_SEED = 4321;
+
+void addLight(std::vector<unsigned char>& rgba, int width, int height, int x, int y, const float* colour, float scale) {
+    if (x < 0 || y < 0 || x >= width || y >= height) {
+        return;
+    }
+    unsigned char* pixel = &rgba[((size_t)y * width + x) * 4];
+    for (int c = 0; c < 3; ++c) {
+        pixel[c] = (unsigned char)std::min(255.0f, pixel[c] + colour[c] * scale * 255.0f);
+    }
+}
+
+}
+
+LensTable::LensTable() {
+    samples.resize(LENS_TABLE_SIZE + 1);
+    for (int i = 0; i <= LENS_TABLE_SIZE; ++i) {
+        double xSquared = (double)i / LENS_TABLE_SIZE * LENS_TABLE_RADIUS * LENS_TABLE_RADIUS;
+        samples[i] = (float)(1.0 / (xSquared + (double)LENS_CORE * LENS_CORE));
+    }
+}
+
+void generateStarBackground(std::vector<unsigned char>& rgba, int width, int height, int count) {
+    rgba.assign((size_t)width * height * 4, 0);
+    for (size_t i = 3; i < rgba.size(); i += 4) {
+        rgba[i] = 255;
+    }
+
+    std::mt19937 gen(STAR_BACKGROUND_SEED);
+    std::uniform_int_distribution<int> column(0, width - 1);
+    std::uniform_int_distribution<int> row(0, height - 1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int i = 0; i < count; ++i) {
+        int x = column(gen);
+        int y = row(gen);
+        // A steep power law: most stars near the faint end.
+        float r = unit(gen);
+        float brightness = 0.2f + 0.8f * r * r * r * r;
+        float tint = unit(gen);
+        float colour[3] = { brightness * (0.85f + 0.15f * tint), brightness * (0.9f + 0.05f * tint), brightness * (1.0f - 0.2f * tint) };
+        addLight(rgba, width, height, x, y, colour, 1.0f);
+        if (brightness > 0.7f) {
+            addLight(rgba, width, height, x - 1, y, colour, 0.4f);
+            addLight(rgba, width, height, x + 1, y, colour, 0.4f);
+            addLight(rgba, width, height, x, y - 1, colour, 0.4f);
+            addLight(rgba, width, height, x, y + 1, colour, 0.4f);
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+// Gravitational lensing of the background stars by the planet, as a thin lens in screen space.
+// Positions are measured from the planet's projected centre in units of its apparent radius.
+// A background point at offset beta is seen at every theta with
+//
+//     beta = theta * (1 - strength * d(|theta|^2))
+//
+// where strength is the squared Einstein radius, and d the deflection per unit strength of a
+// Plummer-softened mass (core LENS_CORE): 1 / (x^2 + core^2), the point-mass 1 / x^2 once
+// outside the planet. The lensing pass evaluates this once per pixel, from the table below,
+// and samples the background there; no ray is traced.
+
+const float LENS_CORE = 0.5f;
+// Squared Einstein radius per unit of planet strength, so the ring leaves the planet's disc
+// around strength 10.
+const float LENS_STRENGTH_PER_MASS = 0.1f;
+
+// d baked into LENS_TABLE_SIZE + 1 samples over s = |theta|^2 / LENS_TABLE_RADIUS^2 in [0, 1],
+// laid out like ProfileTable for a linearly filtered 1D texture. Beyond the table d falls off
+// as the point mass does, d(1) / s.
+class LensTable {
+public:
+    static const int LENS_TABLE_SIZE = 1024;   // intervals
+    static constexpr float LENS_TABLE_RADIUS = 16.0f;
+
+    LensTable();
+
+    // What the shader computes, for thetaSquared = |theta|^2.
+    float deflection(float thetaSquared) const {
+        float s = thetaSquared / (LENS_TABLE_RADIUS * LENS_TABLE_RADIUS);
+        if (s >= 1.0f) {
+            return samples.back() / s;
+        }
+        float scaled = s * LENS_TABLE_SIZE;
+        int i = (int)scaled;
+        float t = scaled - i;
+        return samples[i] + t * (samples[i + 1] - samples[i]);
+    }
+
+    const float* data() const { return samples.data(); }
+    int sampleCount() const { return (int)samples.size(); }
+
+private:
+    std::vector<float> samples;
+};
+
+// A seeded star field for the lensing background: count stars scattered over a width x height
+// RGBA8 image (bottom row first), most of them faint single pixels, the few bright ones with a
+// small cross, and slightly tinted between blue-white and yellow.
+void generateStarBackground(std::vector<unsigned char>& rgba, int width, int height, int count);
@@ -0,0 +1,275 @@
+#include "lod_grid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "curvature.h"
+
+namespace {
+
+const int LOD_SPAN = 1 << LOD_MAX_DEPTH;
+
+typedef unsigned long long CellKey;
+
+CellKey cellKey(int level, int x, int z) {
+    return ((CellKey)level << 48) | ((CellKey)x << 24) | (CellKey)z;
+}
+
+struct Cell {
+    int level;
+    int x;
+    int z;
+};
+
+float latticeToWorld(int coordinate) {
+    return coordinate * (2.0f * GRID_SCALE / LOD_SPAN) - GRID_SCALE;
+}
+
+// Spacing wanted at distance dist from a body's centre.
+float targetSpacing(const Body& body, float dist) {
+    float influence = body.radius * 2.5f;
+    float finest = 2.0f * GRID_SCALE / LOD_SPAN;
+    float fine = std::max(finest, influence / LOD_FOOTPRINT_CELLS);
+    if (dist < influence) {
+        // Linear interpolation error goes with spacing^2 * curvature, and the well's curvature
+        // falls off as (n^2 + 0.1)^-1.5.
+        float normalizedDist = dist / influence;
+        return fine * std::pow((normalizedDist * normalizedDist + 0.1f) / 0.1f, 0.75f);
+    }
+    return fine * std::pow(11.0f, 0.75f) + (dist - influence) / LOD_RING_CELLS;
+}
+
+class LodBuilder {
+public:
+    LodBuilder(const std::vector<Body>& bodies) : bodies(bodies) {}
+
+    void build() {
+        std::vector<int> candidates(bodies.size());
+        for (int b = 0; b < (int)bodies.size(); ++b) {
+            candidates[b] = b;
+        }
+        subdivide(0, 0, 0, candidates);
+        balance();
+    }
+
+    void emit(GridTopology topology, std::vector<float>& vertices, GridIndices& indices);
+
+private:
+    // Splits until no candidate body wants finer spacing inside the cell. A body whose
+    // spacing already covers this cell can't want a split in any sub-cell, so it is dropped.
+    void subdivide(int level, int x, int z, const std::vector<int>& candidates) {
+        int size = LOD_SPAN >> level;
+        float cellSize = size * (2.0f * GRID_SCALE / LOD_SPAN);
+        float minX = latticeToWorld(x * size), maxX = latticeToWorld((x + 1) * size);
+        float minZ = latticeToWorld(z * size), maxZ = latticeToWorld((z + 1) * size);
+
+        std::vector<int> remaining;
+        for (int b : candidates) {
+            const Body& body = bodies[b];
+            float nearestX = std::min(std::max(body.x, minX), maxX) - body.x;
+            float nearestZ = std::min(std::max(body.z, minZ), maxZ) - body.z;
+            if (targetSpacing(body, std::sqrt(nearestX * nearestX + nearestZ * nearestZ)) < cellSize) {
+                remaining.push_back(b);
+            }
+        }
+
+        if (level < LOD_MAX_DEPTH && (level < LOD_MIN_DEPTH || !remaining.empty())) {
+            for (int child = 0; child < 4; ++child) {
+                subdivide(level + 1, x * 2 + (child & 1), z * 2 + (child >> 1), remaining);
+            }
+        }
+        else {
+            leaves.insert(cellKey(level, x, z));
+        }
+    }
+
+    // Level of the leaf covering same-level cell (x, z), or -1 outside the grid. Returns
+    // level + 1 when the area is covered by finer leaves.
+    int neighbourLevel(int level, int x, int z) const {
+        if (x < 0 || z < 0 || x >= (1 << level) || z >= (1 << level)) {
+            return -1;
+        }
+        for (int ancestor = level; ancestor >= 0; --ancestor) {
+            int shift = level - ancestor;
+            if (leaves.count(cellKey(ancestor, x >> shift, z >> shift))) {
+                return ancestor;
+            }
+        }
+        return level + 1;
+    }
+
+    void split(int level, int x, int z, std::vector<Cell>& pending) {
+        leaves.erase(cellKey(level, x, z));
+        for (int child = 0; child < 4; ++child) {
+            Cell cell = { level + 1, x * 2 + (child & 1), z * 2 + (child >> 1) };
+            leaves.insert(cellKey(cell.level, cell.x, cell.z));
+            pending.push_back(cell);
+        }
+    }
+
+    // Splits any leaf more than one level coarser than an edge neighbour.
+    void balance() {
+        std::vector<Cell> pending;
+        for (CellKey key : leaves) {
+            pending.push_back({ (int)(key >> 48), (int)((key >> 24) & 0xFFFFFF), (int)(key & 0xFFFFFF) });
+        }
+        const int offsets[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+        while (!pending.empty()) {
+            Cell cell = pending.back();
+            pending.pop_back();
+            if (!leaves.count(cellKey(cell.level, cell.x, cell.z))) {
+                continue;
+            }
+            for (const int* offset : offsets) {
+                int neighbourX = cell.x + offset[0];
+                int neighbourZ = cell.z + offset[1];
+                for (;;) {
+                    int level = neighbourLevel(cell.level, neighbourX, neighbourZ);
+                    if (level < 0 || level >= cell.level - 1) {
+                        break;
+                    }
+                    int shift = cell.level - level;
+                    split(level, neighbourX >> shift, neighbourZ >> shift, pending);
+                }
+            }
+        }
+    }
+
+    const std::vector<Body>& bodies;
+    std::unordered_set<CellKey> leaves;
+};
+
+template <typename Index>
+void emitLeaves(const std::vector<Cell>& cells, GridTopology topology, const std::vector<unsigned char>& finerSides,
+    std::unordered_map<CellKey, unsigned int>& vertexIndex, std::vector<float>& vertices, std::vector<Index>& out) {
+    auto vertex = [&](int x, int z) {
+        CellKey key = ((CellKey)x << 32) | (CellKey)z;
+        auto found = vertexIndex.find(key);
+        if (found != vertexIndex.end()) {
+            return (Index)found->second;
+        }
+        unsigned int index = (unsigned int)(vertices.size() / 3);
+        vertexIndex.emplace(key, index);
+        vertices.push_back(latticeToWorld(x));
+        vertices.push_back(0.0f);
+        vertices.push_back(latticeToWorld(z));
+        return (Index)index;
+    };
+    auto line = [&](Index a, Index b) {
+        out.push_back(a);
+        out.push_back(b);
+    };
+
+    for (size_t c = 0; c < cells.size(); ++c) {
+        const Cell& cell = cells[c];
+        int size = LOD_SPAN >> cell.level;
+        int half = size / 2;
+        int x0 = cell.x * size, x1 = x0 + size;
+        int z0 = cell.z * size, z1 = z0 + size;
+        // Sides: 0 = -x, 1 = +x, 2 = -z, 3 = +z.
+        unsigned char finer = finerSides[c];
+
+        if (topology == GridTopology::Triangles) {
+            if (!finer) {
+                Index v00 = vertex(x0, z0), v10 = vertex(x1, z0), v01 = vertex(x0, z1), v11 = vertex(x1, z1);
+                out.insert(out.end(), { v00, v10, v01, v10, v11, v01 });
+                continue;
+            }
+            // Fan around the centre through the corners and every shared midpoint.
+            Index ring[8];
+            int count = 0;
+            ring[count++] = vertex(x0, z0);
+            if (finer & 4) ring[count++] = vertex(x0 + half, z0);
+            ring[count++] = vertex(x1, z0);
+            if (finer & 2) ring[count++] = vertex(x1, z0 + half);
+            ring[count++] = vertex(x1, z1);
+            if (finer & 8) ring[count++] = vertex(x0 + half, z1);
+            ring[count++] = vertex(x0, z1);
+            if (finer & 1) ring[count++] = vertex(x0, z0 + half);
+            Index centre = vertex(x0 + half, z0 + half);
+            for (int i = 0; i < count; ++i) {
+                out.insert(out.end(), { centre, ring[i], ring[(i + 1) % count] });
+            }
+            continue;
+        }
+
+        // Each edge is drawn once: a leaf owns its -x and -z edges, plus +x / +z on the grid
+        // border. Edges next to finer leaves go through their midpoint.
+        auto edge = [&](int ax, int az, int bx, int bz, bool splitAtMidpoint) {
+            if (splitAtMidpoint) {
+                Index mid = vertex((ax + bx) / 2, (az + bz) / 2);
+                line(vertex(ax, az), mid);
+                line(mid, vertex(bx, bz));
+            }
+            else {
+                line(vertex(ax, az), vertex(bx, bz));
+            }
+        };
+        edge(x0, z0, x0, z1, (finer & 1) != 0);
+        edge(x0, z0, x1, z0, (finer & 4) != 0);
+        if (x1 == LOD_SPAN) edge(x1, z0, x1, z1, false);
+        if (z1 == LOD_SPAN) edge(x0, z1, x1, z1, false);
+        line(vertex(x1, z0), vertex(x0, z1));
+    }
+}
+
+void LodBuilder::emit(GridTopology topology, std::vector<float>& vertices, GridIndices& indices) {
+    std::vector<Cell> cells;
+    cells.reserve(leaves.size());
+    for (CellKey key : leaves) {
+        cells.push_back({ (int)(key >> 48), (int)((key >> 24) & 0xFFFFFF), (int)(key & 0xFFFFFF) });
+    }
+    // Row-major by position, so the vertex order is stable and roughly coherent.
+    std::sort(cells.begin(), cells.end(), [](const Cell& a, const Cell& b) {
+        int az = a.z << (LOD_MAX_DEPTH - a.level), bz = b.z << (LOD_MAX_DEPTH - b.level);
+        if (az != bz) return az < bz;
+        return (a.x << (LOD_MAX_DEPTH - a.level)) < (b.x << (LOD_MAX_DEPTH - b.level));
+    });
+
+    std::vector<unsigned char> finerSides(cells.size(), 0);
+    const int offsets[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+    for (size_t c = 0; c < cells.size(); ++c) {
+        for (int side = 0; side < 4; ++side) {
+            const Cell& cell = cells[c];
+            if (neighbourLevel(cell.level, cell.x + offsets[side][0], cell.z + offsets[side][1]) > cell.level) {
+                finerSides[c] |= 1 << side;
+            }
+        }
+    }
+
+    if (topology == GridTopology::LineStrips) {
+        topology = GridTopology::Lines;
+    }
+    std::unordered_map<CellKey, unsigned int> vertexIndex;
+    vertices.clear();
+    indices.topology = topology;
+    indices.shortIndices.clear();
+    indices.intIndices.clear();
+    emitLeaves(cells, topology, finerSides, vertexIndex, vertices, indices.intIndices);
+    indices.count = indices.intIndices.size();
+    // One chunk over the LOD lattice: the quadtree is already sparse away from the bodies.
+    GridChunk whole = { 0, indices.count, 0, 0, LOD_SPAN, LOD_SPAN };
+    indices.chunks.assign(1, whole);
+
+    // Same rule as buildGridIndices(): 16-bit whenever the vertices leave room for a restart index.
+    if (vertices.size() / 3 <= 0xFFFF) {
+        indices.indexSize = 2;
+        indices.restartIndex = 0xFFFF;
+        indices.shortIndices.assign(indices.intIndices.begin(), indices.intIndices.end());
+        indices.intIndices = std::vector<unsigned int>();
+    }
+    else {
+        indices.indexSize = 4;
+        indices.restartIndex = 0xFFFFFFFFu;
+    }
+}
+
+}
+
+void buildLodGrid(const std::vector<Body>& bodies, GridTopology topology, std::vector<float>& vertices, GridIndices& indices) {
+    LodBuilder builder(bodies);
+    builder.build();
+    builder.emit(topology, vertices, indices);
+}
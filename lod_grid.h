@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+
+#include "body_field.h"
+#include "grid_topology.h"
+
+// Finest LOD cell: the grid span split 2^LOD_MAX_DEPTH ways, i.e. the spacing of a
+// 2048 x 2048 uniform lattice.
+const int   LOD_MAX_DEPTH = 11;
+const int   LOD_MIN_DEPTH = 4;
+const float LOD_FOOTPRINT_CELLS = 128.0f;  // finest cells across a body's influence radius
+const float LOD_RING_CELLS = 8.0f;         // outside a footprint, cells per distance from it
+
+// Adaptive grid: a quadtree over [-GRID_SCALE, GRID_SCALE]^2 whose leaves are one quad each.
+//
+// A leaf is split while it is larger than the spacing wanted anywhere inside it. Inside a
+// body's footprint the spacing follows the well's curvature profile (finest at the centre,
+// about 6x coarser at the rim); outside it grows linearly with distance, so coarse rings
+// surround each well as in a clipmap. The spacing depends on body positions and radii only,
+// so the mesh stays valid while masses change.
+//
+// The tree is then balanced so neighbouring leaves differ by at most one level. A leaf next
+// to finer ones shares their edge midpoints instead of leaving T-junctions: lines are split
+// at the midpoint and triangles become a fan around the leaf centre. LineStrips is emitted as
+// Lines, since the leaves don't form long rows.
+//
+// vertices are the flat xyz positions (y = 0), displaced like the uniform lattice.
+void buildLodGrid(const std::vector<Body>& bodies, GridTopology topology, std::vector<float>& vertices, GridIndices& indices);
@@ -3,17 +3,58 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
-#include <random>
+#include <memory>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#ifdef SPACETIME_COUNT_ALLOCATIONS
+#include "allocation_counter.h"
+#endif
+#include "body_field.h"
+#include "curvature.h"
+#include "disk_cache.h"
+#include "frame_capture.h"
+#include "frame_report.h"
+#include "frame_scheduler.h"
+#include "frame_writer.h"
+#include "grid_culling.h"
+#include "grid_shader.h"
+#include "grid_topology.h"
+#include "headless_context.h"
+#include "lensing.h"
+#include "lod_grid.h"
+#include "mesh.h"
+#include "mesh_cache.h"
+#include "profiler.h"
+#include "radial_profile.h"
+#include "render_state.h"
+#include "shader_program.h"
+#include "simulation.h"
+#include "stream_buffer.h"
+#include "thread_pool.h"
+#include "transform.h"
+#include "vertex_format.h"
 
 const int   WIDTH = 1920;
 const int   HEIGHT = 1080;
-const int   GRID_SIZE = 200;
-const float GRID_SCALE = 100.0f;
-const int   NUM_STARS = 300;
 const float STAR_SIZE = 1.5f;
+const int   LENS_STAR_COUNT = 6000;
 const float MASS_CHANGE_SPEED_FAST = 5.0f;
 const float MASS_CHANGE_SPEED_SLOW = 1.0f;
-const float PI = 3.14159265358979323846f;
+const float HEADLESS_RAMP_PEAK_MASS = 20.0f;
+// A held key changes the mass by at most this many seconds' worth per frame, so the first
+// frame after an idle wait doesn't apply the whole wait.
+const float MAX_INPUT_DELTA = 0.1f;
+// Below this rate a frame spans more satellite steps than one simulation step runs
+// (SATELLITE_MAX_STEPS), and the satellites would slow down.
+const float MIN_ANIMATION_FPS = 15.0f;
+// Frames a windowed --report holds before its sample buffer has to grow (10 minutes at 60 Hz).
+const int   WINDOWED_REPORT_FRAMES = 36000;
 
 float sphereX = 0.0f;
 float sphereY = 0.0f;
@@ -21,335 +62,261 @@ float sphereZ = 0.0f;
 float sphereRadius = 5.0f;
 float sphereStrength = 0.0f;
 float minDeformation = -5.0f;
-
-float satX = 0.0f;
-float satY = 0.0f;
-float satZ = 0.0f;
+bool  gpuDeformation = true;
+int   gridSize = GRID_SIZE;
+int   extraBodies = 0;
+GridTopology gridTopology = GridTopology::LineStrips;
+bool  lodGrid = false;
+bool  chunkCulling = true;
+RadialProfile curvatureProfile = RadialProfile::Softened;
+int   workerThreads = 0;
+bool  persistentStreaming = true;
+bool  compactVertices = false;
+bool  assertNoAllocations = false;
+bool  simulationThreaded = true;
+bool  headless = false;
+int   headlessFrames = 600;
+std::string reportPrefix;
+bool  profiling = false;
+std::string tracePath;
+std::string capturePath;
+std::string cacheDirectory = defaultCacheDirectory();
+bool  lensing = true;
+float lensScale = 1.0f;
+bool  continuousRendering = false;
+float maxFps = 0.0f;
+float animationFps = 30.0f;
+int   swapInterval = 1;
+float idleSeconds = 0.0f;
+
+int   satelliteCount = 1;
 float orbitalRadius = 10.0f;
-float satAngle = 0.0f;
-float satSpeed = 0.015f;
 float satMeshRadius = 0.3f;
 
-void multiplyMatrix(const float a[16], const float b[16], float result[16]) {
-    for (int i = 0; i < 4; ++i) {
-        for (int j = 0; j < 4; ++j) {
-            result[i * 4 + j] = 0.0f;
-            for (int k = 0; k < 4; ++k) {
-                result[i * 4 + j] += a[i * 4 + k] * b[k * 4 + j];
-            }
-        }
-    }
+bool isKeyDown(GLFWwindow* window, int key) {
+    return window && glfwGetKey(window, key) == GLFW_PRESS;
 }
 
-void perspectiveMatrix(float fovY, float aspectRatio, float nearZ, float farZ, float result[16]) {
-    float tanHalfFovY = tan(fovY / 2.0f);
-    float range = farZ - nearZ;
-
-    result[0] = 1.0f / (aspectRatio * tanHalfFovY);
-    result[1] = 0.0f;
-    result[2] = 0.0f;
-    result[3] = 0.0f;
-
-    result[4] = 0.0f;
-    result[5] = 1.0f / tanHalfFovY;
-    result[6] = 0.0f;
-    result[7] = 0.0f;
-
-    result[8] = 0.0f;
-    result[9] = 0.0f;
-    result[10] = -((farZ + nearZ) / range);
-    result[11] = -1.0f;
-
-    result[12] = 0.0f;
-    result[13] = 0.0f;
-    result[14] = -((2.0f * farZ * nearZ) / range);
-    result[15] = 0.0f;
+// Window callbacks: a key or anything that damages the window needs a new frame.
+void requestFrame(GLFWwindow* window) {
+    static_cast<FrameScheduler*>(glfwGetWindowUserPointer(window))->requestFrame();
 }
 
-void lookAtMatrix(float eyeX, float eyeY, float eyeZ, float centerX, float centerY, float centerZ, float upX, float upY, float upZ, float result[16]) {
-    float forward[3];
-    forward[0] = centerX - eyeX;
-    forward[1] = centerY - eyeY;
-    forward[2] = centerZ - eyeZ;
-
-    float forwardLength = sqrt(forward[0] * forward[0] + forward[1] * forward[1] + forward[2] * forward[2]);
-    forward[0] /= forwardLength;
-    forward[1] /= forwardLength;
-    forward[2] /= forwardLength;
-
-    float right[3];
-    right[0] = upY * forward[2] - upZ * forward[1];
-    right[1] = upZ * forward[0] - upX * forward[2];
-    right[2] = upX * forward[1] - upY * forward[0];
-
-    float rightLength = sqrt(right[0] * right[0] + right[1] * right[1] + right[2] * right[2]);
-    right[0] /= rightLength;
-    right[1] /= rightLength;
-    right[2] /= rightLength;
-
-    float up[3];
-    up[0] = forward[1] * right[2] - forward[2] * right[1];
-    up[1] = forward[2] * right[0] - forward[0] * right[2];
-    up[2] = forward[0] * right[1] - forward[1] * right[0];
-
-    result[0] = right[0];
-    result[1] = up[0];
-    result[2] = -forward[0];
-    result[3] = 0.0f;
-
-    result[4] = right[1];
-    result[5] = up[1];
-    result[6] = -forward[1];
-    result[7] = 0.0f;
-
-    result[8] = right[2];
-    result[9] = up[2];
-    result[10] = -forward[2];
-    result[11] = 0.0f;
-
-    result[12] = -(right[0] * eyeX + right[1] * eyeY + right[2] * eyeZ);
-    result[13] = -(up[0] * eyeX + up[1] * eyeY + up[2] * eyeZ);
-    result[14] = -(-forward[0] * eyeX - forward[1] * eyeY - forward[2] * eyeZ);
-    result[15] = 1.0f;
+// Heap allocations since startup, or 0 when the build doesn't count them (configure with
+// -DSPACETIME_COUNT_ALLOCATIONS=ON to link allocation_counter.cpp).
+unsigned long long allocationsSoFar() {
+#ifdef SPACETIME_COUNT_ALLOCATIONS
+    return allocationCount();
+#else
+    return 0;
+#endif
 }
 
-GLuint createShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource) {
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-
-    GLint success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-        return 0;
-    }
-
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-        return 0;
-    }
-
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-        return 0;
-    }
-
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-
-    return shaderProgram;
+// Scripted mass for headless runs: ramps up to the peak over the first half and back down.
+float headlessRampMass(int frame, int frameCount) {
+    float t = frameCount > 1 ? (float)frame / (float)(frameCount - 1) : 0.0f;
+    return HEADLESS_RAMP_PEAK_MASS * (1.0f - std::fabs(2.0f * t - 1.0f));
 }
 
-void generateSphere(std::vector<float>& vertices, std::vector<unsigned int>& indices, float radius, int segments) {
-    vertices.clear();
-    indices.clear();
-
-    for (int y = 0; y <= segments; ++y) {
-        float v = (float)y / (float)segments;
-        float phi = v * PI;
-
-        for (int x = 0; x <= segments; ++x) {
-            float u = (float)x / (float)segments;
-            float theta = u * 2.0f * PI;
-
-            float xPos = radius * sin(phi) * cos(theta);
-            float yPos = radius * cos(phi);
-            float zPos = radius * sin(phi) * sin(theta);
-
-            vertices.push_back(xPos);
-            vertices.push_back(yPos);
-            vertices.push_back(zPos);
+int main(int argc, char** argv) {
+    auto processStart = std::chrono::steady_clock::now();
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            workerThreads = std::atoi(argv[++i]);
         }
-    }
-
-    for (int y = 0; y < segments; ++y) {
-        for (int x = 0; x < segments; ++x) {
-            int p1 = y * (segments + 1) + x;
-            int p2 = p1 + 1;
-            int p3 = (y + 1) * (segments + 1) + x;
-            int p4 = p3 + 1;
-
-            indices.push_back(p1);
-            indices.push_back(p2);
-            indices.push_back(p3);
-
-            indices.push_back(p2);
-            indices.push_back(p4);
-            indices.push_back(p3);
+        else if (std::strcmp(argv[i], "--grid-size") == 0 && i + 1 < argc && std::atof(argv[i + 1]) <= MAX_GRID_SIZE) {
+            gridSize = std::max(2, std::atoi(argv[++i]));
         }
-    }
-}
-
-void generateGrid(std::vector<float>& vertices, std::vector<unsigned int>& indices, float sphereX, float sphereZ, float sphereRadius, float sphereStrength, float minDeformation) {
-    vertices.clear();
-    indices.clear();
-    for (int z = 0; z < GRID_SIZE; ++z) {
-        for (int x = 0; x < GRID_SIZE; ++x) {
-            float xPos = (x - GRID_SIZE / 2.0f) / (float)(GRID_SIZE / 2.0f) * GRID_SCALE;
-            float zPos = (z - GRID_SIZE / 2.0f) / (float)(GRID_SIZE / 2.0f) * GRID_SCALE;
-
-            float yPos = 0.0f;
-
-            float distX = xPos - sphereX;
-            float distZ = zPos - sphereZ;
-            float dist = std::sqrt(distX * distX + distZ * distZ);
-            float normalizedDist = dist / (sphereRadius * 2.5f);
-
-            if (dist < sphereRadius * 2.5f) {
-                float deformation = -sphereStrength * 2.0f * (1.0f / (std::sqrt(std::pow(normalizedDist, 2.0f) + 0.1f)) - 1.0f);
-
-                if (normalizedDist < 1.0f)
-                    yPos = deformation;
-                else
-                    yPos = -sphereStrength * 0.1f;
-            }
-            else {
-                yPos = -sphereStrength * 0.1f;
-            }
-
-            if (yPos < minDeformation) {
-                yPos = minDeformation;
-            }
-
-            vertices.push_back(xPos);
-            vertices.push_back(yPos);
-            vertices.push_back(zPos);
-
-            if (x < GRID_SIZE - 1 && z < GRID_SIZE - 1) {
-                int current = z * GRID_SIZE + x;
-
-                indices.push_back(current);
-                indices.push_back(current + 1);
-                indices.push_back(current + GRID_SIZE);
-
-                indices.push_back(current + 1);
-                indices.push_back(current + GRID_SIZE + 1);
-                indices.push_back(current + GRID_SIZE);
-            }
+        else if (std::strcmp(argv[i], "--grid-topology") == 0 && i + 1 < argc && parseGridTopology(argv[i + 1], gridTopology)) {
+            ++i;
+        }
+        else if (std::strcmp(argv[i], "--curvature") == 0 && i + 1 < argc && parseRadialProfile(argv[i + 1], curvatureProfile)) {
+            ++i;
+        }
+        else if (std::strcmp(argv[i], "--lod") == 0) {
+            lodGrid = true;
+        }
+        else if (std::strcmp(argv[i], "--no-cull") == 0) {
+            chunkCulling = false;
+        }
+        else if (std::strcmp(argv[i], "--no-sim-thread") == 0) {
+            simulationThreaded = false;
+        }
+        else if (std::strcmp(argv[i], "--no-buffer-storage") == 0) {
+            persistentStreaming = false;
+        }
+        else if (std::strcmp(argv[i], "--compact-vertices") == 0) {
+            compactVertices = true;
+        }
+        else if (std::strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        }
+        else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            headlessFrames = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--report") == 0 && i + 1 < argc) {
+            reportPrefix = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--assert-no-alloc") == 0) {
+#ifndef SPACETIME_COUNT_ALLOCATIONS
+            std::cerr << "--assert-no-alloc needs a build configured with -DSPACETIME_COUNT_ALLOCATIONS=ON" << std::endl;
+            return -1;
+#endif
+            assertNoAllocations = true;
+        }
+        else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            capturePath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc) {
+            cacheDirectory = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--no-cache") == 0) {
+            cacheDirectory.clear();
+        }
+        else if (std::strcmp(argv[i], "--no-lens") == 0) {
+            lensing = false;
+        }
+        else if (std::strcmp(argv[i], "--lens-scale") == 0 && i + 1 < argc) {
+            lensScale = std::min(1.0f, std::max(0.1f, (float)std::atof(argv[++i])));
+        }
+        else if (std::strcmp(argv[i], "--continuous") == 0) {
+            continuousRendering = true;
+        }
+        else if (std::strcmp(argv[i], "--max-fps") == 0 && i + 1 < argc) {
+            maxFps = std::max(0.0f, (float)std::atof(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--animation-fps") == 0 && i + 1 < argc) {
+            animationFps = std::max(MIN_ANIMATION_FPS, (float)std::atof(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--swap-interval") == 0 && i + 1 < argc) {
+            swapInterval = std::min(4, std::max(-1, std::atoi(argv[++i])));
+        }
+        else if (std::strcmp(argv[i], "--idle-seconds") == 0 && i + 1 < argc) {
+            idleSeconds = std::max(0.0f, (float)std::atof(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--profile") == 0) {
+            profiling = true;
+        }
+        else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+            profiling = true;
+        }
+        else if (std::strcmp(argv[i], "--bodies") == 0 && i + 1 < argc) {
+            extraBodies = std::max(0, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--satellites") == 0 && i + 1 < argc) {
+            satelliteCount = std::max(0, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--cpu-deformation") == 0) {
+            gpuDeformation = false;
+        }
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--grid-size N (2-" << MAX_GRID_SIZE << ")] [--grid-topology triangles|lines|strips] [--curvature softened|plummer|flamm] [--lod] [--no-cull] [--bodies N] [--satellites N] [--threads N] [--cpu-deformation] [--no-buffer-storage] [--compact-vertices] [--no-sim-thread] [--headless [--frames N] [--idle-seconds S]] [--report PREFIX] [--assert-no-alloc] [--capture FILE.y4m|FILE.png] [--cache-dir DIR | --no-cache] [--no-lens | --lens-scale F] [--continuous] [--max-fps N] [--animation-fps N] [--swap-interval N] [--profile] [--trace FILE]" << std::endl;
+            return -1;
         }
     }
-}
-
-void generateStars(std::vector<float>& vertices) {
-    vertices.clear();
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> dis(-50.0f, 50.0f);
-
-    for (int i = 0; i < NUM_STARS; ++i) {
-        vertices.push_back(dis(gen));
-        vertices.push_back(dis(gen));
-        vertices.push_back(dis(gen));
+    if (headless && reportPrefix.empty()) {
+        reportPrefix = "frame_times";
     }
-}
-
-float computeLowestGridY(float sphereX, float sphereZ, float sphereRadius, float sphereStrength, float minDeformation) {
-    float lowestY = 0.0f;
-    for (int z = 0; z < GRID_SIZE; ++z) {
-        for (int x = 0; x < GRID_SIZE; ++x) {
-            float xPos = (x - GRID_SIZE / 2.0f) / (float)(GRID_SIZE / 2.0f) * GRID_SCALE;
-            float zPos = (z - GRID_SIZE / 2.0f) / (float)(GRID_SIZE / 2.0f) * GRID_SCALE;
-
-            float distX = xPos - sphereX;
-            float distZ = zPos - sphereZ;
-            float dist = std::sqrt(distX * distX + distZ * distZ);
-
-            float normalizedDist = dist / (sphereRadius * 2.5f);
-
-            if (dist < sphereRadius * 2.5f) {
-                float deformation = -sphereStrength * 2.0f * (1.0f / (std::sqrt(std::pow(normalizedDist, 2.0f) + 0.1f)) - 1.0f);
-                if (normalizedDist < 1.0f && deformation < lowestY) {
-                    lowestY = deformation;
-                }
-                else if (deformation < lowestY) {
-                    lowestY = -sphereStrength * 0.1f;
-                }
-            }
-            else if ((-sphereStrength * 0.1f) < lowestY) {
-                lowestY = -sphereStrength * 0.1f;
-            }
 
-            if (lowestY < minDeformation) {
-                lowestY = minDeformation;
-            }
+    GLFWwindow* window = nullptr;
+    if (headless) {
+        if (!createHeadlessContext()) {
+            return -1;
         }
     }
-    return lowestY;
-}
-
-int main() {
-    if (!glfwInit()) {
-        std::cerr << "Failed to initialize GLFW" << std::endl;
-        return -1;
-    }
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    GLFWwindow* window = glfwCreateWindow(WIDTH, HEIGHT, "Spacetime Curvature", nullptr, nullptr);
-    if (!window) {
-        std::cerr << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+    else {
+        if (!glfwInit()) {
+            std::cerr << "Failed to initialize GLFW" << std::endl;
+            return -1;
+        }
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        window = glfwCreateWindow(WIDTH, HEIGHT, "Spacetime Curvature", nullptr, nullptr);
+        if (!window) {
+            std::cerr << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        // -1 swaps late frames immediately instead of waiting a whole extra refresh, where the
+        // driver supports it.
+        bool tearControl = glfwExtensionSupported("GLX_EXT_swap_control_tear") || glfwExtensionSupported("WGL_EXT_swap_control_tear");
+        glfwSwapInterval(swapInterval < 0 && !tearControl ? 1 : swapInterval);
     }
-    glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);
-    if (glewInit() != GLEW_OK) {
+    // GLEW built for GLX reports a missing X display under EGL even though the GL entry points loaded fine.
+    GLenum glewStatus = glewInit();
+    if (glewStatus != GLEW_OK && !(headless && glewStatus == GLEW_ERROR_NO_GLX_DISPLAY)) {
         std::cerr << "Failed to initialize GLEW" << std::endl;
-        glfwTerminate();
+        if (headless)
+            destroyHeadlessContext();
+        else
+            glfwTerminate();
         return -1;
     }
 
-    const char* gridVertexShaderSource = R"(
+    const char* sphereVertexShaderSource = R"(
         #version 330 core
         layout (location = 0) in vec3 aPos;
 
         uniform mat4 model;
-        uniform mat4 view;
-        uniform mat4 projection;
+        layout(std140) uniform Camera {
+            mat4 view;
+            mat4 projection;
+            mat4 viewProjection;
+        };
+        uniform float meshScale;   // the mesh radius for quantized positions, else 1
 
         void main() {
-            gl_Position = projection * view * model * vec4(aPos, 1.0);
+            gl_Position = viewProjection * model * vec4(aPos * meshScale, 1.0);
         }
     )";
 
-    const char* gridFragmentShaderSource = R"(
+    const char* sphereFragmentShaderSource = R"(
         #version 330 core
         out vec4 FragColor;
 
         void main() {
-            FragColor = vec4(0.8f, 0.8f, 0.8f, 1.0f);
+            FragColor = vec4(1.0f, 1.0f, 1.0f, 1.0f);
         }
     )";
 
-    const char* sphereVertexShaderSource = R"(
+    const char* satelliteVertexShaderSource = R"(
         #version 330 core
         layout (location = 0) in vec3 aPos;
+        layout (location = 1) in vec3 aOffset;
 
-        uniform mat4 model;
-        uniform mat4 view;
-        uniform mat4 projection;
+        layout(std140) uniform Camera {
+            mat4 view;
+            mat4 projection;
+            mat4 viewProjection;
+        };
+        uniform float meshScale;
 
         void main() {
-            gl_Position = projection * view * model * vec4(aPos, 1.0);
+            gl_Position = viewProjection * vec4(aPos * meshScale + aOffset, 1.0);
         }
     )";
 
-    const char* sphereFragmentShaderSource = R"(
+    const char* starVertexShaderSource = R"(
+        #version 330 core
+        layout (location = 0) in vec3 aPos;
+
+        layout(std140) uniform Camera {
+            mat4 view;
+            mat4 projection;
+            mat4 viewProjection;
+        };
+        uniform float pointSize;
+
+        void main() {
+            gl_Position = viewProjection * vec4(aPos, 1.0);
+            gl_PointSize = pointSize;
+        }
+    )";
+
+    const char* starFragmentShaderSource = R"(
         #version 330 core
         out vec4 FragColor;
 
@@ -358,52 +325,176 @@ int main() {
         }
     )";
 
-    const char* starVertexShaderSource = R"(
+    // One full-screen triangle, no vertex attributes.
+    const char* lensVertexShaderSource = R"(
         #version 330 core
-        layout (location = 0) in vec3 aPos;
-
-        uniform mat4 view;
-        uniform mat4 projection;
-        uniform float pointSize;
+        out vec2 screenPos;
 
         void main() {
-            gl_Position = projection * view * vec4(aPos, 1.0);
-            gl_PointSize = pointSize;
+            vec2 corner = vec2(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0);
+            screenPos = corner;
+            gl_Position = vec4(corner, 0.0, 1.0);
         }
     )";
 
-    const char* starFragmentShaderSource = R"(
+    // The thin lens of lensing.h: positions are in units of the planet's apparent radius
+    // around its projected centre, and the deflection comes from the baked table.
+    const char* lensFragmentShaderSource = R"(
         #version 330 core
+        in vec2 screenPos;
         out vec4 FragColor;
 
+        uniform sampler2D starTexture;
+        uniform sampler1D lensTable;
+        uniform float lensTableSize;
+        uniform float lensTableRadius;
+        uniform float lensCentreX;
+        uniform float lensCentreY;
+        uniform float lensRadius;     // apparent planet radius, in NDC heights
+        uniform float lensStrength;   // squared Einstein radius, in planet radii
+        uniform float aspect;
+
         void main() {
-            FragColor = vec4(1.0f, 1.0f, 1.0f, 1.0f);
+            vec2 centre = vec2(lensCentreX * aspect, lensCentreY);
+            vec2 theta = (vec2(screenPos.x * aspect, screenPos.y) - centre) / lensRadius;
+            float s = dot(theta, theta) / (lensTableRadius * lensTableRadius);
+            float deflection = s < 1.0
+                ? texture(lensTable, (s * lensTableSize + 0.5) / (lensTableSize + 1.0)).r
+                : texelFetch(lensTable, int(lensTableSize), 0).r / s;
+            vec2 beta = theta * (1.0 - lensStrength * deflection);
+            vec2 source = centre + beta * lensRadius;
+            FragColor = texture(starTexture, vec2(source.x / aspect, source.y) * 0.5 + 0.5);
         }
     )";
 
-    GLuint gridShaderProgram = createShaderProgram(gridVertexShaderSource, gridFragmentShaderSource);
-    GLuint sphereShaderProgram = createShaderProgram(sphereVertexShaderSource, sphereFragmentShaderSource);
-    GLuint starShaderProgram = createShaderProgram(starVertexShaderSource, starFragmentShaderSource);
+    const ShaderSource shaderSources[5] = {
+        { GRID_VERTEX_SHADER_SOURCE, GRID_FRAGMENT_SHADER_SOURCE },
+        { sphereVertexShaderSource, sphereFragmentShaderSource },
+        { starVertexShaderSource, starFragmentShaderSource },
+        { satelliteVertexShaderSource, sphereFragmentShaderSource },
+        { lensVertexShaderSource, lensFragmentShaderSource },
+    };
+    ShaderProgram shaderPrograms[5];
+    ShaderBuildStats shaderStats;
+    if (!createShaderPrograms(shaderSources, 5, cacheDirectory, shaderPrograms, shaderStats)) {
+        if (headless)
+            destroyHeadlessContext();
+        else
+            glfwTerminate();
+        return -1;
+    }
+    ShaderProgram& gridShaderProgram = shaderPrograms[0];
+    ShaderProgram& sphereShaderProgram = shaderPrograms[1];
+    ShaderProgram& starShaderProgram = shaderPrograms[2];
+    ShaderProgram& satelliteShaderProgram = shaderPrograms[3];
+    ShaderProgram& lensShaderProgram = shaderPrograms[4];
+    std::printf("Shaders: %d programs in %.1f ms (%s", shaderStats.programs, shaderStats.ms, shaderStats.cacheEnabled ? "" : "no binary cache");
+    if (shaderStats.cacheEnabled) {
+        std::printf("%d from cache, %d rejected", shaderStats.cacheHits, shaderStats.cacheRejected);
+    }
+    std::printf("%s)\n", shaderStats.parallelCompile ? ", parallel compile" : "");
+
+    // Generated meshes are mapped from the cache directory when an earlier run stored them and
+    // uploaded straight from the mapping; otherwise they're built into the vectors given and
+    // stored for the next run. The views stay valid as long as those vectors and mappings.
+    int meshCount = 0, meshCacheHits = 0;
+    double meshMs = 0.0;
+    auto cachedMesh = [&](MappedMesh& mapped, const char* kind, const void* params, size_t paramsSize, auto build) {
+        auto start = std::chrono::steady_clock::now();
+        ++meshCount;
+        MeshView mesh;
+        uint64_t key = meshCacheKey(kind, params, paramsSize);
+        std::string path = cacheDirectory.empty() ? std::string() : cacheFilePath(cacheDirectory, key, ".mesh");
+        if (!path.empty() && mapped.open(path, key)) {
+            ++meshCacheHits;
+            mesh = mapped.view();
+        }
+        else {
+            mesh = build();
+            if (!path.empty() && !writeMeshFile(path, key, mesh)) {
+                std::cerr << "Failed to write mesh cache " << path << std::endl;
+            }
+        }
+        meshMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return mesh;
+    };
 
     std::vector<float>    gridVertices;
-    std::vector<unsigned int> gridIndices;
+    GridIndices gridIndices;
+    MappedMesh gridMapped;
 
     std::vector<float>    sphereVertices;
     std::vector<unsigned int> sphereIndices;
+    MappedMesh sphereMapped;
 
-    float sphereMeshRadius = 1.0f;
-    int   sphereSegments = 30;
-    generateSphere(sphereVertices, sphereIndices, sphereMeshRadius, sphereSegments);
+    struct SphereParams {
+        float radius;
+        int   segments;
+    };
+    SphereParams sphereParams = { 1.0f, 30 };
+    float sphereMeshRadius = sphereParams.radius;
+    MeshView sphereMesh = cachedMesh(sphereMapped, "sphere", &sphereParams, sizeof(sphereParams), [&] {
+        generateSphere(sphereVertices, sphereIndices, sphereParams.radius, sphereParams.segments);
+        return meshView(sphereVertices, sphereIndices);
+    });
 
     std::vector<float>    satelliteVertices;
     std::vector<unsigned int> satelliteIndices;
-    int   satelliteSegments = 20;
-    generateSphere(satelliteVertices, satelliteIndices, satMeshRadius, satelliteSegments);
+    MappedMesh satelliteMapped;
+    // Large swarms get a low-poly mesh; a single satellite keeps the original detail.
+    SphereParams satelliteParams = { satMeshRadius, satelliteCount > 1000 ? 6 : 20 };
+    MeshView satelliteMesh = cachedMesh(satelliteMapped, "sphere", &satelliteParams, sizeof(satelliteParams), [&] {
+        generateSphere(satelliteVertices, satelliteIndices, satelliteParams.radius, satelliteParams.segments);
+        return meshView(satelliteVertices, satelliteIndices);
+    });
 
     std::vector<float> starVertices;
-    generateStars(starVertices);
-    generateGrid(gridVertices, gridIndices, sphereX, sphereZ, sphereRadius, sphereStrength, minDeformation);
-    sphereY = computeLowestGridY(sphereX, sphereZ, sphereRadius, sphereStrength, minDeformation) + sphereRadius + sphereMeshRadius + 0.1f;
+    generateStars(starVertices, NUM_STARS);
+    ThreadPool gridWorkers(workerThreads);
+
+    // bodies[0] is the planet driven by the keyboard; the rest are scattered by --bodies.
+    std::vector<Body> bodies = { { sphereX, sphereZ, sphereRadius, sphereStrength } };
+    scatterBodies(bodies, extraBodies);
+    std::vector<float> bodyTexels(bodies.size() * 4);
+
+    // gridMesh is the flat mesh the GPU path deforms: the LOD quadtree around the bodies,
+    // or the uniform lattice (with zero strength the CPU generator yields it flat). The LOD
+    // grid depends on every body, so its key covers a hash of them.
+    MeshView gridMesh;
+    if (lodGrid) {
+        uint64_t lodParams[2] = { hashBytes(bodies.data(), bodies.size() * sizeof(Body)), (uint64_t)gridTopology };
+        gridMesh = cachedMesh(gridMapped, "lod grid", lodParams, sizeof(lodParams), [&] {
+            buildLodGrid(bodies, gridTopology, gridVertices, gridIndices);
+            return meshView(gridVertices, gridIndices);
+        });
+    }
+    else {
+        struct LatticeParams {
+            int   gridSize;
+            int   topology;
+            int   chunkSize;
+            float sphereX, sphereZ, sphereRadius, minDeformation;
+        };
+        LatticeParams latticeParams = { gridSize, (int)gridTopology, GRID_CHUNK_SIZE, sphereX, sphereZ, sphereRadius, minDeformation };
+        gridMesh = cachedMesh(gridMapped, "lattice", &latticeParams, sizeof(latticeParams), [&] {
+            buildGridIndices(gridSize, gridTopology, gridIndices, GRID_CHUNK_SIZE);
+            generateGrid(gridVertices, sphereX, sphereZ, sphereRadius, 0.0f, minDeformation, gridSize, gridWorkers);
+            return meshView(gridVertices, gridIndices);
+        });
+    }
+    if (cacheDirectory.empty()) {
+        std::printf("Meshes: %d in %.1f ms (no cache)\n", meshCount, meshMs);
+    }
+    else {
+        std::printf("Meshes: %d in %.1f ms (%d from cache)\n", meshCount, meshMs, meshCacheHits);
+    }
+    int gridVertexCount = (int)gridMesh.vertexCount;
+    // Chunk bounds are small and read every frame by culling, so they get their own copy.
+    std::vector<GridChunk> gridChunks(gridMesh.chunks, gridMesh.chunks + gridMesh.chunkCount);
+    // Compact vertices store a CPU grid vertex as one half-float height: the lattice rebuilds
+    // xz from gl_VertexID and needs no flat mesh at all, the LOD grid reads xz from the flat one.
+    bool latticeFromVertexId = compactVertices && !lodGrid;
+    size_t gridVertexBytes = compactVertices ? sizeof(uint16_t) : 3 * sizeof(float);
 
     GLuint gridVAO, gridVBO, gridEBO;
     glGenVertexArrays(1, &gridVAO);
@@ -411,15 +502,155 @@ int main() {
     glGenBuffers(1, &gridEBO);
 
     glBindVertexArray(gridVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, gridVBO);
-    glBufferData(GL_ARRAY_BUFFER, gridVertices.size() * sizeof(float), gridVertices.data(), GL_STATIC_DRAW);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gridEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, gridIndices.size() * sizeof(unsigned int), gridIndices.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, gridMesh.indexBytes(), gridMesh.indices, GL_STATIC_DRAW);
+    if (!latticeFromVertexId) {
+        glBindBuffer(GL_ARRAY_BUFFER, gridVBO);
+        glBufferData(GL_ARRAY_BUFFER, gridMesh.vertexBytes(), gridMesh.vertices, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    // gridVBO keeps the flat mesh for the GPU path. On the CPU path the uniform lattice keeps
+    // one copy of the deformed grid and patches the rows each step changed in place; the LOD
+    // grid is rebuilt whole every step and streams through a ring of regions instead.
+    std::unique_ptr<StreamBuffer> gridStream;
+    GLuint gridPatchVBO = 0;
+    if (lodGrid) {
+        // Compact regions are padded to 4 bytes so every region starts aligned.
+        size_t regionSize = compactVertices ? (gridVertexCount * gridVertexBytes + 3) & ~(size_t)3 : gridMesh.vertexBytes();
+        gridStream.reset(new StreamBuffer(regionSize, gridVertexBytes, persistentStreaming));
+    }
+    else {
+        glGenBuffers(1, &gridPatchVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, gridPatchVBO);
+        if (compactVertices) {
+            std::vector<uint16_t> flatHeights(gridVertexCount, floatToHalf(0.0f));
+            glBufferData(GL_ARRAY_BUFFER, flatHeights.size() * sizeof(uint16_t), flatHeights.data(), GL_DYNAMIC_DRAW);
+        }
+        else {
+            glBufferData(GL_ARRAY_BUFFER, gridMesh.vertexBytes(), gridMesh.vertices, GL_DYNAMIC_DRAW);
+        }
+    }
+
+    GLuint gridCpuVAO;
+    glGenVertexArrays(1, &gridCpuVAO);
+    glBindVertexArray(gridCpuVAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gridEBO);
+    if (!compactVertices) {
+        glBindBuffer(GL_ARRAY_BUFFER, gridStream ? gridStream->buffer() : gridPatchVBO);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+    }
+    else {
+        // The LOD heights are re-pointed at the current ring region before each draw.
+        if (lodGrid) {
+            glBindBuffer(GL_ARRAY_BUFFER, gridVBO);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+            glEnableVertexAttribArray(0);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, gridStream ? gridStream->buffer() : gridPatchVBO);
+        glVertexAttribPointer(1, 1, GL_HALF_FLOAT, GL_FALSE, sizeof(uint16_t), (void*)0);
+        glEnableVertexAttribArray(1);
+    }
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
+    // Null unless --profile / --trace, so every ProfileScope below is a single branch.
+    std::unique_ptr<FrameProfiler> profiler;
+    if (profiling) {
+        profiler.reset(new FrameProfiler(!tracePath.empty()));
+    }
+
+    // Mass, bins, the CPU grid, settle heights and satellites are stepped by the simulation,
+    // on its own thread unless --no-sim-thread; the loop below draws its newest frame.
+    ProfileTable profileTable(curvatureProfile);
+    Simulation simulation(bodies, gridSize, lodGrid ? gridMesh.vertices : nullptr, gridMesh.vertexCount, &profileTable, compactVertices, satelliteCount, orbitalRadius, satMeshRadius, minDeformation, gridWorkers);
+    SimulationInput simulationInput;
+    simulationInput.mass = sphereStrength;
+    simulationInput.cpuGrid = !gpuDeformation;
+    simulationInput.frameTime = headless ? 1.0f / 60.0f : 0.0f;
+    simulationInput.time = simulationClock();
+    std::unique_ptr<SimulationThread> simulationThread(new SimulationThread(simulation, simulationInput, simulationThreaded));
+
+    // Buffer textures the grid shader reads the body bins from, refilled each GPU frame.
+    GLuint bodyBuffers[3], bodyTextures[3];
+    const GLenum bodyTextureFormats[3] = { GL_RGBA32F, GL_R32I, GL_R32I };
+    glGenBuffers(3, bodyBuffers);
+    glGenTextures(3, bodyTextures);
+    for (int i = 0; i < 3; ++i) {
+        glBindBuffer(GL_TEXTURE_BUFFER, bodyBuffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, bodyTextures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, bodyTextureFormats[i], bodyBuffers[i]);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    // The same profile samples the CPU kernels read, filtered linearly by the texture unit.
+    GLuint profileTexture;
+    glGenTextures(1, &profileTexture);
+    glBindTexture(GL_TEXTURE_1D, profileTexture);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_R32F, profileTable.sampleCount(), 0, GL_RED, GL_FLOAT, profileTable.data());
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_1D, 0);
+
+    glUseProgram(gridShaderProgram.id);
+    glUniform1i(gridShaderProgram.location(Uniform::Bodies), 0);
+    glUniform1i(gridShaderProgram.location(Uniform::TileStart), 1);
+    glUniform1i(gridShaderProgram.location(Uniform::TileBodies), 2);
+    glUniform1i(gridShaderProgram.location(Uniform::ProfileTable), 3);
+    glUniform1f(gridShaderProgram.location(Uniform::ProfileTableSize), (float)ProfileTable::PROFILE_TABLE_SIZE);
+    glUniform1i(gridShaderProgram.location(Uniform::GridSize), gridSize);
+    glUniform1f(gridShaderProgram.location(Uniform::GridScale), GRID_SCALE);
+    glUniform1i(gridShaderProgram.location(Uniform::TileSize), BODY_TILE_SIZE);
+    glUniform1i(gridShaderProgram.location(Uniform::TilesPerSide), simulationThread->frame().bins.tilesPerSide);
+    glUniform1i(gridShaderProgram.location(Uniform::LatticeFromVertexId), latticeFromVertexId);
+    float gridModel[16];
+    identityMatrix(gridModel);
+    glUniformMatrix4fv(gridShaderProgram.location(Uniform::Model), 1, GL_FALSE, gridModel);
+    glUseProgram(0);
+
+    auto uploadBodyBins = [&](const SimulationFrame& frame) {
+        ProfileScope scope(profiler.get(), "upload bodies");
+        for (size_t b = 0; b < frame.bodies.size(); ++b) {
+            bodyTexels[b * 4 + 0] = frame.bodies[b].x;
+            bodyTexels[b * 4 + 1] = frame.bodies[b].z;
+            bodyTexels[b * 4 + 2] = frame.bodies[b].radius;
+            bodyTexels[b * 4 + 3] = frame.bodies[b].strength;
+        }
+        const void* data[3] = { bodyTexels.data(), frame.bins.tileStart.data(), frame.bins.bodyIndices.data() };
+        size_t sizes[3] = { bodyTexels.size() * sizeof(float), frame.bins.tileStart.size() * sizeof(int), frame.bins.bodyIndices.size() * sizeof(int) };
+        for (int i = 0; i < 3; ++i) {
+            glBindBuffer(GL_TEXTURE_BUFFER, bodyBuffers[i]);
+            // Orphan; an empty list still gets a texel so the texture stays complete.
+            glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(sizes[i], 16), NULL, GL_STREAM_DRAW);
+            if (sizes[i] > 0)
+                glBufferSubData(GL_TEXTURE_BUFFER, 0, sizes[i], data[i]);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    };
+
+    // Static mesh positions, quantized to normalized shorts of the mesh radius when compact
+    // (8 bytes a vertex instead of 12); the shaders scale them back by meshScale.
+    auto uploadMeshPositions = [&](const MeshView& mesh, float radius) {
+        if (compactVertices) {
+            std::vector<int16_t> quantized;
+            quantizePositions(mesh.vertices, mesh.vertexCount, radius, quantized);
+            glBufferData(GL_ARRAY_BUFFER, quantized.size() * sizeof(int16_t), quantized.data(), GL_STATIC_DRAW);
+            glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, 4 * sizeof(int16_t), (void*)0);
+        }
+        else {
+            glBufferData(GL_ARRAY_BUFFER, mesh.vertexBytes(), mesh.vertices, GL_STATIC_DRAW);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        }
+        glEnableVertexAttribArray(0);
+    };
+
     GLuint sphereVAO, sphereVBO, sphereEBO;
     glGenVertexArrays(1, &sphereVAO);
     glGenBuffers(1, &sphereVBO);
@@ -427,11 +658,9 @@ int main() {
 
     glBindVertexArray(sphereVAO);
     glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
-    glBufferData(GL_ARRAY_BUFFER, sphereVertices.size() * sizeof(float), sphereVertices.data(), GL_STATIC_DRAW);
+    uploadMeshPositions(sphereMesh, sphereMeshRadius);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sphereIndices.size() * sizeof(unsigned int), sphereIndices.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sphereMesh.indexBytes(), sphereMesh.indices, GL_STATIC_DRAW);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
@@ -440,16 +669,74 @@ int main() {
     glGenBuffers(1, &satelliteVBO);
     glGenBuffers(1, &satelliteEBO);
 
+    // Per-instance satellite positions are streamed each frame; attribute 1 is re-pointed at
+    // the current region before the draw.
+    std::unique_ptr<StreamBuffer> satelliteStream(new StreamBuffer(std::max(1, satelliteCount) * 3 * sizeof(float), 3 * sizeof(float), persistentStreaming));
+
     glBindVertexArray(satelliteVAO);
     glBindBuffer(GL_ARRAY_BUFFER, satelliteVBO);
-    glBufferData(GL_ARRAY_BUFFER, satelliteVertices.size() * sizeof(float), satelliteVertices.data(), GL_STATIC_DRAW);
+    uploadMeshPositions(satelliteMesh, satMeshRadius);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, satelliteEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, satelliteIndices.size() * sizeof(unsigned int), satelliteIndices.data(), GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, satelliteMesh.indexBytes(), satelliteMesh.indices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, satelliteStream->buffer());
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(1);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
+    glUseProgram(sphereShaderProgram.id);
+    glUniform1f(sphereShaderProgram.location(Uniform::MeshScale), compactVertices ? sphereMeshRadius : 1.0f);
+    glUseProgram(satelliteShaderProgram.id);
+    glUniform1f(satelliteShaderProgram.location(Uniform::MeshScale), compactVertices ? satMeshRadius : 1.0f);
+    glUseProgram(starShaderProgram.id);
+    glUniform1f(starShaderProgram.location(Uniform::PointSize), STAR_SIZE);
+    glUseProgram(0);
+
+    unsigned long long lodUploadedVersion = 0;
+    // Uploads a simulation frame's CPU grid (the changed lattice rows, or the whole LOD grid
+    // into the next ring region, only when the bodies changed) and satellite positions; they
+    // are drawn from there until a newer frame arrives. Returns the grid bytes uploaded.
+    auto uploadSimulationFrame = [&](const SimulationFrame& frame) {
+        const char* gridData = compactVertices ? (const char*)frame.gridHeights.data() : (const char*)frame.grid.data();
+        size_t gridBytes = 0;
+        if (gridStream && frame.hasGrid && frame.bodiesVersion != lodUploadedVersion) {
+            ProfileScope scope(profiler.get(), "grid upload");
+            lodUploadedVersion = frame.bodiesVersion;
+            gridBytes = gridVertexCount * gridVertexBytes;
+            std::memcpy(gridStream->begin(), gridData, gridBytes);
+            gridStream->end();
+        }
+        else if (!frame.gridRect.empty()) {
+            ProfileScope scope(profiler.get(), "grid upload");
+            const GridRect& rect = frame.gridRect;
+            int width = rect.x1 - rect.x0;
+            gridBytes = rect.area() * gridVertexBytes;
+            glBindBuffer(GL_ARRAY_BUFFER, gridPatchVBO);
+            if (width == gridSize) {
+                glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)rect.z0 * gridSize * gridVertexBytes, gridBytes, gridData);
+            }
+            else {
+                for (int z = rect.z0; z < rect.z1; ++z) {
+                    glBufferSubData(GL_ARRAY_BUFFER, ((GLintptr)z * gridSize + rect.x0) * gridVertexBytes, width * gridVertexBytes,
+                        gridData + (size_t)(z - rect.z0) * width * gridVertexBytes);
+                }
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        if (satelliteCount > 0) {
+            ProfileScope scope(profiler.get(), "satellite upload");
+            std::memcpy(satelliteStream->begin(), frame.satellites.data(), frame.satellites.size() * sizeof(float));
+            satelliteStream->end();
+        }
+        return gridBytes;
+    };
+    uploadSimulationFrame(simulationThread->frame());
+    size_t gridUploadBytes = 0;
+    unsigned long long binsUploadedVersion = 0;
+    unsigned long long displayedInputSequence = 0;
+    double inputLatencyMs = 0.0;
+
     GLuint starVAO, starVBO;
     glGenVertexArrays(1, &starVAO);
     glGenBuffers(1, &starVBO);
@@ -462,149 +749,642 @@ int main() {
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
-    float model[16] = {
-        1.0f, 0.0f, 0.0f, 0.0f,
-        0.0f, 1.0f, 0.0f, 0.0f,
-        0.0f, 0.0f, 1.0f, 0.0f,
-        0.0f, 0.0f, 0.0f, 1.0f
-    };
-
     float view[16];
     lookAtMatrix(0.0f, 20.0f, 40.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, view);
 
     float projection[16];
     perspectiveMatrix(45.0f * PI / 180.0f, (float)WIDTH / (float)HEIGHT, 0.1f, 100.0f, projection);
 
+    // multiplyMatrix(view, projection) is projection * view in the column-major layout.
+    float viewProjection[16];
+    multiplyMatrix(view, projection, viewProjection);
+    float frustumPlanes[6][4];
+    extractFrustumPlanes(viewProjection, frustumPlanes);
+
+    // The camera never moves, so its matrices are uploaded once into a uniform buffer every
+    // program reads.
+    CameraBlock camera;
+    std::memcpy(camera.view, view, sizeof(view));
+    std::memcpy(camera.projection, projection, sizeof(projection));
+    std::memcpy(camera.viewProjection, viewProjection, sizeof(viewProjection));
+    GLuint cameraBuffer = createCameraBuffer(camera);
+
+    // Per-frame draw lists for glMultiDrawElementsBaseVertex, sized once for every chunk.
+    std::vector<int>         visibleChunks;
+    std::vector<GLsizei>     chunkCounts;
+    std::vector<const void*> chunkOffsets;
+    std::vector<GLint>       chunkBaseVertices;
+    visibleChunks.reserve(gridChunks.size());
+    chunkCounts.reserve(gridChunks.size());
+    chunkOffsets.reserve(gridChunks.size());
+    chunkBaseVertices.reserve(gridChunks.size());
+
+    GLuint offscreenFBO = 0, offscreenColor = 0, offscreenDepth = 0;
+    if (headless) {
+        glGenFramebuffers(1, &offscreenFBO);
+        glGenRenderbuffers(1, &offscreenColor);
+        glGenRenderbuffers(1, &offscreenDepth);
+
+        glBindRenderbuffer(GL_RENDERBUFFER, offscreenColor);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, WIDTH, HEIGHT);
+        glBindRenderbuffer(GL_RENDERBUFFER, offscreenDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, WIDTH, HEIGHT);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, offscreenFBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreenColor);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, offscreenDepth);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Offscreen framebuffer is incomplete" << std::endl;
+            destroyHeadlessContext();
+            return -1;
+        }
+        glViewport(0, 0, WIDTH, HEIGHT);
+        std::cout << "Headless: " << headlessContextKind() << ", " << glGetString(GL_RENDERER) << ", " << headlessFrames << " frames" << std::endl;
+    }
+
+    // Frames render into the offscreen FBO when headless, the window's back buffer otherwise.
+    GLuint sceneFramebuffer = offscreenFBO;
+    int sceneWidth = WIDTH, sceneHeight = HEIGHT;
+    if (window) {
+        glfwGetFramebufferSize(window, &sceneWidth, &sceneHeight);
+    }
+
+    // Null unless --capture. Reads back whatever each frame renders.
+    std::unique_ptr<FrameWriter> frameWriter;
+    std::unique_ptr<FrameCapture> frameCapture;
+    if (!capturePath.empty()) {
+        int captureWidth = sceneWidth, captureHeight = sceneHeight;
+        frameWriter.reset(new FrameWriter(capturePath, captureWidth, captureHeight, 60));
+        if (!frameWriter->ok()) {
+            frameWriter.reset();
+            if (headless)
+                destroyHeadlessContext();
+            else
+                glfwTerminate();
+            return -1;
+        }
+        frameCapture.reset(new FrameCapture(*frameWriter, captureWidth, captureHeight));
+    }
+
+    // The lensed star background replaces the star points unless --no-lens. The stars are
+    // baked once into a texture at the pass's resolution; below full resolution (--lens-scale)
+    // the pass renders into its own framebuffer, which is scaled up onto the scene.
+    GLuint starTexture = 0, lensTableTexture = 0, lensVAO = 0, lensFBO = 0, lensColor = 0;
+    int lensWidth = std::max(1, (int)(sceneWidth * lensScale));
+    int lensHeight = std::max(1, (int)(sceneHeight * lensScale));
+    if (lensing) {
+        std::vector<unsigned char> starPixels;
+        generateStarBackground(starPixels, lensWidth, lensHeight, LENS_STAR_COUNT);
+        glGenTextures(1, &starTexture);
+        glBindTexture(GL_TEXTURE_2D, starTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, lensWidth, lensHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, starPixels.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // Light from inside the Einstein ring comes from the far side and can land off screen.
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
+
+        LensTable lensTable;
+        glGenTextures(1, &lensTableTexture);
+        glBindTexture(GL_TEXTURE_1D, lensTableTexture);
+        glTexImage1D(GL_TEXTURE_1D, 0, GL_R32F, lensTable.sampleCount(), 0, GL_RED, GL_FLOAT, lensTable.data());
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_1D, 0);
+
+        if (lensWidth != sceneWidth || lensHeight != sceneHeight) {
+            glGenFramebuffers(1, &lensFBO);
+            glBindFramebuffer(GL_FRAMEBUFFER, lensFBO);
+            glGenRenderbuffers(1, &lensColor);
+            glBindRenderbuffer(GL_RENDERBUFFER, lensColor);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, lensWidth, lensHeight);
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, lensColor);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                std::cerr << "Lensing framebuffer is incomplete; lensing at full resolution" << std::endl;
+                glDeleteFramebuffers(1, &lensFBO);
+                glDeleteRenderbuffers(1, &lensColor);
+                lensFBO = 0;
+                lensColor = 0;
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glGenVertexArrays(1, &lensVAO);
+
+        glUseProgram(lensShaderProgram.id);
+        glUniform1i(lensShaderProgram.location(Uniform::StarTexture), 4);
+        glUniform1i(lensShaderProgram.location(Uniform::LensTable), 5);
+        glUniform1f(lensShaderProgram.location(Uniform::LensTableSize), (float)LensTable::LENS_TABLE_SIZE);
+        glUniform1f(lensShaderProgram.location(Uniform::LensTableRadius), LensTable::LENS_TABLE_RADIUS);
+        glUniform1f(lensShaderProgram.location(Uniform::Aspect), (float)WIDTH / (float)HEIGHT);
+        glUseProgram(0);
+    }
+
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glEnable(GL_DEPTH_TEST);
 
     float lastFrame = 0.0f;
     float titleUpdateTimer = 0.0f;
+    bool  deformToggleHeld = false;
+
+    std::vector<FrameSample> frameSamples;
+    std::unique_ptr<GpuFrameTimer> gpuFrameTimer;
+    if (!reportPrefix.empty()) {
+        frameSamples.reserve(headless ? headlessFrames : WINDOWED_REPORT_FRAMES);
+        gpuFrameTimer.reset(new GpuFrameTimer());
+    }
+    int frameIndex = 0;
+    double startupMs = 0.0;
+    auto frameStart = std::chrono::steady_clock::now();
+    unsigned long long frameStartAllocations = allocationsSoFar();
+
+    // Every draw goes through renderState, which skips redundant binds and uniform sets and
+    // counts what's left; per-object draws are batched and sorted in bodyDraws.
+    RenderState renderState;
+    DrawList bodyDraws;
+    bodyDraws.reserve(bodies.size());
+
+    // A window draws when the scheduler has a frame due (see frame_scheduler.h). Headless, the
+    // scripted frames run back to back, then --idle-seconds holds the mass at the ramp's peak
+    // under the scheduler for that long and reports what it costs; those frames aren't in the
+    // report's samples. Recording a window keeps every frame, so the video plays in real time.
+    FrameScheduler scheduler(continuousRendering || (window && !capturePath.empty()), maxFps, animationFps);
+    if (window) {
+        glfwSetWindowUserPointer(window, &scheduler);
+        glfwSetKeyCallback(window, [](GLFWwindow* w, int, int, int, int) { requestFrame(w); });
+        glfwSetWindowRefreshCallback(window, [](GLFWwindow* w) { requestFrame(w); });
+        glfwSetFramebufferSizeCallback(window, [](GLFWwindow* w, int, int) { requestFrame(w); });
+    }
+    bool   idling = false;
+    double idleEnd = 0.0;
+    double scheduleStart = simulationClock();
+    double scheduleCpuStart = processCpuSeconds();
+
+    // Sleeps until a frame is due; false when the loop should end instead.
+    auto waitForFrame = [&]() {
+        for (;;) {
+            // A held mass key changes the mass every frame, and an input stays pending until
+            // a frame shows it.
+            if (isKeyDown(window, GLFW_KEY_EQUAL) || isKeyDown(window, GLFW_KEY_MINUS) || simulationInput.sequence > displayedInputSequence) {
+                scheduler.requestFrame();
+            }
+            scheduler.setAnimating(satelliteCount > 0 && simulationThread->frame().bodies[0].strength > 0.0f);
+            double now = simulationClock();
+            double wait = scheduler.timeUntilFrame(now);
+            if (window ? glfwWindowShouldClose(window) : now >= idleEnd) {
+                return false;
+            }
+            if (wait == 0.0) {
+                scheduler.beginFrame(now);
+                return true;
+            }
+            if (!window) {
+                std::this_thread::sleep_for(std::chrono::duration<double>(wait < 0.0 ? idleEnd - now : std::min(wait, idleEnd - now)));
+            }
+            else if (wait < 0.0) {
+                glfwWaitEvents();
+            }
+            else {
+                glfwWaitEventsTimeout(wait);
+            }
+            scheduler.recordWait(simulationClock() - now);
+        }
+    };
 
-    while (!glfwWindowShouldClose(window)) {
-        if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+    while (headless ? frameIndex < headlessFrames || idling : !glfwWindowShouldClose(window)) {
+        if ((window || idling) && !waitForFrame()) {
+            break;
+        }
+        if (isKeyDown(window, GLFW_KEY_ESCAPE))
             glfwSetWindowShouldClose(window, true);
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        if (headless && !idling) {
+            sphereStrength = headlessRampMass(frameIndex, headlessFrames);
+        }
+
+        if (profiler) {
+            profiler->beginFrame(frameIndex);
+        }
+        renderState.beginFrame();
+        bool recordFrame = gpuFrameTimer && !idling;
+        if (recordFrame) {
+            // A windowed run can outlast the reserved samples; the buffer growing is the
+            // report's own allocation, not the frame's.
+            bool growing = frameSamples.size() == frameSamples.capacity();
+            unsigned long long beforeSample = allocationsSoFar();
+            frameSamples.push_back({ frameIndex, sphereStrength, 0.0, -1.0, 0.0, 0, 0, -1.0, -1.0, 0, 0, 0, -1.0, 0, 0, 0 });
+            if (growing) {
+                frameStartAllocations += allocationsSoFar() - beforeSample;
+            }
+            gpuFrameTimer->begin(frameIndex, frameSamples);
+        }
+
+        // The lensing pass covers every pixel, so only depth needs clearing under it.
+        glClear(lensing && !lensFBO ? GL_DEPTH_BUFFER_BIT : GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        float currentFrame = glfwGetTime();
-        float deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        float deltaTime = 1.0f / 60.0f;
+        if (!headless) {
+            float currentFrame = glfwGetTime();
+            deltaTime = std::min(currentFrame - lastFrame, MAX_INPUT_DELTA);
+            lastFrame = currentFrame;
+        }
+
+        {
+            ProfileScope scope(profiler.get(), "input");
+            float massChangeSpeed = MASS_CHANGE_SPEED_SLOW;
+            if (isKeyDown(window, GLFW_KEY_LEFT_SHIFT)) {
+                massChangeSpeed = MASS_CHANGE_SPEED_FAST;
+            }
 
-        float massChangeSpeed = MASS_CHANGE_SPEED_SLOW;
-        if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) {
-            massChangeSpeed = MASS_CHANGE_SPEED_FAST;
+            if (isKeyDown(window, GLFW_KEY_EQUAL)) {
+                sphereStrength += massChangeSpeed * deltaTime;
+            }
+            if (isKeyDown(window, GLFW_KEY_MINUS)) {
+                sphereStrength = std::max(0.1f, sphereStrength - massChangeSpeed * deltaTime);
+            }
+
+            bool deformToggleDown = isKeyDown(window, GLFW_KEY_G);
+            if (deformToggleDown && !deformToggleHeld) {
+                gpuDeformation = !gpuDeformation;
+            }
+            deformToggleHeld = deformToggleDown;
+
+            // A mass change gets a new sequence number and timestamp; the frame that first
+            // shows it measures the latency.
+            if (sphereStrength != simulationInput.mass) {
+                simulationInput.mass = sphereStrength;
+                ++simulationInput.sequence;
+                simulationInput.time = simulationClock();
+            }
+            simulationInput.cpuGrid = !gpuDeformation;
+            simulationThread->submit(simulationInput);
         }
 
-        if (glfwGetKey(window, GLFW_KEY_EQUAL) == GLFW_PRESS) {
-            sphereStrength += massChangeSpeed * deltaTime;
+        bool newSimulationFrame = simulationThread->acquire();
+        const SimulationFrame& simulationFrame = simulationThread->frame();
+        if (newSimulationFrame) {
+            gridUploadBytes = uploadSimulationFrame(simulationFrame);
+            if (profiler) {
+                for (int s = 0; s < simulationFrame.stageCount; ++s) {
+                    profiler->addCpu(simulationFrame.stages[s].name, simulationFrame.stages[s].start, simulationFrame.stages[s].ms);
+                }
+            }
         }
-        if (glfwGetKey(window, GLFW_KEY_MINUS) == GLFW_PRESS) {
-            sphereStrength = std::max(0.1f, sphereStrength - massChangeSpeed * deltaTime);
+        // Right after switching to the CPU path the GPU keeps deforming until a frame with a
+        // CPU grid arrives.
+        bool drawCpuGrid = !gpuDeformation && simulationFrame.hasGrid;
+
+        // Cull against the simulation frame's bounds: exact for a CPU grid, else estimated.
+        visibleChunks.clear();
+        int culledChunks = 0;
+        {
+            ProfileScope scope(profiler.get(), "cull");
+            if (lodGrid || !chunkCulling) {
+                for (int c = 0; c < (int)gridChunks.size(); ++c) {
+                    visibleChunks.push_back(c);
+                }
+            }
+            else {
+                culledChunks = cullGridChunks(gridChunks, simulationFrame.bins, simulationFrame.bounds, frustumPlanes, visibleChunks);
+            }
         }
 
         titleUpdateTimer += deltaTime;
-        if (titleUpdateTimer >= 0.3f) {
-            char title[128];
-            snprintf(title, sizeof(title),
-                "Spacetime Curvature | Mass: %.1f (Hold Shift for fast change, +/- to adjust)",
-                sphereStrength);
+        if (window && titleUpdateTimer >= 0.3f) {
+            char title[768];
+            int length = snprintf(title, sizeof(title),
+                "Spacetime Curvature | Mass: %.1f | Deformation: %s | Chunks: %d/%d | Sim: %.1f ms | Input latency: %.0f ms | Upload stalls: %llu (Hold Shift for fast change, +/- to adjust, G to toggle)",
+                sphereStrength, gpuDeformation ? "GPU" : "CPU", (int)visibleChunks.size(), (int)gridChunks.size(), simulationFrame.simulationMs, inputLatencyMs,
+                gridStream ? gridStream->stats().stalls : 0ULL);
+            if (profiler && length > 0 && length < (int)sizeof(title)) {
+                snprintf(title + length, sizeof(title) - length, " | ms cpu/gpu: %s", profiler->summary());
+            }
             glfwSetWindowTitle(window, title);
             titleUpdateTimer = 0.0f;
         }
 
-        glUseProgram(starShaderProgram);
-        glBindVertexArray(starVAO);
+        // The planet's resting height, for the lens and the bodies pass.
+        float scaleFactor = 2.0f;
+        sphereY = simulationFrame.settleY[0] + sphereRadius + sphereMeshRadius + 0.1f;
+
+        if (lensing) {
+            ProfileScope scope(profiler.get(), "lensing", true);
+            // The planet's projected centre and apparent radius; its drawn sphere sits at the
+            // model translation, sphereMeshRadius * scaleFactor in size.
+            const float centre[3] = { sphereX / scaleFactor, sphereY / scaleFactor, sphereZ / scaleFactor };
+            float clip[4];
+            for (int r = 0; r < 4; ++r) {
+                clip[r] = viewProjection[r] * centre[0] + viewProjection[4 + r] * centre[1] + viewProjection[8 + r] * centre[2] + viewProjection[12 + r];
+            }
+            bool visible = clip[3] > 0.0f;
+            float lensRadius = visible ? sphereMeshRadius * scaleFactor * projection[5] / clip[3] : 1.0f;
+
+            if (lensFBO) {
+                glBindFramebuffer(GL_FRAMEBUFFER, lensFBO);
+                glViewport(0, 0, lensWidth, lensHeight);
+            }
+            glDisable(GL_DEPTH_TEST);
+            renderState.useProgram(lensShaderProgram);
+            renderState.bindVertexArray(lensVAO);
+            renderState.bindTexture(4, GL_TEXTURE_2D, starTexture);
+            renderState.bindTexture(5, GL_TEXTURE_1D, lensTableTexture);
+            renderState.setUniform(Uniform::LensCentreX, visible ? clip[0] / clip[3] : 0.0f);
+            renderState.setUniform(Uniform::LensCentreY, visible ? clip[1] / clip[3] : 0.0f);
+            renderState.setUniform(Uniform::LensRadius, lensRadius);
+            renderState.setUniform(Uniform::LensStrength, visible ? LENS_STRENGTH_PER_MASS * std::max(0.0f, sphereStrength) : 0.0f);
+            renderState.drawArrays(GL_TRIANGLES, 0, 3);
+            glEnable(GL_DEPTH_TEST);
+            renderState.countCalls(2, 2);
+            if (lensFBO) {
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, lensFBO);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, sceneFramebuffer);
+                glBlitFramebuffer(0, 0, lensWidth, lensHeight, 0, 0, sceneWidth, sceneHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+                glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+                glViewport(0, 0, sceneWidth, sceneHeight);
+                renderState.countCalls(6, 4);
+            }
+        }
+        else {
+            ProfileScope scope(profiler.get(), "stars", true);
+            renderState.useProgram(starShaderProgram);
+            renderState.bindVertexArray(starVAO);
+            renderState.drawArrays(GL_POINTS, 0, starVertices.size() / 3);
+        }
+
+        {
+            ProfileScope scope(profiler.get(), "grid", true);
+            renderState.useProgram(gridShaderProgram);
+            renderState.bindVertexArray(drawCpuGrid ? gridCpuVAO : gridVAO);
+            renderState.setUniform(Uniform::DeformOnGpu, (int)!drawCpuGrid);
+            renderState.setUniform(Uniform::RelativeHeights, (int)(drawCpuGrid && !gridStream));
+            renderState.setUniform(Uniform::SeparateHeights, (int)(drawCpuGrid && compactVertices));
+            renderState.setUniform(Uniform::MinDeformation, minDeformation);
+            renderState.setUniform(Uniform::FarField, simulationFrame.bins.farField);
+            if (!drawCpuGrid) {
+                if (binsUploadedVersion != simulationFrame.bodiesVersion) {
+                    uploadBodyBins(simulationFrame);
+                    binsUploadedVersion = simulationFrame.bodiesVersion;
+                }
+                for (int i = 0; i < 3; ++i) {
+                    renderState.bindTexture(i, GL_TEXTURE_BUFFER, bodyTextures[i]);
+                }
+                renderState.bindTexture(3, GL_TEXTURE_1D, profileTexture);
+            }
+
+            GLenum gridIndexType = gridMesh.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+            // A base vertex would offset the static LOD xz as well, so compact heights are
+            // re-pointed at their region instead.
+            GLint gridBaseVertex = drawCpuGrid && gridStream && !compactVertices ? gridStream->baseVertex() : 0;
+            if (drawCpuGrid && gridStream && compactVertices) {
+                glBindBuffer(GL_ARRAY_BUFFER, gridStream->buffer());
+                glVertexAttribPointer(1, 1, GL_HALF_FLOAT, GL_FALSE, sizeof(uint16_t), (void*)gridStream->regionOffset());
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+                renderState.countCalls(3, 1);
+            }
+            chunkCounts.clear();
+            chunkOffsets.clear();
+            chunkBaseVertices.clear();
+            for (int c : visibleChunks) {
+                const GridChunk& chunk = gridChunks[c];
+                chunkCounts.push_back((GLsizei)chunk.count);
+                chunkOffsets.push_back((const void*)(chunk.firstIndex * gridMesh.indexSize));
+                chunkBaseVertices.push_back(gridBaseVertex);
+            }
+            GLsizei drawCount = (GLsizei)visibleChunks.size();
+            if (gridTopology == GridTopology::Triangles) {
+                renderState.setPolygonMode(GL_LINE);
+                renderState.multiDrawElementsBaseVertex(GL_TRIANGLES, chunkCounts.data(), gridIndexType, chunkOffsets.data(), drawCount, chunkBaseVertices.data());
+            }
+            else if (gridTopology == GridTopology::Lines) {
+                renderState.multiDrawElementsBaseVertex(GL_LINES, chunkCounts.data(), gridIndexType, chunkOffsets.data(), drawCount, chunkBaseVertices.data());
+            }
+            else {
+                glEnable(GL_PRIMITIVE_RESTART);
+                glPrimitiveRestartIndex(gridMesh.restartIndex);
+                renderState.multiDrawElementsBaseVertex(GL_LINE_STRIP, chunkCounts.data(), gridIndexType, chunkOffsets.data(), drawCount, chunkBaseVertices.data());
+                glDisable(GL_PRIMITIVE_RESTART);
+                renderState.countCalls(3, 2);
+            }
+            if (drawCpuGrid && gridStream) {
+                gridStream->fence();
+            }
+        }
+
+        {
+            ProfileScope scope(profiler.get(), "bodies", true);
+            const std::vector<Body>& frameBodies = simulationFrame.bodies;
+            MeshDraw& planet = bodyDraws.add(sphereShaderProgram, sphereVAO, GL_TRIANGLES, (GLsizei)sphereMesh.indexCount);
+            identityMatrix(planet.model);
+            planet.model[0] = planet.model[5] = planet.model[10] = scaleFactor;
+            planet.model[12] = sphereX / scaleFactor;
+            planet.model[13] = sphereY / scaleFactor;
+            planet.model[14] = sphereZ / scaleFactor;
+
+            // Scattered bodies rest on their settle height, drawn at the planet's mesh-to-field size ratio.
+            for (size_t b = 1; b < frameBodies.size(); ++b) {
+                float bodyMeshScale = frameBodies[b].radius * scaleFactor / sphereRadius;
+                MeshDraw& body = bodyDraws.add(sphereShaderProgram, sphereVAO, GL_TRIANGLES, (GLsizei)sphereMesh.indexCount);
+                identityMatrix(body.model);
+                body.model[0] = body.model[5] = body.model[10] = bodyMeshScale;
+                body.model[12] = frameBodies[b].x;
+                body.model[13] = simulationFrame.settleY[b] + bodyMeshScale * sphereMeshRadius;
+                body.model[14] = frameBodies[b].z;
+            }
 
-        int starViewLoc = glGetUniformLocation(starShaderProgram, "view");
-        glUniformMatrix4fv(starViewLoc, 1, GL_FALSE, view);
-        int starProjectionLoc = glGetUniformLocation(starShaderProgram, "projection");
-        glUniformMatrix4fv(starProjectionLoc, 1, GL_FALSE, projection);
-        int pointSizeLoc = glGetUniformLocation(starShaderProgram, "pointSize");
-        glUniform1f(pointSizeLoc, STAR_SIZE);
+            renderState.setPolygonMode(GL_FILL);
+            bodyDraws.submit(renderState);
+            bodyDraws.clear();
+        }
 
-        glDrawArrays(GL_POINTS, 0, starVertices.size() / 3);
+        if (satelliteCount > 0) {
+            ProfileScope scope(profiler.get(), "satellites", true);
+            renderState.useProgram(satelliteShaderProgram);
+            renderState.bindVertexArray(satelliteVAO);
+            glBindBuffer(GL_ARRAY_BUFFER, satelliteStream->buffer());
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)satelliteStream->regionOffset());
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            renderState.countCalls(3, 1);
+
+            renderState.setPolygonMode(GL_FILL);
+            renderState.drawElementsInstanced(GL_TRIANGLES, (GLsizei)satelliteMesh.indexCount, GL_UNSIGNED_INT, 0, satelliteCount);
+            satelliteStream->fence();
+        }
 
-        glUseProgram(gridShaderProgram);
-        glBindVertexArray(gridVAO);
-        int viewLoc = glGetUniformLocation(gridShaderProgram, "view");
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, view);
-        int projectionLoc = glGetUniformLocation(gridShaderProgram, "projection");
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, projection);
-        int modelLoc = glGetUniformLocation(gridShaderProgram, "model");
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, model);
+        // Flush before closing the timer query so deferred renderers such as llvmpipe
+        // rasterize inside the timed span.
+        if (headless) {
+            glFlush();
+        }
+        if (recordFrame) {
+            gpuFrameTimer->end();
+        }
 
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        glDrawElements(GL_TRIANGLES, gridIndices.size(), GL_UNSIGNED_INT, 0);
+        if (frameCapture) {
+            ProfileScope scope(profiler.get(), "capture");
+            frameCapture->capture();
+        }
 
-        glUseProgram(sphereShaderProgram);
-        glBindVertexArray(sphereVAO);
+        if (!headless) {
+            ProfileScope scope(profiler.get(), "swap");
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
 
-        float sphereModel[16] = {
-            1.0f, 0.0f, 0.0f, 0.0f,
-            0.0f, 1.0f, 0.0f, 0.0f,
-            0.0f, 0.0f, 1.0f, 0.0f,
-            0.0f, 0.0f, 0.0f, 1.0f
-        };
-        sphereModel[12] = sphereX;
-        sphereModel[13] = sphereY;
-        sphereModel[14] = sphereZ;
-        float scaleFactor = 2.0f;
-        sphereModel[0] *= scaleFactor;
-        sphereModel[5] *= scaleFactor;
-        sphereModel[10] *= scaleFactor;
-        sphereModel[12] /= scaleFactor;
-        sphereModel[13] /= scaleFactor;
-        sphereModel[14] /= scaleFactor;
-
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, sphereModel);
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, view);
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, projection);
-
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glDrawElements(GL_TRIANGLES, sphereIndices.size(), GL_UNSIGNED_INT, 0);
-
-        satAngle += satSpeed;
-        satX = orbitalRadius * cos(satAngle);
-        satZ = orbitalRadius * sin(satAngle);
-        satY = sphereY;
-
-        float satModel[16] = {
-            1.0f, 0.0f, 0.0f, 0.0f,
-            0.0f, 1.0f, 0.0f, 0.0f,
-            0.0f, 0.0f, 1.0f, 0.0f,
-            0.0f, 0.0f, 0.0f, 1.0f
-        };
-        satModel[12] = satX;
-        satModel[13] = satY;
-        satModel[14] = satZ;
+        // Input-to-display latency, once per input, when the first frame showing it is swapped.
+        bool inputShown = simulationFrame.inputSequence > displayedInputSequence;
+        if (inputShown) {
+            inputLatencyMs = (simulationClock() - simulationFrame.inputTime) * 1000.0;
+            displayedInputSequence = simulationFrame.inputSequence;
+        }
 
-        glUseProgram(sphereShaderProgram);
-        glBindVertexArray(satelliteVAO);
+        // Startup ends when the first frame has finished rendering, not when it's submitted.
+        if (frameIndex == 0) {
+            glFinish();
+            startupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - processStart).count();
+            std::printf("Startup: %.1f ms to first frame\n", startupMs);
+        }
 
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, satModel);
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, view);
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, projection);
+        auto frameEnd = std::chrono::steady_clock::now();
+        unsigned long long frameEndAllocations = allocationsSoFar();
+        if (recordFrame) {
+            FrameSample& sample = frameSamples.back();
+            sample.allocations = (int)(frameEndAllocations - frameStartAllocations);
+            sample.mass = simulationFrame.bodies[0].strength;
+            sample.cpuMs = std::chrono::duration<double, std::milli>(frameEnd - frameStart).count();
+            sample.culledChunks = culledChunks;
+            sample.glCalls = renderState.stats().glCalls;
+            sample.drawCalls = renderState.stats().drawCalls;
+            sample.stateChanges = renderState.stats().stateChanges;
+            sample.captureMs = frameCapture ? frameCapture->stats().lastMs : -1.0;
+            if (newSimulationFrame) {
+                sample.simMs = simulationFrame.simulationMs;
+            }
+            if (inputShown) {
+                sample.inputLatencyMs = inputLatencyMs;
+            }
+            if (newSimulationFrame) {
+                sample.dirtyVertices = gridStream ? 0 : simulationFrame.gridRect.area();
+                sample.uploadBytes = (int)gridUploadBytes;
+            }
+            if (newSimulationFrame && simulationFrame.hasGrid && gridStream) {
+                sample.uploadWaitMs = gridStream->stats().lastWaitMs;
+                sample.uploadStalls = gridStream->stats().lastStalled ? 1 : 0;
+            }
+        }
+        frameStart = frameEnd;
+        frameStartAllocations = frameEndAllocations;
+        ++frameIndex;
+
+        if (headless && frameIndex == headlessFrames && idleSeconds > 0.0f) {
+            idling = true;
+            sphereStrength = HEADLESS_RAMP_PEAK_MASS;
+            simulationInput.frameTime = 0.0f;
+            scheduleStart = simulationClock();
+            scheduleCpuStart = processCpuSeconds();
+            idleEnd = scheduleStart + idleSeconds;
+        }
+    }
+    // Windowed, the whole run; headless, the --idle-seconds phase.
+    double scheduleSeconds = simulationClock() - scheduleStart;
+    double scheduleCpuPercent = scheduleSeconds > 0.0 ? 100.0 * (processCpuSeconds() - scheduleCpuStart) / scheduleSeconds : 0.0;
+    double scheduleSleepPercent = scheduleSeconds > 0.0 ? 100.0 * scheduler.stats().waitSeconds / scheduleSeconds : 0.0;
+    if (window || idling) {
+        std::printf("%s: %llu frames in %.1f s (%.1f fps, %llu waits) | CPU %.1f%% of one core | asleep %.0f%% of the time\n",
+            scheduler.continuous() ? "Continuous" : "On demand", scheduler.stats().frames, scheduleSeconds, scheduleSeconds > 0.0 ? scheduler.stats().frames / scheduleSeconds : 0.0,
+            scheduler.stats().waits, scheduleCpuPercent, scheduleSleepPercent);
+    }
 
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glDrawElements(GL_TRIANGLES, satelliteIndices.size(), GL_UNSIGNED_INT, 0);
+    // Write out the readbacks still in flight, so the capture stats are final.
+    FrameCapture::Stats captureStats;
+    FrameWriter::Stats writerStats;
+    if (frameCapture) {
+        frameCapture->finish();
+        captureStats = frameCapture->stats();
+        writerStats = frameWriter->stats();
+        frameCapture.reset();
+        frameWriter.reset();
+    }
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    if (gpuFrameTimer) {
+        gpuFrameTimer->drain(frameSamples);
+        FrameReportInfo reportInfo = {
+            (const char*)glGetString(GL_RENDERER),
+            headless ? headlessContextKind() : "GLFW window",
+            gpuDeformation ? "gpu" : "cpu",
+            radialProfileName(curvatureProfile),
+            simulationThread->threaded() ? "thread" : "inline",
+            gpuDeformation ? "static" : !gridStream ? "dirty rows" : gridStream->persistent() ? "persistent-mapped ring" : "orphaning",
+            compactVertices ? "compact" : "float",
+            gridSize,
+            gridVertexCount,
+            (int)gridChunks.size(),
+            gridWorkers.size(),
+            (int)bodies.size(),
+            capturePath.empty() ? "none" : capturePath.c_str(),
+            captureStats.stalls,
+            writerStats.stalls,
+            writerStats.stallMs,
+            writerStats.written ? writerStats.writeMs / writerStats.written : 0.0,
+            startupMs,
+            shaderStats.ms,
+            !shaderStats.cacheEnabled ? "off" : shaderStats.cacheHits == shaderStats.programs ? "warm" : shaderStats.cacheHits == 0 ? "cold" : "partial",
+            shaderStats.cacheHits,
+            shaderStats.parallelCompile,
+            meshMs,
+            cacheDirectory.empty() ? "off" : meshCacheHits == meshCount ? "warm" : meshCacheHits == 0 ? "cold" : "partial",
+            meshCacheHits,
+            lensing ? lensScale : 0.0f,
+            scheduler.continuous() ? "continuous" : "on demand",
+            maxFps,
+            animationFps,
+            swapInterval,
+            scheduleSeconds,
+            scheduler.stats().frames,
+            scheduleCpuPercent,
+            scheduleSleepPercent
+        };
+        writeFrameReport(reportPrefix, frameSamples, reportInfo);
+        gpuFrameTimer.reset();
+    }
+    // Every per-frame container is sized before the loop, so after the warm-up a frame must
+    // not touch the heap.
+    int exitCode = 0;
+    long long frameAllocations = steadyStateAllocations(frameSamples);
+    if (assertNoAllocations && frameAllocations > 0) {
+        std::cerr << frameAllocations << " heap allocations after the warm-up frames (see the allocations column of " << reportPrefix << ".csv)" << std::endl;
+        exitCode = 1;
+    }
+    simulationThread.reset();
 
-        generateGrid(gridVertices, gridIndices, sphereX, sphereZ, sphereRadius, sphereStrength, minDeformation);
-        glBindBuffer(GL_ARRAY_BUFFER, gridVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, gridVertices.size() * sizeof(float), gridVertices.data());
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gridEBO);
-        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, gridIndices.size() * sizeof(unsigned int), gridIndices.data());
+    if (profiler) {
+        profiler->drain();
+        profiler->printTotals();
+        if (!tracePath.empty()) {
+            profiler->writeTrace(tracePath);
+        }
+        profiler.reset();
+    }
 
-        sphereY = computeLowestGridY(sphereX, sphereZ, sphereRadius, sphereStrength, minDeformation) + sphereRadius + sphereMeshRadius + 0.1f;
+    if (headless) {
+        glDeleteFramebuffers(1, &offscreenFBO);
+        glDeleteRenderbuffers(1, &offscreenColor);
+        glDeleteRenderbuffers(1, &offscreenDepth);
     }
 
     glDeleteVertexArrays(1, &gridVAO);
     glDeleteBuffers(1, &gridVBO);
+    glDeleteVertexArrays(1, &gridCpuVAO);
+    gridStream.reset();
+    glDeleteBuffers(1, &gridPatchVBO);
     glDeleteBuffers(1, &gridEBO);
 
+    glDeleteTextures(3, bodyTextures);
+    glDeleteTextures(1, &profileTexture);
+    glDeleteBuffers(3, bodyBuffers);
+
     glDeleteVertexArrays(1, &sphereVAO);
     glDeleteBuffers(1, &sphereVBO);
     glDeleteBuffers(1, &sphereEBO);
@@ -612,14 +1392,26 @@ int main() {
     glDeleteVertexArrays(1, &satelliteVAO);
     glDeleteBuffers(1, &satelliteVBO);
     glDeleteBuffers(1, &satelliteEBO);
+    satelliteStream.reset();
 
     glDeleteVertexArrays(1, &starVAO);
     glDeleteBuffers(1, &starVBO);
 
-    glDeleteProgram(gridShaderProgram);
-    glDeleteProgram(sphereShaderProgram);
-    glDeleteProgram(starShaderProgram);
+    // Zero names (lensing off, or at full resolution) are ignored.
+    glDeleteTextures(1, &starTexture);
+    glDeleteTextures(1, &lensTableTexture);
+    glDeleteVertexArrays(1, &lensVAO);
+    glDeleteFramebuffers(1, &lensFBO);
+    glDeleteRenderbuffers(1, &lensColor);
 
-    glfwTerminate();
-    return 0;
+    glDeleteBuffers(1, &cameraBuffer);
+    for (const ShaderProgram& program : shaderPrograms) {
+        glDeleteProgram(program.id);
+    }
+
+    if (headless)
+        destroyHeadlessContext();
+    else
+        glfwTerminate();
+    return exitCode;
 }
@@ -0,0 +1,60 @@
+#include "mesh.h"
+
+#include <cmath>
+#include <random>
+
+#include "transform.h"
+
+void generateSphere(std::vector<float>& vertices, std::vector<unsigned int>& indices, float radius, int segments) {
+    // Sized once and written by index, so rebuilding into the same vectors never reallocates.
+    vertices.resize((segments + 1) * (segments + 1) * 3);
+    indices.resize(segments * segments * 6);
+
+    float* vertex = vertices.data();
+    for (int y = 0; y <= segments; ++y) {
+        float v = (float)y / (float)segments;
+        float phi = v * PI;
+
+        for (int x = 0; x <= segments; ++x) {
+            float u = (float)x / (float)segments;
+            float theta = u * 2.0f * PI;
+
+            float xPos = radius * sin(phi) * cos(theta);
+            float yPos = radius * cos(phi);
+            float zPos = radius * sin(phi) * sin(theta);
+
+            *vertex++ = xPos;
+            *vertex++ = yPos;
+            *vertex++ = zPos;
+        }
+    }
+
+    unsigned int* index = indices.data();
+    for (int y = 0; y < segments; ++y) {
+        for (int x = 0; x < segments; ++x) {
+            int p1 = y * (segments + 1) + x;
+            int p2 = p1 + 1;
+            int p3 = (y + 1) * (segments + 1) + x;
+            int p4 = p3 + 1;
+
+            *index++ = p1;
+            *index++ = p2;
+            *index++ = p3;
+
+            *index++ = p2;
+            *index++ = p4;
+            *index++ = p3;
+        }
+    }
+}
+
+void generateStars(std::vector<float>& vertices, int count) {
+    vertices.resize(count * 3);
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_real_distribution<> dis(-50.0f, 50.0f);
+
+    for (int i = 0; i < count * 3; ++i) {
+        vertices[i] = dis(gen);
+    }
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <vector>
+
+const int NUM_STARS = 300;
+
+// UV sphere centred on the origin: (segments + 1)^2 xyz vertices and 6 * segments^2 indices.
+void generateSphere(std::vector<float>& vertices, std::vector<unsigned int>& indices, float radius, int segments);
+
+// count random xyz points in the [-50, 50] cube.
+void generateStars(std::vector<float>& vertices, int count);
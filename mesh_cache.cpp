@@ -0,0 +1,122 @@
+#include "mesh_cache.h"
+
+#include <cstring>
+
+namespace {
+
+const uint32_t MESH_FILE_TAG = 0x4853454d;   // "MESH"
+const size_t MESH_SECTION_ALIGNMENT = 64;
+
+// Offsets are from the start of the payload.
+struct MeshFileLayout {
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    uint64_t chunkCount;
+    uint32_t indexSize;
+    uint32_t restartIndex;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t chunkOffset;
+    unsigned char reserved[8];
+};
+static_assert(sizeof(MeshFileLayout) == MESH_SECTION_ALIGNMENT, "mesh layout block must fill one section");
+
+size_t alignSection(size_t offset) {
+    return (offset + MESH_SECTION_ALIGNMENT - 1) & ~(MESH_SECTION_ALIGNMENT - 1);
+}
+
+// True if count elements of elementSize at offset lie inside a payload of payloadSize bytes.
+bool sectionFits(uint64_t offset, uint64_t count, size_t elementSize, size_t payloadSize) {
+    return offset % MESH_SECTION_ALIGNMENT == 0 && offset <= payloadSize && count <= (payloadSize - offset) / elementSize;
+}
+
+}
+
+MeshView meshView(const std::vector<float>& vertices, const std::vector<unsigned int>& indices) {
+    MeshView mesh;
+    mesh.vertices = vertices.data();
+    mesh.vertexCount = vertices.size() / 3;
+    mesh.indices = indices.data();
+    mesh.indexCount = indices.size();
+    return mesh;
+}
+
+MeshView meshView(const std::vector<float>& vertices, const GridIndices& indices) {
+    MeshView mesh;
+    mesh.vertices = vertices.data();
+    mesh.vertexCount = vertices.size() / 3;
+    mesh.indices = indices.data();
+    mesh.indexCount = indices.count;
+    mesh.indexSize = indices.indexSize;
+    mesh.restartIndex = indices.restartIndex;
+    mesh.chunks = indices.chunks.data();
+    mesh.chunkCount = indices.chunks.size();
+    return mesh;
+}
+
+uint64_t meshCacheKey(const char* kind, const void* params, size_t size) {
+    const uint32_t layout[2] = { MESH_GENERATOR_VERSION, (uint32_t)sizeof(GridChunk) };
+    return hashBytes(params, size, hashBytes(layout, sizeof(layout), hashString(kind)));
+}
+
+bool MappedMesh::open(const std::string& path, uint64_t key) {
+    close();
+    uint32_t tag;
+    if (!file.open(path, key, tag)) {
+        return false;
+    }
+    MeshFileLayout layout;
+    size_t size = file.payloadSize();
+    bool valid = tag == MESH_FILE_TAG && size >= sizeof(layout);
+    if (valid) {
+        std::memcpy(&layout, file.payload(), sizeof(layout));
+        valid = (layout.indexSize == 2 || layout.indexSize == 4)
+            && sectionFits(layout.vertexOffset, layout.vertexCount, 3 * sizeof(float), size)
+            && sectionFits(layout.indexOffset, layout.indexCount, layout.indexSize, size)
+            && sectionFits(layout.chunkOffset, layout.chunkCount, sizeof(GridChunk), size);
+    }
+    if (!valid) {
+        close();
+        return false;
+    }
+    mesh.vertices = (const float*)(file.payload() + layout.vertexOffset);
+    mesh.vertexCount = (size_t)layout.vertexCount;
+    mesh.indices = file.payload() + layout.indexOffset;
+    mesh.indexCount = (size_t)layout.indexCount;
+    mesh.indexSize = (int)layout.indexSize;
+    mesh.restartIndex = layout.restartIndex;
+    mesh.chunks = (const GridChunk*)(file.payload() + layout.chunkOffset);
+    mesh.chunkCount = (size_t)layout.chunkCount;
+    return true;
+}
+
+void MappedMesh::close() {
+    file.close();
+    mesh = MeshView();
+}
+
+bool writeMeshFile(const std::string& path, uint64_t key, const MeshView& mesh) {
+    static const unsigned char padding[MESH_SECTION_ALIGNMENT] = {};
+
+    MeshFileLayout layout = {};
+    layout.vertexCount = mesh.vertexCount;
+    layout.indexCount = mesh.indexCount;
+    layout.chunkCount = mesh.chunkCount;
+    layout.indexSize = (uint32_t)mesh.indexSize;
+    layout.restartIndex = mesh.restartIndex;
+    layout.vertexOffset = sizeof(layout);
+    layout.indexOffset = alignSection((size_t)layout.vertexOffset + mesh.vertexBytes());
+    layout.chunkOffset = alignSection((size_t)layout.indexOffset + mesh.indexBytes());
+
+    size_t vertexEnd = (size_t)layout.vertexOffset + mesh.vertexBytes();
+    size_t indexEnd = (size_t)layout.indexOffset + mesh.indexBytes();
+    const CachePiece pieces[] = {
+        { &layout, sizeof(layout) },
+        { mesh.vertices, mesh.vertexBytes() },
+        { padding, (size_t)layout.indexOffset - vertexEnd },
+        { mesh.indices, mesh.indexBytes() },
+        { padding, (size_t)layout.chunkOffset - indexEnd },
+        { mesh.chunks, mesh.chunkCount * sizeof(GridChunk) },
+    };
+    return writeCacheFile(path, key, MESH_FILE_TAG, pieces, (int)(sizeof(pieces) / sizeof(pieces[0])));
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "disk_cache.h"
+#include "grid_topology.h"
+
+#include <string>
+#include <vector>
+
+// Generated meshes kept in the cache directory (*.mesh) and mapped back in on later runs, so a
+// large lattice is uploaded straight from the page cache instead of being rebuilt.
+//
+// The payload is a 64-byte layout block followed by the vertex, index and chunk sections, each
+// starting on a 64-byte boundary. Everything is stored in this machine's native layout; the
+// key covers the chunk struct's size, so a build with a different layout misses.
+
+// Bump when a generator's output changes for the same parameters, so older files stop matching.
+const uint32_t MESH_GENERATOR_VERSION = 1;
+
+// Read-only view of a mesh: xyz float vertices, 16- or 32-bit indices and, for grids, their
+// culling chunks. Points either into the vectors it was built into or into a MappedMesh.
+struct MeshView {
+    const float*     vertices = nullptr;
+    size_t           vertexCount = 0;
+    const void*      indices = nullptr;
+    size_t           indexCount = 0;
+    int              indexSize = 4;
+    unsigned int     restartIndex = 0xFFFFFFFFu;
+    const GridChunk* chunks = nullptr;
+    size_t           chunkCount = 0;
+
+    size_t vertexBytes() const { return vertexCount * 3 * sizeof(float); }
+    size_t indexBytes() const { return indexCount * indexSize; }
+};
+
+MeshView meshView(const std::vector<float>& vertices, const std::vector<unsigned int>& indices);
+MeshView meshView(const std::vector<float>& vertices, const GridIndices& indices);
+
+// Key for the mesh generator kind builds from params, a plain struct of numbers with no
+// padding.
+uint64_t meshCacheKey(const char* kind, const void* params, size_t size);
+
+// A mesh file mapped read-only; view() points into the mapping until close().
+class MappedMesh {
+public:
+    // False (and nothing mapped) unless path holds a valid mesh file for key.
+    bool open(const std::string& path, uint64_t key);
+    void close();
+
+    const MeshView& view() const { return mesh; }
+
+private:
+    MappedCacheFile file;
+    MeshView mesh;
+};
+
+// False if the file couldn't be written.
+bool writeMeshFile(const std::string& path, uint64_t key, const MeshView& mesh);
@@ -0,0 +1,179 @@
+#include "profiler.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+FrameProfiler::FrameProfiler(bool tracing) : tracing(tracing) {
+    stages.reserve(MAX_STAGES);
+    cpuScopes.reserve(16);
+    gpuScopes.reserve(MAX_GPU_PASSES);
+    if (tracing) {
+        events.reserve(1 << 16);
+    }
+    glGenQueries(PROFILER_LATENCY * MAX_GPU_PASSES * 2, &queries[0][0]);
+    for (int slot = 0; slot < PROFILER_LATENCY; ++slot) {
+        passCount[slot] = 0;
+        slotFrame[slot] = -1;
+    }
+    glGetInteger64v(GL_TIMESTAMP, &gpuStartNs);
+    start = std::chrono::steady_clock::now();
+}
+
+FrameProfiler::~FrameProfiler() {
+    glDeleteQueries(PROFILER_LATENCY * MAX_GPU_PASSES * 2, &queries[0][0]);
+}
+
+int FrameProfiler::stageIndex(const char* name) {
+    for (int i = 0; i < (int)stages.size(); ++i) {
+        if (stages[i].name == name || std::strcmp(stages[i].name, name) == 0) {
+            return i;
+        }
+    }
+    if ((int)stages.size() == MAX_STAGES) {
+        return -1;
+    }
+    stages.push_back({ name, 0.0, 0.0, 0, 0, 0.0, 0.0, 0, 0 });
+    return (int)stages.size() - 1;
+}
+
+double FrameProfiler::sinceStartUs(std::chrono::steady_clock::time_point time) const {
+    return std::chrono::duration<double, std::micro>(time - start).count();
+}
+
+void FrameProfiler::beginFrame(int frameIndex) {
+    frame = frameIndex;
+    int slot = frame % PROFILER_LATENCY;
+    retire(slot);
+    slotFrame[slot] = frame;
+    ++summaryFrames;
+}
+
+void FrameProfiler::beginCpu(const char* name) {
+    cpuScopes.push_back({ stageIndex(name), std::chrono::steady_clock::now() });
+}
+
+void FrameProfiler::endCpu() {
+    auto end = std::chrono::steady_clock::now();
+    OpenScope scope = cpuScopes.back();
+    cpuScopes.pop_back();
+    recordCpu(scope.stage, scope.start, std::chrono::duration<double, std::milli>(end - scope.start).count(), CpuTrack);
+}
+
+void FrameProfiler::addCpu(const char* name, std::chrono::steady_clock::time_point begin, double ms) {
+    recordCpu(stageIndex(name), begin, ms, SimulationTrack);
+}
+
+void FrameProfiler::recordCpu(int stageId, std::chrono::steady_clock::time_point begin, double ms, Track track) {
+    if (stageId < 0) {
+        return;
+    }
+    Stage& stage = stages[stageId];
+    stage.cpuMs += ms;
+    ++stage.cpuCount;
+    stage.totalCpuMs += ms;
+    ++stage.totalCpuCount;
+    if (tracing && events.size() < MAX_TRACE_EVENTS) {
+        events.push_back({ stage.name, sinceStartUs(begin), ms * 1000.0, frame, track });
+    }
+}
+
+void FrameProfiler::beginGpu(const char* name) {
+    int slot = frame % PROFILER_LATENCY;
+    int stage = stageIndex(name);
+    if (passCount[slot] == MAX_GPU_PASSES || stage < 0) {
+        gpuScopes.push_back(-1);
+        return;
+    }
+    int pass = passCount[slot]++;
+    passes[slot][pass].stage = stage;
+    glQueryCounter(queries[slot][pass * 2], GL_TIMESTAMP);
+    gpuScopes.push_back(pass);
+}
+
+void FrameProfiler::endGpu() {
+    int pass = gpuScopes.back();
+    gpuScopes.pop_back();
+    if (pass >= 0) {
+        glQueryCounter(queries[frame % PROFILER_LATENCY][pass * 2 + 1], GL_TIMESTAMP);
+    }
+}
+
+void FrameProfiler::retire(int slot) {
+    if (slotFrame[slot] < 0) {
+        return;
+    }
+    for (int pass = 0; pass < passCount[slot]; ++pass) {
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(queries[slot][pass * 2], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(queries[slot][pass * 2 + 1], GL_QUERY_RESULT, &end);
+        double ms = (double)(end - begin) / 1.0e6;
+        Stage& stage = stages[passes[slot][pass].stage];
+        stage.gpuMs += ms;
+        ++stage.gpuCount;
+        stage.totalGpuMs += ms;
+        ++stage.totalGpuCount;
+        if (tracing && events.size() < MAX_TRACE_EVENTS) {
+            events.push_back({ stage.name, (double)((GLint64)begin - gpuStartNs) / 1.0e3, ms * 1000.0, slotFrame[slot], GpuTrack });
+        }
+    }
+    passCount[slot] = 0;
+    slotFrame[slot] = -1;
+}
+
+void FrameProfiler::drain() {
+    for (int i = 1; i <= PROFILER_LATENCY; ++i) {
+        retire((frame + i) % PROFILER_LATENCY);
+    }
+}
+
+const char* FrameProfiler::summary() {
+    summaryText.clear();
+    char part[96];
+    for (Stage& stage : stages) {
+        // Per frame, so stages that run several times a frame (or not every frame) add up.
+        double frames = summaryFrames > 0 ? summaryFrames : 1;
+        if (stage.gpuCount > 0)
+            std::snprintf(part, sizeof(part), "%s%s %.2f/%.2f", summaryText.empty() ? "" : " | ", stage.name, stage.cpuMs / frames, stage.gpuMs / frames);
+        else
+            std::snprintf(part, sizeof(part), "%s%s %.2f", summaryText.empty() ? "" : " | ", stage.name, stage.cpuMs / frames);
+        summaryText += part;
+        stage.cpuMs = stage.gpuMs = 0.0;
+        stage.cpuCount = stage.gpuCount = 0;
+    }
+    summaryFrames = 0;
+    return summaryText.c_str();
+}
+
+void FrameProfiler::printTotals() const {
+    std::printf("%-20s %12s %12s\n", "stage", "cpu ms/call", "gpu ms/call");
+    for (const Stage& stage : stages) {
+        double cpu = stage.totalCpuCount ? stage.totalCpuMs / stage.totalCpuCount : 0.0;
+        if (stage.totalGpuCount)
+            std::printf("%-20s %12.4f %12.4f\n", stage.name, cpu, stage.totalGpuMs / stage.totalGpuCount);
+        else
+            std::printf("%-20s %12.4f %12s\n", stage.name, cpu, "-");
+    }
+}
+
+bool FrameProfiler::writeTrace(const std::string& path) const {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+    std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}},\n");
+    std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":3,\"args\":{\"name\":\"Simulation\"}}");
+    for (const TraceEvent& event : events) {
+        std::fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%d}}",
+            event.name, event.track == GpuTrack ? "gpu" : "cpu", (int)event.track, event.startUs, event.durationUs, event.frame);
+    }
+    std::fprintf(file, "\n]}\n");
+    std::fclose(file);
+    if (events.size() >= MAX_TRACE_EVENTS) {
+        std::cerr << "Trace truncated at " << MAX_TRACE_EVENTS << " events" << std::endl;
+    }
+    return true;
+}
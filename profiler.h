@@ -0,0 +1,121 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Per-stage frame profiler. CPU stages are timed with steady_clock scopes; GPU passes get a
+// pair of GL_TIMESTAMP queries (timestamps rather than GL_TIME_ELAPSED, which can't nest inside
+// the whole-frame query of GpuFrameTimer). Queries go into a ring of PROFILER_LATENCY frame
+// slots and a slot is only read back when it comes round again, so readback doesn't wait on
+// work the GPU has just been handed.
+//
+// Stage means since the last summary() feed the window title; with tracing on, every scope is
+// also kept as a Chrome trace_event ("X" events, CPU and GPU on separate tracks) for
+// writeTrace(). Stages timed on the simulation thread are handed over with addCpu() and get
+// a track of their own. Stage names must be string literals.
+class FrameProfiler {
+public:
+    static const int PROFILER_LATENCY = 4;
+    static const int MAX_STAGES = 32;
+    static const int MAX_GPU_PASSES = 16;             // per frame
+    static const size_t MAX_TRACE_EVENTS = 1 << 20;   // later events are dropped
+
+    explicit FrameProfiler(bool tracing);
+    ~FrameProfiler();
+
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+    // Retires the GPU queries issued PROFILER_LATENCY frames ago.
+    void beginFrame(int frame);
+
+    void beginCpu(const char* name);
+    void endCpu();
+    // A CPU stage timed elsewhere (SimulationFrame::stages), traced on the simulation track.
+    void addCpu(const char* name, std::chrono::steady_clock::time_point begin, double ms);
+    void beginGpu(const char* name);
+    void endGpu();
+
+    // Reads back every query still in flight.
+    void drain();
+
+    // "name cpu/gpu ms | ..." averaged over the frames since the last call.
+    const char* summary();
+    // Per-stage means over the whole run, one line per stage.
+    void printTotals() const;
+    bool writeTrace(const std::string& path) const;
+
+private:
+    struct Stage {
+        const char* name;
+        double cpuMs, gpuMs;            // since the last summary()
+        int    cpuCount, gpuCount;
+        double totalCpuMs, totalGpuMs;
+        int    totalCpuCount, totalGpuCount;
+    };
+    enum Track { CpuTrack = 1, GpuTrack = 2, SimulationTrack = 3 };   // trace thread ids
+    struct TraceEvent {
+        const char* name;
+        double startUs;
+        double durationUs;
+        int    frame;
+        Track  track;
+    };
+    struct GpuPass {
+        int stage;
+    };
+    struct OpenScope {
+        int stage;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    int stageIndex(const char* name);
+    void recordCpu(int stage, std::chrono::steady_clock::time_point begin, double ms, Track track);
+    void retire(int slot);
+    double sinceStartUs(std::chrono::steady_clock::time_point time) const;
+
+    bool tracing;
+    std::vector<Stage>      stages;
+    std::vector<TraceEvent> events;
+    std::vector<OpenScope>  cpuScopes;
+    std::vector<int>        gpuScopes;   // pass index within the frame's slot
+    std::chrono::steady_clock::time_point start;
+    GLint64 gpuStartNs = 0;              // GL_TIMESTAMP at construction, lines the tracks up
+    int frame = 0;
+
+    GLuint  queries[PROFILER_LATENCY][MAX_GPU_PASSES * 2];
+    GpuPass passes[PROFILER_LATENCY][MAX_GPU_PASSES];
+    int     passCount[PROFILER_LATENCY];
+    int     slotFrame[PROFILER_LATENCY];
+    int     summaryFrames = 0;
+    std::string summaryText;
+};
+
+// Times a block on the CPU, and on the GPU too when gpu is set. With a null profiler it costs
+// one branch at each end.
+class ProfileScope {
+public:
+    ProfileScope(FrameProfiler* profiler, const char* name, bool gpu = false) : profiler(profiler), gpu(gpu) {
+        if (profiler) {
+            profiler->beginCpu(name);
+            if (gpu)
+                profiler->beginGpu(name);
+        }
+    }
+    ~ProfileScope() {
+        if (profiler) {
+            if (gpu)
+                profiler->endGpu();
+            profiler->endCpu();
+        }
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    FrameProfiler* profiler;
+    bool gpu;
+};
@@ -0,0 +1,86 @@
+#include "radial_profile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const double SOFTENING = 0.1;
+const double PLUMMER_SOFTENING = 0.25;
+const double SCHWARZSCHILD_RADIUS = 0.1;
+const double BODY_SURFACE = 0.4;   // body radius / influence radius
+
+double softenedDepth(double u) {
+    return 2.0 * (1.0 / std::sqrt(u + SOFTENING) - 1.0);
+}
+
+double plummerDepth(double u) {
+    double a2 = PLUMMER_SOFTENING * PLUMMER_SOFTENING;
+    return 1.0 / std::sqrt(u + a2) - 1.0 / std::sqrt(1.0 + a2);
+}
+
+// Height of the embedding surface above its lowest circle. Inside the body the exterior
+// solution doesn't apply; a cap in u (a paraboloid in distance) continues it with the same
+// height and slope at the surface.
+double flammHeight(double u) {
+    double rs = SCHWARZSCHILD_RADIUS;
+    double surface = BODY_SURFACE;
+    double n = std::sqrt(u);
+    if (n >= surface) {
+        return 2.0 * std::sqrt(rs * (n - rs));
+    }
+    double surfaceHeight = 2.0 * std::sqrt(rs * (surface - rs));
+    double surfaceSlope = rs / std::sqrt(rs * (surface - rs));
+    return surfaceHeight + surfaceSlope / (2.0 * surface) * (u - surface * surface);
+}
+
+double flammDepth(double u) {
+    return flammHeight(1.0) - flammHeight(u);
+}
+
+double unscaledDepth(RadialProfile profile, double u) {
+    switch (profile) {
+    case RadialProfile::Plummer: return plummerDepth(u);
+    case RadialProfile::Flamm:   return flammDepth(u);
+    default:                     return softenedDepth(u);
+    }
+}
+
+}
+
+const char* radialProfileName(RadialProfile profile) {
+    switch (profile) {
+    case RadialProfile::Plummer: return "plummer";
+    case RadialProfile::Flamm:   return "flamm";
+    default:                     return "softened";
+    }
+}
+
+bool parseRadialProfile(const char* name, RadialProfile& profile) {
+    for (RadialProfile candidate : { RadialProfile::Softened, RadialProfile::Plummer, RadialProfile::Flamm }) {
+        if (std::strcmp(name, radialProfileName(candidate)) == 0) {
+            profile = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+double radialProfileDepth(RadialProfile profile, double u) {
+    double scale = softenedDepth(0.0) / unscaledDepth(profile, 0.0);
+    return scale * unscaledDepth(profile, u);
+}
+
+ProfileTable::ProfileTable(RadialProfile profile) : kind(profile) {
+    samples.resize(PROFILE_TABLE_SIZE + 1);
+    for (int i = 0; i <= PROFILE_TABLE_SIZE; ++i) {
+        samples[i] = (float)radialProfileDepth(profile, (double)i / PROFILE_TABLE_SIZE);
+    }
+
+    const int sweep = PROFILE_TABLE_SIZE * 16;
+    for (int i = 0; i <= sweep; ++i) {
+        double u = (double)i / sweep;
+        error = std::max(error, std::fabs(depth((float)u) - radialProfileDepth(profile, u)));
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+
+// Shape of a body's well. A profile is a depth per unit strength as a function of
+// u = (distance / influence)^2 in [0, 1): the well lowers the grid by strength * depth(u).
+// Working in u rather than distance means a vertex never needs a square root to find its place.
+//
+// All profiles are scaled to the original profile's centre depth, so switching keeps the
+// well about as deep and only changes its shape.
+enum class RadialProfile {
+    Softened,   // 2 * (1 / sqrt(u + 0.1) - 1), the original falloff of curvature.h
+    Plummer,    // Plummer potential with softening 0.25, shifted to meet the plane at the rim
+    Flamm,      // Flamm's paraboloid (the Schwarzschild spatial embedding, r_s = 0.1) outside
+                // the body's surface at 0.4, and a cap matching its slope inside
+};
+
+const char* radialProfileName(RadialProfile profile);
+// Accepts the names above in lower case; false for anything else.
+bool parseRadialProfile(const char* name, RadialProfile& profile);
+
+// The profile evaluated exactly, in double; what the tables are baked from.
+double radialProfileDepth(RadialProfile profile, double u);
+
+// A profile baked into PROFILE_TABLE_SIZE + 1 evenly spaced samples over u in [0, 1] and read
+// back by linear interpolation: one multiply, a truncation and a lerp per lookup, whatever
+// the profile. The samples are laid out so they can go straight into a 1D texture with linear
+// filtering (sample i at texel i, u = i / PROFILE_TABLE_SIZE).
+class ProfileTable {
+public:
+    static const int PROFILE_TABLE_SIZE = 1024;   // intervals
+    // What maxError() stays under for every profile, per unit strength.
+    static constexpr double MAX_ERROR = 2e-4;
+
+    explicit ProfileTable(RadialProfile profile);
+
+    RadialProfile profile() const { return kind; }
+
+    // u must be in [0, 1].
+    float depth(float u) const {
+        float scaled = u * PROFILE_TABLE_SIZE;
+        int i = (int)scaled < PROFILE_TABLE_SIZE ? (int)scaled : PROFILE_TABLE_SIZE - 1;
+        float t = scaled - i;
+        return samples[i] + t * (samples[i + 1] - samples[i]);
+    }
+    // d depth / du of the interpolant (constant over each interval).
+    float slope(float u) const {
+        float scaled = u * PROFILE_TABLE_SIZE;
+        int i = (int)scaled < PROFILE_TABLE_SIZE ? (int)scaled : PROFILE_TABLE_SIZE - 1;
+        return (samples[i + 1] - samples[i]) * PROFILE_TABLE_SIZE;
+    }
+
+    const float* data() const { return samples.data(); }
+    int sampleCount() const { return (int)samples.size(); }
+    // Depths at the centre and the rim; every profile decreases monotonically between them.
+    float centreDepth() const { return samples.front(); }
+    float rimDepth() const { return samples.back(); }
+
+    // Largest |depth(u) - radialProfileDepth(u)|, measured at construction over a sweep
+    // 16 times finer than the table. Below MAX_ERROR.
+    double maxError() const { return error; }
+
+private:
+    RadialProfile kind;
+    std::vector<float> samples;
+    double error = 0.0;
+};
@@ -0,0 +1,170 @@
+#include "render_state.h"
+
+#include <algorithm>
+#include <cstring>
+
+void RenderState::invalidate() {
+    // Values no real binding has, so the next call of each kind goes through.
+    program = nullptr;
+    vertexArray = ~0u;
+    for (GLuint& texture : textures) {
+        texture = ~0u;
+    }
+    activeUnit = -1;
+    polygonMode = GL_NONE;
+}
+
+void RenderState::useProgram(ShaderProgram& next) {
+    if (program == &next) {
+        ++frameStats.redundant;
+        return;
+    }
+    glUseProgram(next.id);
+    program = &next;
+    ++frameStats.glCalls;
+    ++frameStats.stateChanges;
+}
+
+void RenderState::bindVertexArray(GLuint next) {
+    if (vertexArray == next) {
+        ++frameStats.redundant;
+        return;
+    }
+    glBindVertexArray(next);
+    vertexArray = next;
+    ++frameStats.glCalls;
+    ++frameStats.stateChanges;
+}
+
+void RenderState::bindTexture(int unit, GLenum target, GLuint texture) {
+    if (textures[unit] == texture) {
+        ++frameStats.redundant;
+        return;
+    }
+    if (activeUnit != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+        ++frameStats.glCalls;
+    }
+    glBindTexture(target, texture);
+    textures[unit] = texture;
+    ++frameStats.glCalls;
+    ++frameStats.stateChanges;
+}
+
+void RenderState::setPolygonMode(GLenum mode) {
+    if (polygonMode == mode) {
+        ++frameStats.redundant;
+        return;
+    }
+    glPolygonMode(GL_FRONT_AND_BACK, mode);
+    polygonMode = mode;
+    ++frameStats.glCalls;
+    ++frameStats.stateChanges;
+}
+
+bool RenderState::setScalar(Uniform uniform, uint32_t bits) {
+    int u = (int)uniform;
+    if (program->locations[u] < 0) {
+        return false;
+    }
+    if (program->valueKnown[u] && program->values[u] == bits) {
+        ++frameStats.redundant;
+        return false;
+    }
+    program->values[u] = bits;
+    program->valueKnown[u] = true;
+    ++frameStats.glCalls;
+    ++frameStats.stateChanges;
+    return true;
+}
+
+void RenderState::setUniform(Uniform uniform, int value) {
+    if (setScalar(uniform, (uint32_t)value)) {
+        glUniform1i(program->location(uniform), value);
+    }
+}
+
+void RenderState::setUniform(Uniform uniform, float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    if (setScalar(uniform, bits)) {
+        glUniform1f(program->location(uniform), value);
+    }
+}
+
+void RenderState::setUniformMatrix(Uniform uniform, const float* matrix) {
+    GLint location = program->location(uniform);
+    if (location < 0) {
+        return;
+    }
+    glUniformMatrix4fv(location, 1, GL_FALSE, matrix);
+    ++frameStats.glCalls;
+    ++frameStats.stateChanges;
+}
+
+void RenderState::drawArrays(GLenum mode, GLint first, GLsizei count) {
+    glDrawArrays(mode, first, count);
+    ++frameStats.glCalls;
+    ++frameStats.drawCalls;
+}
+
+void RenderState::drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+    glDrawElements(mode, count, type, indices);
+    ++frameStats.glCalls;
+    ++frameStats.drawCalls;
+}
+
+void RenderState::drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances) {
+    glDrawElementsInstanced(mode, count, type, indices, instances);
+    ++frameStats.glCalls;
+    ++frameStats.drawCalls;
+}
+
+void RenderState::multiDrawElementsBaseVertex(GLenum mode, const GLsizei* counts, GLenum type, const void* const* indices, GLsizei drawCount, const GLint* baseVertices) {
+    glMultiDrawElementsBaseVertex(mode, counts, type, indices, drawCount, baseVertices);
+    ++frameStats.glCalls;
+    ++frameStats.drawCalls;
+}
+
+void RenderState::countCalls(int calls, int stateChanges) {
+    frameStats.glCalls += calls;
+    frameStats.stateChanges += stateChanges;
+}
+
+void DrawList::reserve(size_t count) {
+    draws.reserve(count);
+    order.reserve(count);
+}
+
+MeshDraw& DrawList::add(ShaderProgram& program, GLuint vertexArray, GLenum mode, GLsizei indexCount) {
+    draws.push_back({ &program, vertexArray, mode, indexCount, {} });
+    return draws.back();
+}
+
+void DrawList::submit(RenderState& state) {
+    order.resize(draws.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = (int)i;
+    }
+    // Ties keep their order, so the result doesn't depend on the sort.
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        const MeshDraw& x = draws[a];
+        const MeshDraw& y = draws[b];
+        if (x.program->id != y.program->id) {
+            return x.program->id < y.program->id;
+        }
+        if (x.vertexArray != y.vertexArray) {
+            return x.vertexArray < y.vertexArray;
+        }
+        return a < b;
+    });
+
+    for (int i : order) {
+        const MeshDraw& draw = draws[i];
+        state.useProgram(*draw.program);
+        state.bindVertexArray(draw.vertexArray);
+        state.setUniformMatrix(Uniform::Model, draw.model);
+        state.drawElements(draw.mode, draw.indexCount, GL_UNSIGNED_INT, 0);
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "shader_program.h"
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <vector>
+
+// The draw code's view of GL state. It remembers the bound program, vertex array, textures and
+// polygon mode, plus each program's int/float uniform values, and only issues calls that
+// change something. Every GL call made through it is counted, so stats() shows a frame's
+// driver traffic. Uploads (StreamBuffer, glBufferSubData) aren't counted here.
+//
+// The remembered state assumes nothing else changes these bindings between frames; call
+// invalidate() after code that does.
+class RenderState {
+public:
+    struct Stats {
+        int glCalls = 0;       // GL calls issued, draws included
+        int drawCalls = 0;
+        int stateChanges = 0;  // binds, polygon mode and uniform changes issued
+        int redundant = 0;     // changes skipped because the state already matched
+    };
+
+    static const int TEXTURE_UNITS = 6;
+
+    RenderState() { invalidate(); }
+
+    void beginFrame() { frameStats = Stats(); }
+    void invalidate();
+
+    void useProgram(ShaderProgram& program);
+    void bindVertexArray(GLuint vertexArray);
+    void bindTexture(int unit, GLenum target, GLuint texture);
+    void setPolygonMode(GLenum mode);
+
+    // On the program in use.
+    void setUniform(Uniform uniform, int value);
+    void setUniform(Uniform uniform, float value);
+    void setUniformMatrix(Uniform uniform, const float* matrix);
+
+    void drawArrays(GLenum mode, GLint first, GLsizei count);
+    void drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices);
+    void drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances);
+    void multiDrawElementsBaseVertex(GLenum mode, const GLsizei* counts, GLenum type, const void* const* indices, GLsizei drawCount, const GLint* baseVertices);
+
+    // For GL calls the draw code makes directly (attribute pointers, primitive restart, ...).
+    void countCalls(int calls, int stateChanges = 0);
+
+    const Stats& stats() const { return frameStats; }
+
+private:
+    bool setScalar(Uniform uniform, uint32_t bits);
+
+    ShaderProgram* program = nullptr;
+    GLuint vertexArray;
+    GLuint textures[TEXTURE_UNITS];
+    int    activeUnit;
+    GLenum polygonMode;
+    Stats  frameStats;
+};
+
+// Mesh draws collected over a pass and submitted sorted by program, then vertex array, so each
+// is bound once however many objects share it; only the model matrix changes in between.
+struct MeshDraw {
+    ShaderProgram* program;
+    GLuint  vertexArray;
+    GLenum  mode;
+    GLsizei indexCount;   // GL_UNSIGNED_INT indices from offset 0 of the vertex array's buffer
+    float   model[16];
+};
+
+class DrawList {
+public:
+    void reserve(size_t count);
+    void clear() { draws.clear(); }
+    MeshDraw& add(ShaderProgram& program, GLuint vertexArray, GLenum mode, GLsizei indexCount);
+    void submit(RenderState& state);
+
+private:
+    std::vector<MeshDraw> draws;
+    std::vector<int>      order;
+};
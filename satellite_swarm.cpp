@@ -0,0 +1,174 @@
+#include "satellite_swarm.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <random>
+
+#include "curvature.h"
+#include "thread_pool.h"
+#include "transform.h"
+
+namespace {
+
+const int SATELLITE_BLOCK = 2048;
+
+// Cheap integer hash for per-satellite respawn positions, so workers need no shared RNG.
+unsigned int hashIndex(unsigned long long value) {
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return (unsigned int)value;
+}
+
+float unitFloat(unsigned int bits) {
+    return (bits >> 8) * (1.0f / 16777216.0f);
+}
+
+void orbitPosition(const Body& centre, float radius, float angle, float& x, float& z) {
+    x = centre.x + radius * std::cos(angle);
+    z = centre.z + radius * std::sin(angle);
+}
+
+// Sets velocity, acceleration and height for a circular orbit around the centre body at the
+// satellite's current position, and collapses the interpolation span.
+void circularize(SatelliteSwarm& swarm, int i, const std::vector<Body>& bodies, const BodyBins& bins, float minDeformation) {
+    float gradX, gradZ;
+    swarm.y[i] = sampleField(swarm.x[i], swarm.z[i], bodies, bins, minDeformation, gradX, gradZ);
+    swarm.accelX[i] = -SATELLITE_GRAVITY * gradX;
+    swarm.accelZ[i] = -SATELLITE_GRAVITY * gradZ;
+
+    float radialX = swarm.x[i] - swarm.centre.x;
+    float radialZ = swarm.z[i] - swarm.centre.z;
+    float radius = std::sqrt(radialX * radialX + radialZ * radialZ);
+    float inwardAccel = radius > 0.0f ? -(swarm.accelX[i] * radialX + swarm.accelZ[i] * radialZ) / radius : 0.0f;
+    float speed = inwardAccel > 0.0f ? std::sqrt(inwardAccel * radius) : 0.0f;
+    swarm.velX[i] = radius > 0.0f ? -radialZ / radius * speed : 0.0f;
+    swarm.velZ[i] = radius > 0.0f ? radialX / radius * speed : 0.0f;
+
+    swarm.prevX[i] = swarm.x[i];
+    swarm.prevY[i] = swarm.y[i];
+    swarm.prevZ[i] = swarm.z[i];
+}
+
+}
+
+void seedSatellites(SatelliteSwarm& swarm, int count, const Body& centre, float orbitalRadius) {
+    swarm.centre = centre;
+    swarm.orbitalRadius = orbitalRadius;
+    swarm.accumulator = 0.0f;
+    swarm.steps = 0;
+    swarm.respawns = 0;
+    for (std::vector<float>* array : { &swarm.x, &swarm.y, &swarm.z, &swarm.prevX, &swarm.prevY, &swarm.prevZ,
+                                       &swarm.velX, &swarm.velZ, &swarm.accelX, &swarm.accelZ }) {
+        array->assign(count, 0.0f);
+    }
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    float influence = centre.radius * 2.5f;
+    for (int i = 0; i < count; ++i) {
+        float radius = orbitalRadius;
+        float angle = 0.0f;
+        if (count > 1) {
+            radius = influence * std::sqrt(0.16f + 0.84f * unit(gen));
+            angle = 2.0f * PI * unit(gen);
+        }
+        orbitPosition(centre, radius, angle, swarm.x[i], swarm.z[i]);
+        swarm.prevX[i] = swarm.x[i];
+        swarm.prevZ[i] = swarm.z[i];
+    }
+}
+
+void launchSatellites(SatelliteSwarm& swarm, const std::vector<Body>& bodies, const BodyBins& bins, float minDeformation, ThreadPool& pool) {
+    pool.parallelFor(swarm.size(), SATELLITE_BLOCK, [&](int, int first, int last) {
+        for (int i = first; i < last; ++i) {
+            circularize(swarm, i, bodies, bins, minDeformation);
+        }
+    });
+}
+
+int advanceSatellites(SatelliteSwarm& swarm, float frameTime, const std::vector<Body>& bodies, const BodyBins& bins, float minDeformation, ThreadPool& pool) {
+    swarm.accumulator = std::min(swarm.accumulator + frameTime, SATELLITE_MAX_STEPS * SATELLITE_TIMESTEP);
+    int stepCount = (int)(swarm.accumulator / SATELLITE_TIMESTEP);
+    if (stepCount == 0) {
+        return 0;
+    }
+    swarm.accumulator = std::max(0.0f, swarm.accumulator - stepCount * SATELLITE_TIMESTEP);
+
+    // The field is fixed for the frame, so each satellite runs all of its steps in one go.
+    const float dt = SATELLITE_TIMESTEP;
+    const float halfDt = 0.5f * dt;
+    std::atomic<unsigned long long> respawnTotal{ 0 };
+    pool.parallelFor(swarm.size(), SATELLITE_BLOCK, [&](int, int first, int last) {
+        unsigned long long respawns = 0;
+        for (int i = first; i < last; ++i) {
+            float x = swarm.x[i], y = swarm.y[i], z = swarm.z[i];
+            float velX = swarm.velX[i], velZ = swarm.velZ[i];
+            float accelX = swarm.accelX[i], accelZ = swarm.accelZ[i];
+            float prevX = x, prevY = y, prevZ = z;
+            bool respawned = false;
+
+            for (int step = 0; step < stepCount; ++step) {
+                prevX = x;
+                prevY = y;
+                prevZ = z;
+
+                velX += accelX * halfDt;
+                velZ += accelZ * halfDt;
+                x += velX * dt;
+                z += velZ * dt;
+
+                if (std::fabs(x) > GRID_SCALE || std::fabs(z) > GRID_SCALE) {
+                    unsigned int bits = hashIndex(((unsigned long long)i << 20) ^ (swarm.steps + step));
+                    float radius = swarm.centre.radius * 2.5f * std::sqrt(0.16f + 0.84f * unitFloat(bits));
+                    float angle = 2.0f * PI * unitFloat(hashIndex(bits));
+                    orbitPosition(swarm.centre, radius, angle, swarm.x[i], swarm.z[i]);
+                    circularize(swarm, i, bodies, bins, minDeformation);
+                    ++respawns;
+                    respawned = true;
+                    break;
+                }
+
+                float gradX, gradZ;
+                y = sampleField(x, z, bodies, bins, minDeformation, gradX, gradZ);
+                accelX = -SATELLITE_GRAVITY * gradX;
+                accelZ = -SATELLITE_GRAVITY * gradZ;
+                velX += accelX * halfDt;
+                velZ += accelZ * halfDt;
+            }
+
+            if (!respawned) {
+                swarm.x[i] = x;
+                swarm.y[i] = y;
+                swarm.z[i] = z;
+                swarm.prevX[i] = prevX;
+                swarm.prevY[i] = prevY;
+                swarm.prevZ[i] = prevZ;
+                swarm.velX[i] = velX;
+                swarm.velZ[i] = velZ;
+                swarm.accelX[i] = accelX;
+                swarm.accelZ[i] = accelZ;
+            }
+        }
+        if (respawns > 0) {
+            respawnTotal.fetch_add(respawns, std::memory_order_relaxed);
+        }
+    });
+    swarm.respawns += respawnTotal.load(std::memory_order_relaxed);
+    swarm.steps += stepCount;
+    return stepCount;
+}
+
+void writeSatelliteInstances(const SatelliteSwarm& swarm, float heightOffset, float* instances, ThreadPool& pool) {
+    float alpha = swarm.accumulator / SATELLITE_TIMESTEP;
+    pool.parallelFor(swarm.size(), SATELLITE_BLOCK, [&](int, int first, int last) {
+        for (int i = first; i < last; ++i) {
+            instances[i * 3 + 0] = swarm.prevX[i] + (swarm.x[i] - swarm.prevX[i]) * alpha;
+            instances[i * 3 + 1] = swarm.prevY[i] + (swarm.y[i] - swarm.prevY[i]) * alpha + heightOffset;
+            instances[i * 3 + 2] = swarm.prevZ[i] + (swarm.z[i] - swarm.prevZ[i]) * alpha;
+        }
+    });
+}
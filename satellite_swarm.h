@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+
+#include "body_field.h"
+
+class ThreadPool;
+
+const float SATELLITE_TIMESTEP = 1.0f / 120.0f;
+const int   SATELLITE_MAX_STEPS = 8;      // per frame; a longer stall drops simulated time instead
+const float SATELLITE_GRAVITY = 20.0f;    // acceleration per unit of field slope
+
+// Satellites rolling on the deformed grid, accelerated down the field gradient
+// (a = -SATELLITE_GRAVITY * grad h) and integrated with kick-drift-kick leapfrog at a fixed
+// SATELLITE_TIMESTEP, independent of the frame rate. State is kept as structure-of-arrays so
+// every step streams through contiguous floats, split across the thread pool.
+//
+// Rendering interpolates between the last two steps by the fraction of a step left in the
+// accumulator. Satellites that leave the grid respawn on a circular orbit around the centre
+// body.
+struct SatelliteSwarm {
+    std::vector<float> x, y, z;              // y is the field height under the satellite
+    std::vector<float> prevX, prevY, prevZ;  // previous step, for interpolation
+    std::vector<float> velX, velZ;
+    std::vector<float> accelX, accelZ;
+    Body  centre = {};
+    float orbitalRadius = 0.0f;
+    float accumulator = 0.0f;
+    unsigned long long steps = 0;
+    unsigned long long respawns = 0;
+
+    int size() const { return (int)x.size(); }
+};
+
+// Places count satellites at rest around centre: a single one at orbitalRadius, more spread
+// over the centre body's footprint. Seeded, so runs are repeatable.
+void seedSatellites(SatelliteSwarm& swarm, int count, const Body& centre, float orbitalRadius);
+
+// Gives every satellite the circular-orbit velocity for the current field.
+void launchSatellites(SatelliteSwarm& swarm, const std::vector<Body>& bodies, const BodyBins& bins, float minDeformation, ThreadPool& pool);
+
+// Adds frameTime to the accumulator and runs the whole fixed steps it covers. Returns the
+// number of steps taken.
+int advanceSatellites(SatelliteSwarm& swarm, float frameTime, const std::vector<Body>& bodies, const BodyBins& bins, float minDeformation, ThreadPool& pool);
+
+// Writes interpolated xyz per satellite, lifted by heightOffset, for instanced drawing.
+void writeSatelliteInstances(const SatelliteSwarm& swarm, float heightOffset, float* instances, ThreadPool& pool);
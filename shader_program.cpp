@@ -0,0 +1,193 @@
+#include "shader_program.h"
+
+#include "disk_cache.h"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+const char* const UNIFORM_NAMES[UNIFORM_COUNT] = {
+    "model",
+    "meshScale",
+    "pointSize",
+    "deformOnGpu",
+    "relativeHeights",
+    "latticeFromVertexId",
+    "separateHeights",
+    "minDeformation",
+    "farField",
+    "bodies",
+    "tileStart",
+    "tileBodies",
+    "profileTable",
+    "profileTableSize",
+    "gridSize",
+    "gridScale",
+    "tileSize",
+    "tilesPerSide",
+    "lensCentreX",
+    "lensCentreY",
+    "lensRadius",
+    "lensStrength",
+    "aspect",
+    "starTexture",
+    "lensTable",
+    "lensTableSize",
+    "lensTableRadius",
+};
+
+struct PendingProgram {
+    GLuint vertexShader = 0;
+    GLuint fragmentShader = 0;
+};
+
+// Prints the log of whichever stage failed.
+void reportBuildFailure(GLuint program, const PendingProgram& pending) {
+    GLint success;
+    char infoLog[512];
+    glGetShaderiv(pending.vertexShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(pending.vertexShader, 512, NULL, infoLog);
+        std::cerr << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+        return;
+    }
+    glGetShaderiv(pending.fragmentShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(pending.fragmentShader, 512, NULL, infoLog);
+        std::cerr << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+        return;
+    }
+    glGetProgramInfoLog(program, 512, NULL, infoLog);
+    std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+}
+
+bool linked(GLuint program) {
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    return success == GL_TRUE;
+}
+
+}
+
+bool createShaderPrograms(const ShaderSource* sources, int count, const std::string& cacheDirectory, ShaderProgram* programs, ShaderBuildStats& stats) {
+    auto start = std::chrono::steady_clock::now();
+    stats = ShaderBuildStats();
+    stats.programs = count;
+
+    if (GLEW_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xffffffff);
+        stats.parallelCompile = true;
+    }
+    else if (GLEW_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xffffffff);
+        stats.parallelCompile = true;
+    }
+
+    GLint binaryFormats = 0;
+    if (!cacheDirectory.empty() && GLEW_ARB_get_program_binary) {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+    }
+    stats.cacheEnabled = binaryFormats > 0;
+
+    // A new driver, or a different GPU, never reads another's binaries.
+    uint64_t driverKey = hashString((const char*)glGetString(GL_VENDOR));
+    driverKey = hashString((const char*)glGetString(GL_RENDERER), driverKey);
+    driverKey = hashString((const char*)glGetString(GL_VERSION), driverKey);
+
+    std::vector<uint64_t> keys(count);
+    std::vector<PendingProgram> pending(count);
+    std::vector<unsigned char> binary;
+    for (int i = 0; i < count; ++i) {
+        programs[i] = ShaderProgram();
+        keys[i] = hashString(sources[i].fragment, hashString(sources[i].vertex, driverKey));
+        uint32_t format;
+        if (stats.cacheEnabled && readCacheFile(cacheFilePath(cacheDirectory, keys[i], ".glprog"), keys[i], format, binary)) {
+            GLuint program = glCreateProgram();
+            glProgramBinary(program, (GLenum)format, binary.data(), (GLsizei)binary.size());
+            if (linked(program)) {
+                programs[i].id = program;
+                ++stats.cacheHits;
+                continue;
+            }
+            glDeleteProgram(program);
+            ++stats.cacheRejected;
+        }
+    }
+
+    // Issue every compile and link before asking how any of them went.
+    for (int i = 0; i < count; ++i) {
+        if (programs[i].id) {
+            continue;
+        }
+        pending[i].vertexShader = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(pending[i].vertexShader, 1, &sources[i].vertex, NULL);
+        glCompileShader(pending[i].vertexShader);
+        pending[i].fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(pending[i].fragmentShader, 1, &sources[i].fragment, NULL);
+        glCompileShader(pending[i].fragmentShader);
+    }
+    for (int i = 0; i < count; ++i) {
+        if (!pending[i].vertexShader) {
+            continue;
+        }
+        GLuint program = glCreateProgram();
+        if (stats.cacheEnabled) {
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glAttachShader(program, pending[i].vertexShader);
+        glAttachShader(program, pending[i].fragmentShader);
+        glLinkProgram(program);
+        programs[i].id = program;
+    }
+
+    bool success = true;
+    for (int i = 0; i < count; ++i) {
+        ShaderProgram& program = programs[i];
+        if (pending[i].vertexShader) {
+            if (!linked(program.id)) {
+                reportBuildFailure(program.id, pending[i]);
+                glDeleteProgram(program.id);
+                program.id = 0;
+                success = false;
+            }
+            else if (stats.cacheEnabled) {
+                GLint length = 0;
+                glGetProgramiv(program.id, GL_PROGRAM_BINARY_LENGTH, &length);
+                binary.resize(length);
+                GLenum format = 0;
+                if (length > 0) {
+                    glGetProgramBinary(program.id, length, &length, &format, binary.data());
+                    writeCacheFile(cacheFilePath(cacheDirectory, keys[i], ".glprog"), keys[i], format, binary.data(), length);
+                }
+            }
+            glDeleteShader(pending[i].vertexShader);
+            glDeleteShader(pending[i].fragmentShader);
+        }
+        if (!program.id) {
+            continue;
+        }
+
+        for (int u = 0; u < UNIFORM_COUNT; ++u) {
+            program.locations[u] = glGetUniformLocation(program.id, UNIFORM_NAMES[u]);
+        }
+        GLuint cameraBlock = glGetUniformBlockIndex(program.id, "Camera");
+        if (cameraBlock != GL_INVALID_INDEX) {
+            glUniformBlockBinding(program.id, cameraBlock, CAMERA_BLOCK_BINDING);
+        }
+    }
+
+    stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return success;
+}
+
+GLuint createCameraBuffer(const CameraBlock& camera) {
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), &camera, GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, buffer);
+    return buffer;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <string>
+
+// Every uniform the programs set besides the Camera block. createShaderProgram looks each one
+// up once, at link time; a program that doesn't declare one gets -1, which glUniform* ignores.
+enum class Uniform {
+    Model,
+    MeshScale,
+    PointSize,
+    DeformOnGpu,
+    RelativeHeights,
+    LatticeFromVertexId,
+    SeparateHeights,
+    MinDeformation,
+    FarField,
+    Bodies,
+    TileStart,
+    TileBodies,
+    ProfileTable,
+    ProfileTableSize,
+    GridSize,
+    GridScale,
+    TileSize,
+    TilesPerSide,
+    LensCentreX,
+    LensCentreY,
+    LensRadius,
+    LensStrength,
+    Aspect,
+    StarTexture,
+    LensTable,
+    LensTableSize,
+    LensTableRadius,
+    Count
+};
+
+const int UNIFORM_COUNT = (int)Uniform::Count;
+
+// The std140 layout of the Camera uniform block the vertex shaders declare:
+//
+//     layout(std140) uniform Camera { mat4 view; mat4 projection; mat4 viewProjection; };
+//
+// It lives in one buffer bound to CAMERA_BLOCK_BINDING, shared by every program.
+struct CameraBlock {
+    float view[16];
+    float projection[16];
+    float viewProjection[16];
+};
+
+const GLuint CAMERA_BLOCK_BINDING = 0;
+
+struct ShaderProgram {
+    GLuint id = 0;
+    GLint  locations[UNIFORM_COUNT];
+    // The last int/float value RenderState set for each uniform, so repeats can be skipped.
+    uint32_t values[UNIFORM_COUNT];
+    bool     valueKnown[UNIFORM_COUNT] = {};
+
+    GLint location(Uniform uniform) const { return locations[(int)uniform]; }
+};
+
+struct ShaderSource {
+    const char* vertex;
+    const char* fragment;
+};
+
+struct ShaderBuildStats {
+    int    programs = 0;
+    int    cacheHits = 0;        // linked straight from a cached binary
+    int    cacheRejected = 0;    // cached binaries the driver refused, rebuilt from source
+    bool   cacheEnabled = false;
+    bool   parallelCompile = false;
+    double ms = 0.0;
+};
+
+// Builds count programs, resolves each one's Uniform locations and binds its Camera block (if
+// it has one) to CAMERA_BLOCK_BINDING.
+//
+// With a cache directory (and a driver that offers program binaries), each program is first
+// looked up there as a glGetProgramBinary blob keyed by a hash of its sources and the GL
+// vendor, renderer and version; a miss or a binary the driver rejects falls back to source,
+// and the fresh binary is stored for next time. Programs built from source are compiled and
+// linked as one batch, and only then asked for their status, so drivers with
+// KHR_parallel_shader_compile (which is switched on) can build them concurrently.
+//
+// Returns false if any program failed to build; its id is then 0.
+bool createShaderPrograms(const ShaderSource* sources, int count, const std::string& cacheDirectory, ShaderProgram* programs, ShaderBuildStats& stats);
+
+// A buffer holding one CameraBlock, bound to CAMERA_BLOCK_BINDING.
+GLuint createCameraBuffer(const CameraBlock& camera);
@@ -0,0 +1,184 @@
+#include "simulation.h"
+
+#include "thread_pool.h"
+#include "vertex_format.h"
+
+double simulationClock() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Simulation::Simulation(const std::vector<Body>& bodies, int gridSize, const float* flatLodVertices, size_t flatLodVertexCount, const ProfileTable* profile, bool halfHeights,
+    int satelliteCount, float orbitalRadius, float satelliteLift, float minDeformation, ThreadPool& pool)
+    : bodies(bodies), gridSize(gridSize), flatLodVertices(flatLodVertices), flatLodVertexCount(flatLodVertexCount), profile(profile), halfHeights(halfHeights), latticeGrid(flatLodVertices ? 0 : gridSize), satelliteLift(satelliteLift), minDeformation(minDeformation), pool(pool) {
+    seedSatellites(swarm, satelliteCount, bodies[0], orbitalRadius);
+}
+
+void Simulation::reserve(SimulationFrame& frame) const {
+    size_t bodyCount = bodies.size();
+    size_t gridVertexCount = flatLodVertices ? flatLodVertexCount : (size_t)gridSize * gridSize;
+    frame.bodies.reserve(bodyCount);
+    frame.settleY.reserve(bodyCount);
+    // Mass changes leave every footprint, and so the bins' sizes, as they are.
+    binBodies(bodies, gridSize, frame.bins);
+    frame.bounds.minY.reserve(frame.bins.tileStart.size());
+    frame.bounds.maxY.reserve(frame.bins.tileStart.size());
+    if (halfHeights) {
+        frame.gridHeights.reserve(gridVertexCount);
+    }
+    else {
+        frame.grid.reserve(gridVertexCount * 3);
+    }
+    frame.satellites.reserve(swarm.size() * 3);
+}
+
+void Simulation::step(const SimulationInput& input, float deltaTime, SimulationFrame& frame) {
+    auto start = std::chrono::steady_clock::now();
+    auto stageStart = start;
+    frame.stageCount = 0;
+    auto endStage = [&](const char* name) {
+        auto now = std::chrono::steady_clock::now();
+        frame.stages[frame.stageCount++] = { name, stageStart, std::chrono::duration<double, std::milli>(now - stageStart).count() };
+        stageStart = now;
+    };
+
+    if (bodies[0].strength != input.mass) {
+        bodies[0].strength = input.mass;
+        ++bodiesVersion;
+    }
+    // Bins, bounds, settle heights and the LOD grid only depend on the bodies and the grid
+    // path, so a slot last filled for the same ones still holds them; with the mass held, a
+    // step only advances the satellites.
+    bool stale = frame.bodiesVersion != bodiesVersion || frame.hasGrid != input.cpuGrid;
+    frame.bodiesVersion = bodiesVersion;
+    frame.hasGrid = input.cpuGrid;
+    frame.gridRect = GridRect();
+    if (stale) {
+        frame.bodies = bodies;
+        binBodies(bodies, gridSize, frame.bins);
+        frame.bins.profile = profile;
+        if (!input.cpuGrid && !flatLodVertices) {
+            estimateTileBounds(bodies, frame.bins, minDeformation, frame.bounds);
+        }
+        endStage("bin bodies");
+
+        // The lattice is only recomputed where a body changed; switching from the GPU path
+        // catches up on everything that changed in the meantime.
+        if (input.cpuGrid) {
+            if (flatLodVertices) {
+                int count = (int)flatLodVertexCount;
+                std::vector<float>& displaced = halfHeights ? lodVertices : frame.grid;
+                displaced.resize(flatLodVertexCount * 3);
+                displaceVertices(flatLodVertices, count, displaced.data(), bodies, frame.bins, minDeformation, pool);
+                if (halfHeights) {
+                    frame.gridHeights.resize(count);
+                    floatsToHalves(&displaced[1], count, 3, frame.gridHeights.data());
+                }
+            }
+            else {
+                frame.gridRect = latticeGrid.update(bodies, frame.bins, pool);
+                if (halfHeights) {
+                    latticeGrid.copyRectHeights(frame.gridRect, frame.gridHeights);
+                }
+                else {
+                    latticeGrid.copyRect(frame.gridRect, frame.grid);
+                }
+                latticeGrid.tileBounds(frame.bins.farField, minDeformation, frame.bounds);
+            }
+            endStage("grid cpu");
+        }
+
+        frame.settleY.resize(bodies.size());
+        for (size_t b = 0; b < bodies.size(); ++b) {
+            frame.settleY[b] = computeSettleHeight(bodies, (int)b, frame.bins, minDeformation);
+        }
+        endStage("settle");
+    }
+    stageStart = std::chrono::steady_clock::now();
+
+    // Satellites are launched onto circular orbits the first time the planet has mass, then
+    // advance in fixed steps however long the frame took.
+    if (!satellitesLaunched && input.mass > 0.0f) {
+        launchSatellites(swarm, bodies, frame.bins, minDeformation, pool);
+        satellitesLaunched = true;
+    }
+    if (satellitesLaunched) {
+        advanceSatellites(swarm, deltaTime, bodies, frame.bins, minDeformation, pool);
+    }
+    frame.satellites.resize(swarm.size() * 3);
+    writeSatelliteInstances(swarm, satelliteLift, frame.satellites.data(), pool);
+    endStage("satellite steps");
+
+    frame.step = ++steps;
+    frame.inputSequence = input.sequence;
+    frame.inputTime = input.time;
+    frame.simulationMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+SimulationThread::SimulationThread(Simulation& simulation, const SimulationInput& initialInput, bool threaded) : simulation(simulation) {
+    for (int i = 0; i < 3; ++i) {
+        simulation.reserve(frames.slot(i));
+    }
+    inputs.back() = initialInput;
+    inputs.publish();
+    lastStep = std::chrono::steady_clock::now();
+    stepOnce();
+    acquire();
+    if (threaded) {
+        worker = std::thread(&SimulationThread::run, this);
+    }
+}
+
+SimulationThread::~SimulationThread() {
+    if (worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+}
+
+void SimulationThread::submit(const SimulationInput& input) {
+    inputs.back() = input;
+    inputs.publish();
+    if (!worker.joinable()) {
+        stepOnce();
+    }
+}
+
+bool SimulationThread::acquire() {
+    if (!frames.acquire()) {
+        return false;
+    }
+    consumed.store(frames.front().step, std::memory_order_release);
+    // Passing through the mutex keeps the wake-up from landing between the simulation's check
+    // and its wait, so it can sleep without polling however long the renderer idles. The
+    // simulation only holds it for that check.
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+    }
+    wake.notify_one();
+    return true;
+}
+
+void SimulationThread::stepOnce() {
+    inputs.acquire();
+    const SimulationInput& input = inputs.front();
+    auto now = std::chrono::steady_clock::now();
+    float deltaTime = input.frameTime > 0.0f ? input.frameTime : std::chrono::duration<float>(now - lastStep).count();
+    lastStep = now;
+
+    simulation.step(input, deltaTime, frames.back());
+    unsigned long long step = frames.back().step;
+    frames.publish();
+    published.store(step, std::memory_order_release);
+}
+
+void SimulationThread::run() {
+    while (!stopping) {
+        stepOnce();
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&] { return stopping || consumed.load(std::memory_order_acquire) >= published.load(std::memory_order_relaxed); });
+    }
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "body_field.h"
+#include "incremental_grid.h"
+#include "satellite_swarm.h"
+#include "triple_buffer.h"
+
+class ThreadPool;
+
+// What the render thread hands the simulation: the latest input, stamped so the frame that
+// first shows it can report the input-to-display latency.
+struct SimulationInput {
+    float  mass = 0.0f;                // planet strength
+    bool   cpuGrid = false;            // also build the deformed grid on the CPU
+    float  frameTime = 0.0f;           // fixed step (headless); 0 measures wall time instead
+    unsigned long long sequence = 0;   // bumped whenever the mass input changes
+    double time = 0.0;                 // steady_clock seconds when it was sampled
+};
+
+// One stage of a simulation step, for the profiler: "bin bodies", "grid cpu", "settle" or
+// "satellite steps".
+struct SimulationStage {
+    const char* name = nullptr;        // string literal
+    std::chrono::steady_clock::time_point start;
+    double ms = 0.0;
+};
+
+// Everything one simulation step produces for the renderer. SimulationThread hands over every
+// frame it publishes, so a renderer that applies each gridRect keeps a full copy of the grid.
+struct SimulationFrame {
+    unsigned long long step = 0;
+    unsigned long long bodiesVersion = 0;  // changes whenever bodies (and so bins) do
+    unsigned long long inputSequence = 0;
+    double inputTime = 0.0;
+    double simulationMs = 0.0;
+    static const int MAX_STAGES = 4;
+    SimulationStage stages[MAX_STAGES];   // the ones this step ran, in order
+    int stageCount = 0;
+    std::vector<Body> bodies;
+    BodyBins bins;
+    TileBounds bounds;                 // exact with a CPU grid, else estimated from the bins
+    std::vector<float> settleY;        // per body
+    bool hasGrid = false;              // the input asked for a CPU grid
+    // LOD grid: every deformed xyz. Uniform lattice: only the vertices of gridRect, row by
+    // row, with heights relative to the far field (see IncrementalGrid); empty when none changed.
+    std::vector<float> grid;
+    // With half heights, just the y of the same vertices, as half floats; grid stays empty.
+    std::vector<uint16_t> gridHeights;
+    GridRect gridRect;
+    std::vector<float> satellites;     // interpolated xyz per satellite, lifted for drawing
+};
+
+// The per-frame CPU work of the app: mass update, binning, the CPU grid, settle heights and
+// the satellite swarm. GL-free, so it can run on any thread; the pool must only be used from
+// the thread calling step().
+class Simulation {
+public:
+    // flatLodVertices is the LOD grid to displace (flatLodVertexCount xyz vertices, which must
+    // outlive the simulation), or null for the uniform gridSize lattice;
+    // profile is the well shape (see BodyBins::profile); halfHeights hands the CPU grid over as
+    // SimulationFrame::gridHeights instead of xyz.
+    Simulation(const std::vector<Body>& bodies, int gridSize, const float* flatLodVertices, size_t flatLodVertexCount, const ProfileTable* profile, bool halfHeights,
+        int satelliteCount, float orbitalRadius, float satelliteLift, float minDeformation, ThreadPool& pool);
+
+    // Sizes every container in frame for the largest step this simulation can produce, so
+    // steps into it never allocate.
+    void reserve(SimulationFrame& frame) const;
+
+    void step(const SimulationInput& input, float deltaTime, SimulationFrame& frame);
+
+private:
+    std::vector<Body> bodies;
+    int gridSize;
+    const float* flatLodVertices;
+    size_t flatLodVertexCount;
+    const ProfileTable* profile;
+    bool halfHeights;
+    std::vector<float> lodVertices;    // displaced LOD grid, before it's cut down to half heights
+    IncrementalGrid latticeGrid;
+    unsigned long long bodiesVersion = 1;
+    SatelliteSwarm swarm;
+    bool satellitesLaunched = false;
+    float satelliteLift;
+    float minDeformation;
+    ThreadPool& pool;
+    unsigned long long steps = 0;
+};
+
+// Drives a Simulation and hands its frames to the renderer through a TripleBuffer, so the
+// render thread always draws the newest completed frame without waiting.
+//
+// Threaded, the simulation runs on its own thread one frame ahead of the renderer: it steps,
+// publishes, then sleeps until the renderer has taken that frame, so a frame costs the longer
+// of the two stages instead of their sum. Unthreaded, submit() steps inline, as a reference.
+class SimulationThread {
+public:
+    // Runs the first step before returning, so frame() is valid straight away.
+    SimulationThread(Simulation& simulation, const SimulationInput& initialInput, bool threaded);
+    ~SimulationThread();
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    // Render side; never waits for a simulation step.
+    void submit(const SimulationInput& input);
+    // Takes the newest completed frame, if any; returns whether frame() changed.
+    bool acquire();
+    const SimulationFrame& frame() const { return frames.front(); }
+
+    bool threaded() const { return worker.joinable(); }
+
+private:
+    void stepOnce();
+    void run();
+
+    Simulation& simulation;
+    TripleBuffer<SimulationInput> inputs;
+    TripleBuffer<SimulationFrame> frames;
+    std::chrono::steady_clock::time_point lastStep;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<unsigned long long> published{ 0 };
+    std::atomic<unsigned long long> consumed{ 0 };
+    std::atomic<bool> stopping{ false };
+};
+
+// steady_clock time in seconds, the clock SimulationInput::time is stamped with.
+double simulationClock();
@@ -0,0 +1,107 @@
+#include "stream_buffer.h"
+
+#include <chrono>
+#include <iostream>
+
+StreamBuffer::StreamBuffer(size_t regionSize, size_t vertexStride, bool allowPersistent)
+    : regionSize(regionSize), vertexStride(vertexStride) {
+    persistentMapping = allowPersistent && GLEW_ARB_buffer_storage;
+
+    glGenBuffers(1, &bufferId);
+    glBindBuffer(GL_ARRAY_BUFFER, bufferId);
+    if (persistentMapping) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, regionSize * REGION_COUNT, nullptr, flags);
+        mapped = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, regionSize * REGION_COUNT, flags);
+        if (!mapped) {
+            // Immutable storage can't be re-specified, so start over with a mutable buffer.
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glDeleteBuffers(1, &bufferId);
+            glGenBuffers(1, &bufferId);
+            glBindBuffer(GL_ARRAY_BUFFER, bufferId);
+            persistentMapping = false;
+        }
+    }
+    if (!persistentMapping) {
+        glBufferData(GL_ARRAY_BUFFER, regionSize, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+StreamBuffer::~StreamBuffer() {
+    for (GLsync& sync : fences) {
+        if (sync) {
+            glDeleteSync(sync);
+        }
+    }
+    if (mapped) {
+        glBindBuffer(GL_ARRAY_BUFFER, bufferId);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &bufferId);
+}
+
+void* StreamBuffer::begin() {
+    auto start = std::chrono::steady_clock::now();
+    frameStats.lastStalled = false;
+    void* region;
+
+    if (persistentMapping) {
+        current = (current + 1) % REGION_COUNT;
+        GLsync& sync = fences[current];
+        if (sync) {
+            GLenum status = glClientWaitSync(sync, 0, 0);
+            if (status == GL_TIMEOUT_EXPIRED) {
+                frameStats.lastStalled = true;
+                ++frameStats.stalls;
+                do {
+                    status = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+                } while (status == GL_TIMEOUT_EXPIRED);
+            }
+            glDeleteSync(sync);
+            sync = nullptr;
+        }
+        region = mapped + current * regionSize;
+    }
+    else {
+        glBindBuffer(GL_ARRAY_BUFFER, bufferId);
+        glBufferData(GL_ARRAY_BUFFER, regionSize, nullptr, GL_STREAM_DRAW);
+        region = glMapBufferRange(GL_ARRAY_BUFFER, 0, regionSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (!region) {
+            if (staging.empty()) {
+                std::cerr << "Mapping a stream buffer failed; uploading it with glBufferSubData" << std::endl;
+                staging.resize(regionSize);
+            }
+            staged = true;
+            region = staging.data();
+        }
+    }
+
+    frameStats.lastWaitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    frameStats.waitMs += frameStats.lastWaitMs;
+    ++frameStats.frames;
+    return region;
+}
+
+void StreamBuffer::end() {
+    if (!persistentMapping) {
+        glBindBuffer(GL_ARRAY_BUFFER, bufferId);
+        if (staged) {
+            glBufferSubData(GL_ARRAY_BUFFER, 0, regionSize, staging.data());
+            staged = false;
+        }
+        else {
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+    }
+}
+
+void StreamBuffer::fence() {
+    if (persistentMapping) {
+        if (fences[current]) {
+            glDeleteSync(fences[current]);
+        }
+        fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
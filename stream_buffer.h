@@ -0,0 +1,60 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <vector>
+
+// Vertex buffer for data rewritten every frame.
+//
+// With ARB_buffer_storage the buffer holds REGION_COUNT regions and stays persistently mapped:
+// each frame the CPU writes the next region while the GPU may still be reading the previous
+// ones, and a fence per region keeps it from overwriting data still in flight. Without the
+// extension (plain GL 3.3) it falls back to orphaning: a single region is re-specified with
+// glBufferData(NULL) and mapped with GL_MAP_INVALIDATE_BUFFER_BIT every frame; if that map
+// fails, the frame is written to a staging copy instead and uploaded with glBufferSubData.
+//
+// Per frame: begin() -> write -> end(), draw with baseVertex(), then fence() after the draw.
+class StreamBuffer {
+public:
+    struct Stats {
+        unsigned long long frames = 0;
+        unsigned long long stalls = 0;    // begin() calls that had to wait for the GPU
+        double             waitMs = 0.0;  // total time spent inside begin()
+        bool               lastStalled = false;
+        double             lastWaitMs = 0.0;
+    };
+
+    static const int REGION_COUNT = 3;
+
+    StreamBuffer(size_t regionSize, size_t vertexStride, bool allowPersistent);
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // Returns regionSize writable bytes for the next region (never null).
+    void* begin();
+    void end();
+    // Marks the current region as in use by the draws issued so far.
+    void fence();
+
+    GLuint buffer() const { return bufferId; }
+    bool persistent() const { return persistentMapping; }
+    // First vertex of the current region, for glDrawElementsBaseVertex.
+    GLint baseVertex() const { return (GLint)(current * regionSize / vertexStride); }
+    // Byte offset of the current region, for attribute pointers (e.g. per-instance data).
+    size_t regionOffset() const { return current * regionSize; }
+    const Stats& stats() const { return frameStats; }
+
+private:
+    GLuint bufferId = 0;
+    size_t regionSize;
+    size_t vertexStride;
+    int    current = 0;
+    bool   persistentMapping;
+    char*  mapped = nullptr;
+    std::vector<char> staging;   // this frame's data when the orphaning map failed
+    bool   staged = false;
+    GLsync fences[REGION_COUNT] = {};
+    Stats  frameStats;
+};
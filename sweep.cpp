@@ -0,0 +1,443 @@
+// Parameter sweeps of the curvature field for offline analysis (no window, context or GL
+// library needed).
+//
+// Every combination of the values given is one case: the planet at the grid centre with that
+// mass, radius and well profile, plus any --bodies scattered as in the app, on a lattice of
+// that size floored at that minDeformation. Each case's settle heights and full height field
+// go to disk as soon as they're computed:
+//
+//   PREFIX.csv          one summary row per case (parameters, planet settle height, lowest
+//                       height, byte offset of the case's record in PREFIX.bin)
+//   PREFIX.bin          --fields bin (default): a 64-byte file header, then per case a 64-byte
+//                       record header, every body's settle height and gridSize * gridSize
+//                       heights, row by row (float32, native byte order)
+//   PREFIX_fields.csv   --fields csv: per case one line per lattice row, "case,z,h0,h1,..."
+//
+// Cases run in batches. A batch's bodies are binned case by case, then the rows of all its
+// fields are dealt out across the pool together, so small grids keep every core busy too.
+// While the pool computes one batch a writer thread streams out the one before it, so memory
+// stays at two batches whatever the sweep's length; --memory-mb caps what a batch may hold.
+//
+//   spacetime-sweep --mass 0.5:50:100 [--radius 5] [--min-deformation -5] [--grid-size 1000]
+//                   [--profile softened,plummer,flamm] [--bodies N] [--threads N]
+//                   [--memory-mb 512] [--fields bin|csv|none] [--out PREFIX]
+//
+// A value list is either comma separated ("3,5,8") or FROM:TO:COUNT, COUNT values evenly
+// spaced from FROM to TO inclusive.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "body_field.h"
+#include "curvature.h"
+#include "radial_profile.h"
+#include "thread_pool.h"
+
+namespace {
+
+const char SWEEP_MAGIC[8] = { 'S', 'T', 'S', 'W', 'E', 'E', 'P', '\0' };
+const uint32_t SWEEP_VERSION = 1;
+
+struct SweepFileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t bodyCount;    // settle heights per record
+    float    gridScale;    // the lattice spans [-gridScale, gridScale] on x and z
+    uint32_t reserved[11];
+};
+static_assert(sizeof(SweepFileHeader) == 64, "sweep file header must stay 64 bytes");
+
+struct SweepRecordHeader {
+    uint64_t caseIndex;
+    uint32_t gridSize;
+    uint32_t profile;      // RadialProfile
+    float    mass;
+    float    radius;
+    float    minDeformation;
+    float    settleY;      // the planet's
+    float    lowestY;
+    uint32_t reserved[7];
+};
+static_assert(sizeof(SweepRecordHeader) == 64, "sweep record header must stay 64 bytes");
+
+enum class FieldOutput {
+    Binary,
+    Csv,
+    None
+};
+
+// The sweep's axes; a case index is a mixed-radix number over them, mass fastest.
+struct SweepSpec {
+    std::vector<float> masses;
+    std::vector<float> radii = { 5.0f };
+    std::vector<float> minDeformations = { -5.0f };
+    std::vector<int>   gridSizes = { 1000 };
+    std::vector<RadialProfile> profiles = { RadialProfile::Softened };
+
+    unsigned long long caseCount() const {
+        return (unsigned long long)masses.size() * radii.size() * minDeformations.size() * gridSizes.size() * profiles.size();
+    }
+};
+
+// One case being computed or written.
+struct CaseSlot {
+    unsigned long long index = 0;
+    float mass = 0.0f;
+    float radius = 0.0f;
+    float minDeformation = 0.0f;
+    RadialProfile profile = RadialProfile::Softened;
+    std::vector<Body> bodies;
+    BodyBins bins;
+    std::vector<float> settleY;
+    std::vector<float> heights;
+    std::atomic<float> lowestY{ std::numeric_limits<float>::infinity() };
+};
+
+struct SweepOutput {
+    FILE* summary = nullptr;
+    FILE* fields = nullptr;
+    FieldOutput fieldOutput = FieldOutput::Binary;
+    unsigned long long fieldOffset = 0;
+    unsigned long long bytes = 0;
+    std::atomic<bool> failed{ false };   // set by the writer thread, read by the main loop
+    std::vector<char> line;   // one CSV field row
+};
+
+bool parseValues(const char* spec, std::vector<float>& values) {
+    values.clear();
+    float from, to;
+    int count;
+    char end;
+    if (std::sscanf(spec, "%f:%f:%d%c", &from, &to, &count, &end) == 3) {
+        if (count < 1) {
+            return false;
+        }
+        for (int i = 0; i < count; ++i) {
+            values.push_back(count == 1 ? from : from + (to - from) * i / (count - 1));
+        }
+        return true;
+    }
+    const char* cursor = spec;
+    for (;;) {
+        char* next;
+        float value = std::strtof(cursor, &next);
+        if (next == cursor) {
+            return false;
+        }
+        values.push_back(value);
+        if (*next == '\0') {
+            return true;
+        }
+        if (*next != ',') {
+            return false;
+        }
+        cursor = next + 1;
+    }
+}
+
+bool parseGridSizes(const char* spec, std::vector<int>& sizes) {
+    std::vector<float> values;
+    if (!parseValues(spec, values)) {
+        return false;
+    }
+    sizes.clear();
+    for (float value : values) {
+        if (!(value >= 1.5f && value < MAX_GRID_SIZE + 0.5f)) {
+            return false;
+        }
+        int size = (int)(value + 0.5f);
+        sizes.push_back(size);
+    }
+    return true;
+}
+
+bool parseProfiles(const char* spec, std::vector<RadialProfile>& profiles) {
+    profiles.clear();
+    std::string names(spec);
+    size_t start = 0;
+    for (;;) {
+        size_t comma = names.find(',', start);
+        RadialProfile profile;
+        if (!parseRadialProfile(names.substr(start, comma - start).c_str(), profile)) {
+            return false;
+        }
+        profiles.push_back(profile);
+        if (comma == std::string::npos) {
+            return true;
+        }
+        start = comma + 1;
+    }
+}
+
+// Fills slot's parameters for case index, bins its bodies and finds their settle heights.
+void prepareCase(CaseSlot& slot, unsigned long long index, const SweepSpec& spec, const std::vector<Body>& scattered, const ProfileTable* const* tables) {
+    unsigned long long rest = index;
+    slot.index = index;
+    slot.mass = spec.masses[rest % spec.masses.size()];
+    rest /= spec.masses.size();
+    slot.radius = spec.radii[rest % spec.radii.size()];
+    rest /= spec.radii.size();
+    slot.minDeformation = spec.minDeformations[rest % spec.minDeformations.size()];
+    rest /= spec.minDeformations.size();
+    int gridSize = spec.gridSizes[rest % spec.gridSizes.size()];
+    rest /= spec.gridSizes.size();
+    slot.profile = spec.profiles[rest];
+
+    slot.bodies = scattered;
+    slot.bodies[0] = { 0.0f, 0.0f, slot.radius, slot.mass };
+    binBodies(slot.bodies, gridSize, slot.bins);
+    slot.bins.profile = tables[(int)slot.profile];
+    slot.settleY.resize(slot.bodies.size());
+    for (size_t b = 0; b < slot.bodies.size(); ++b) {
+        slot.settleY[b] = computeSettleHeight(slot.bodies, (int)b, slot.bins, slot.minDeformation);
+    }
+    slot.heights.resize((size_t)gridSize * gridSize);
+    // Every row lowers it; negative masses raise the field, so it can end up above 0.
+    slot.lowestY.store(std::numeric_limits<float>::infinity(), std::memory_order_relaxed);
+}
+
+bool writeFieldRows(const CaseSlot& slot, SweepOutput& output) {
+    int gridSize = slot.bins.gridSize;
+    // Worst case per height: sign, 9 significant digits, exponent and a comma.
+    output.line.resize(32 + (size_t)gridSize * 18);
+    for (int z = 0; z < gridSize; ++z) {
+        const float* row = &slot.heights[(size_t)z * gridSize];
+        char* out = output.line.data();
+        char* end = out + output.line.size();
+        out += std::snprintf(out, end - out, "%llu,%d", slot.index, z);
+        for (int x = 0; x < gridSize; ++x) {
+            out += std::snprintf(out, end - out, ",%.9g", row[x]);
+        }
+        *out++ = '\n';
+        size_t size = out - output.line.data();
+        if (std::fwrite(output.line.data(), 1, size, output.fields) != size) {
+            return false;
+        }
+        output.bytes += size;
+    }
+    return true;
+}
+
+// Runs on the writer thread, one batch at a time and in case order.
+void writeBatch(const CaseSlot* slots, int count, SweepOutput& output) {
+    for (int i = 0; i < count && !output.failed; ++i) {
+        const CaseSlot& slot = slots[i];
+        long long fieldOffset = -1;
+        bool written = true;
+        if (output.fieldOutput == FieldOutput::Binary) {
+            SweepRecordHeader record = {};
+            record.caseIndex = slot.index;
+            record.gridSize = (uint32_t)slot.bins.gridSize;
+            record.profile = (uint32_t)slot.profile;
+            record.mass = slot.mass;
+            record.radius = slot.radius;
+            record.minDeformation = slot.minDeformation;
+            record.settleY = slot.settleY[0];
+            record.lowestY = slot.lowestY.load(std::memory_order_relaxed);
+            written = std::fwrite(&record, sizeof(record), 1, output.fields) == 1
+                && std::fwrite(slot.settleY.data(), sizeof(float), slot.settleY.size(), output.fields) == slot.settleY.size()
+                && std::fwrite(slot.heights.data(), sizeof(float), slot.heights.size(), output.fields) == slot.heights.size();
+            fieldOffset = (long long)output.fieldOffset;
+            size_t size = sizeof(record) + (slot.settleY.size() + slot.heights.size()) * sizeof(float);
+            output.fieldOffset += size;
+            output.bytes += size;
+        }
+        else if (output.fieldOutput == FieldOutput::Csv) {
+            written = writeFieldRows(slot, output);
+        }
+
+        int size = std::fprintf(output.summary, "%llu,%d,%s,%.9g,%.9g,%.9g,%.9g,%.9g,%lld\n",
+            slot.index, slot.bins.gridSize, radialProfileName(slot.profile), slot.mass, slot.radius, slot.minDeformation,
+            slot.settleY[0], slot.lowestY.load(std::memory_order_relaxed), fieldOffset);
+        if (!written || size < 0) {
+            std::cerr << "Failed to write case " << slot.index << std::endl;
+            output.failed = true;
+        }
+        else {
+            output.bytes += size;
+        }
+    }
+}
+
+FILE* openOutput(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Failed to open " << path << std::endl;
+    }
+    return file;
+}
+
+}
+
+int main(int argc, char** argv) {
+    SweepSpec spec;
+    int extraBodies = 0;
+    int threads = 0;
+    double memoryMb = 512.0;
+    std::string prefix = "sweep";
+    FieldOutput fieldOutput = FieldOutput::Binary;
+    bool valid = true;
+    for (int i = 1; i < argc && valid; ++i) {
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value) {
+            valid = false;
+        }
+        else if (std::strcmp(argv[i], "--mass") == 0) {
+            valid = parseValues(value, spec.masses);
+        }
+        else if (std::strcmp(argv[i], "--radius") == 0) {
+            valid = parseValues(value, spec.radii);
+        }
+        else if (std::strcmp(argv[i], "--min-deformation") == 0) {
+            valid = parseValues(value, spec.minDeformations);
+        }
+        else if (std::strcmp(argv[i], "--grid-size") == 0) {
+            valid = parseGridSizes(value, spec.gridSizes);
+        }
+        else if (std::strcmp(argv[i], "--profile") == 0) {
+            valid = parseProfiles(value, spec.profiles);
+        }
+        else if (std::strcmp(argv[i], "--bodies") == 0) {
+            extraBodies = std::max(0, std::atoi(value));
+        }
+        else if (std::strcmp(argv[i], "--threads") == 0) {
+            threads = std::max(0, std::atoi(value));
+        }
+        else if (std::strcmp(argv[i], "--memory-mb") == 0) {
+            memoryMb = std::atof(value);
+        }
+        else if (std::strcmp(argv[i], "--fields") == 0) {
+            valid = std::strcmp(value, "bin") == 0 || std::strcmp(value, "csv") == 0 || std::strcmp(value, "none") == 0;
+            fieldOutput = std::strcmp(value, "bin") == 0 ? FieldOutput::Binary : std::strcmp(value, "csv") == 0 ? FieldOutput::Csv : FieldOutput::None;
+        }
+        else if (std::strcmp(argv[i], "--out") == 0) {
+            prefix = value;
+        }
+        else {
+            valid = false;
+        }
+        ++i;
+    }
+    if (!valid || spec.masses.empty()) {
+        std::cerr << "Usage: " << argv[0] << " --mass VALUES [--radius VALUES] [--min-deformation VALUES] [--grid-size VALUES (2-" << MAX_GRID_SIZE << ")]" << std::endl
+                  << "       [--profile softened,plummer,flamm] [--bodies N] [--threads N] [--memory-mb MB]" << std::endl
+                  << "       [--fields bin|csv|none] [--out PREFIX]" << std::endl
+                  << "VALUES is a comma-separated list or FROM:TO:COUNT" << std::endl;
+        return -1;
+    }
+
+    ThreadPool pool(threads);
+    std::unique_ptr<ProfileTable> tableStorage[3];
+    const ProfileTable* tables[3] = {};
+    for (RadialProfile profile : spec.profiles) {
+        if (!tables[(int)profile]) {
+            tableStorage[(int)profile].reset(new ProfileTable(profile));
+            tables[(int)profile] = tableStorage[(int)profile].get();
+        }
+    }
+    std::vector<Body> scattered(1);
+    scatterBodies(scattered, extraBodies);
+
+    // Two batches live at once, one computing and one writing. Up to four cases per
+    // participant, so the rows of a small grid still give every core a share.
+    int largestGrid = *std::max_element(spec.gridSizes.begin(), spec.gridSizes.end());
+    double caseBytes = (double)largestGrid * largestGrid * sizeof(float);
+    unsigned long long caseCount = spec.caseCount();
+    int batchSize = (int)std::min<double>({ memoryMb * 1024.0 * 1024.0 / (2.0 * caseBytes), 4.0 * pool.size(), (double)caseCount });
+    batchSize = std::max(1, batchSize);
+    std::unique_ptr<CaseSlot[]> slots[2] = { std::unique_ptr<CaseSlot[]>(new CaseSlot[batchSize]), std::unique_ptr<CaseSlot[]>(new CaseSlot[batchSize]) };
+
+    SweepOutput output;
+    output.fieldOutput = fieldOutput;
+    output.summary = openOutput(prefix + ".csv");
+    if (fieldOutput == FieldOutput::Binary) {
+        output.fields = openOutput(prefix + ".bin");
+    }
+    else if (fieldOutput == FieldOutput::Csv) {
+        output.fields = openOutput(prefix + "_fields.csv");
+    }
+    if (!output.summary || (fieldOutput != FieldOutput::None && !output.fields)) {
+        return -1;
+    }
+    std::fprintf(output.summary, "case,grid_size,profile,mass,radius,min_deformation,settle_y,lowest_y,field_offset\n");
+    if (fieldOutput == FieldOutput::Binary) {
+        SweepFileHeader header = {};
+        std::memcpy(header.magic, SWEEP_MAGIC, sizeof(SWEEP_MAGIC));
+        header.version = SWEEP_VERSION;
+        header.bodyCount = (uint32_t)scattered.size();
+        header.gridScale = GRID_SCALE;
+        std::fwrite(&header, sizeof(header), 1, output.fields);
+        output.fieldOffset = sizeof(header);
+    }
+
+    std::fprintf(stderr, "Sweep: %llu cases in batches of %d on %d threads (up to %.0f MB of fields in memory)\n",
+        caseCount, batchSize, pool.size(), 2.0 * batchSize * caseBytes / (1024.0 * 1024.0));
+
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    double writeWaitSeconds = 0.0;
+    double vertices = 0.0;
+    std::vector<size_t> rowStart(batchSize + 1);
+    std::thread writer;
+    int batchIndex = 0;
+    for (unsigned long long first = 0; first < caseCount && !output.failed; first += batchSize, ++batchIndex) {
+        CaseSlot* batch = slots[batchIndex % 2].get();
+        int count = (int)std::min<unsigned long long>(batchSize, caseCount - first);
+
+        pool.parallelFor(count, 1, [&](int, int begin, int end) {
+            for (int c = begin; c < end; ++c) {
+                prepareCase(batch[c], first + c, spec, scattered, tables);
+            }
+        });
+
+        // The rows of every field in the batch as one range, dealt out in blocks of rows.
+        for (int c = 0; c < count; ++c) {
+            rowStart[c + 1] = rowStart[c] + batch[c].bins.gridSize;
+            vertices += (double)batch[c].heights.size();
+        }
+        int totalRows = (int)rowStart[count];
+        int rowsPerBlock = std::max(1, totalRows / (pool.size() * 8));
+        pool.parallelFor(totalRows, rowsPerBlock, [&](int, int begin, int end) {
+            int c = (int)(std::upper_bound(rowStart.begin(), rowStart.begin() + count + 1, (size_t)begin) - rowStart.begin()) - 1;
+            while (begin < end) {
+                CaseSlot& slot = batch[c];
+                int firstRow = begin - (int)rowStart[c];
+                int lastRow = std::min(end - (int)rowStart[c], slot.bins.gridSize);
+                float* heights = &slot.heights[(size_t)firstRow * slot.bins.gridSize];
+                atomicMin(slot.lowestY, generateFieldHeights(heights, firstRow, lastRow, slot.bodies, slot.bins, slot.minDeformation));
+                begin = (int)rowStart[c] + lastRow;
+                ++c;
+            }
+        });
+
+        Clock::time_point waitStart = Clock::now();
+        if (writer.joinable()) {
+            writer.join();
+        }
+        writeWaitSeconds += std::chrono::duration<double>(Clock::now() - waitStart).count();
+        writer = std::thread(writeBatch, batch, count, std::ref(output));
+    }
+    if (writer.joinable()) {
+        writer.join();
+    }
+
+    bool closed = std::fclose(output.summary) == 0;
+    if (output.fields) {
+        closed = std::fclose(output.fields) == 0 && closed;
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::fprintf(stderr, "Sweep: %llu cases in %.2f s, %.1f M vertices/s, %.1f MB written, %.2f s waiting on the writer\n",
+        caseCount, seconds, vertices / seconds * 1e-6, output.bytes / (1024.0 * 1024.0), writeWaitSeconds);
+    return output.failed || !closed ? -1 : 0;
+}
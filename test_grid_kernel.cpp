@@ -0,0 +1,168 @@
+// Checks every grid kernel this CPU can run against the scalar reference gridHeightAt().
+//
+// Each of the scalar, SSE4.1 and AVX2 kernels is forced in turn (forceGridKernel(); ones the
+// CPU lacks are skipped) and fed rows of random positions plus the edge cases: deep inside the
+// disk, exactly on its rim and one float either side, and the far field. Row lengths are odd
+// so the vector loops hand a tail to the scalar code. computeGridRowHeights() and a single
+// body through accumulateBodyRow() must both be within MAX_ULPS of gridHeightAt(), the bound
+// grid_kernel.h documents.
+//
+//   spacetime-test-grid-kernel
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "curvature.h"
+#include "grid_kernel.h"
+
+namespace {
+
+const int64_t MAX_ULPS = 1;
+
+// Distance in units in the last place, counting across zero.
+int64_t ulpDistance(float a, float b) {
+    auto ordered = [](float f) {
+        int32_t bits;
+        std::memcpy(&bits, &f, sizeof bits);
+        return bits < 0 ? (int64_t)INT32_MIN - bits : (int64_t)bits;
+    };
+    int64_t d = ordered(a) - ordered(b);
+    return d < 0 ? -d : d;
+}
+
+struct Body {
+    float x, z, radius, strength;
+};
+
+struct Row {
+    float zPos;
+    std::vector<float> xs;
+};
+
+// Rows around body: random positions over the whole grid, then the rim and its neighbours,
+// positions inside the disk and far-field positions, all on the body's own row and off it.
+std::vector<Row> testRows(const Body& body, std::mt19937& random) {
+    float influence = body.radius * 2.5f;
+    std::uniform_real_distribution<float> anywhere(-GRID_SCALE, GRID_SCALE);
+    std::uniform_real_distribution<float> insideDisk(-influence, influence);
+    std::vector<Row> rows;
+
+    for (int r = 0; r < 8; ++r) {
+        Row row = { anywhere(random), {} };
+        for (int i = 0; i < 101; ++i) {
+            row.xs.push_back(anywhere(random));
+        }
+        rows.push_back(row);
+    }
+
+    Row rim = { body.z, {} };
+    for (float edge : { body.x + influence, body.x - influence }) {
+        rim.xs.push_back(edge);
+        rim.xs.push_back(std::nextafter(edge, -std::numeric_limits<float>::infinity()));
+        rim.xs.push_back(std::nextafter(edge, std::numeric_limits<float>::infinity()));
+    }
+    rim.xs.push_back(body.x);
+    rows.push_back(rim);
+    // Rows through the top and bottom of the disk: dist == influence at xs == body.x.
+    for (float zPos : { body.z + influence, body.z - influence,
+                        std::nextafter(body.z + influence, 0.0f), std::nextafter(body.z - influence, 0.0f) }) {
+        Row row = { zPos, {} };
+        for (int i = -6; i <= 6; ++i) {
+            row.xs.push_back(body.x + i * 1e-3f);
+        }
+        rows.push_back(row);
+    }
+
+    Row inside = { body.z + insideDisk(random) * 0.5f, {} };
+    for (int i = 0; i < 37; ++i) {
+        inside.xs.push_back(body.x + insideDisk(random) * 0.5f);
+    }
+    rows.push_back(inside);
+
+    Row far = { body.z + influence * 3.0f, {} };
+    for (int i = 0; i < 29; ++i) {
+        far.xs.push_back(body.x + (i - 14) * influence);
+    }
+    rows.push_back(far);
+    return rows;
+}
+
+// Worst ULP error of the current kernel over the rows; prints the first offending vertex.
+int64_t checkRows(const Body& body, const std::vector<Row>& rows, float minDeformation, const char* kernel) {
+    const float noFloor = -std::numeric_limits<float>::infinity();
+    int64_t worst = 0;
+    std::vector<float> heights, deformation, covered;
+    for (const Row& row : rows) {
+        int count = (int)row.xs.size();
+        heights.assign(count, 0.0f);
+        deformation.assign(count, 0.0f);
+        covered.assign(count, 0.0f);
+        computeGridRowHeights(row.xs.data(), row.zPos, count, body.x, body.z, body.radius, body.strength, minDeformation, heights.data());
+        accumulateBodyRow(row.xs.data(), row.zPos, count, body.x, body.z, body.radius, body.strength, deformation.data(), covered.data());
+
+        for (int i = 0; i < count; ++i) {
+            float expected = gridHeightAt(row.xs[i], row.zPos, body.x, body.z, body.radius, body.strength, minDeformation);
+            // One body alone: inside the disk the well is all there is, outside only the far field,
+            // so a vertex put on the wrong side of the rim is off by far more than an ulp.
+            float expectedWell = gridHeightAt(row.xs[i], row.zPos, body.x, body.z, body.radius, body.strength, noFloor);
+            float accumulated = covered[i] != 0.0f ? deformation[i] : -body.strength * 0.1f;
+
+            int64_t heightUlps = ulpDistance(heights[i], expected);
+            int64_t accumulateUlps = ulpDistance(accumulated, expectedWell);
+            if (heightUlps > MAX_ULPS || accumulateUlps > MAX_ULPS) {
+                std::printf("FAIL %s body (%g, %g) r %g s %g at (%.9g, %.9g): computeGridRowHeights %.9g, accumulateBodyRow %.9g, gridHeightAt %.9g / %.9g\n",
+                    kernel, body.x, body.z, body.radius, body.strength, row.xs[i], row.zPos, heights[i], accumulated, expected, expectedWell);
+                return std::max(heightUlps, accumulateUlps);
+            }
+            worst = std::max(worst, std::max(heightUlps, accumulateUlps));
+        }
+    }
+    return worst;
+}
+
+}
+
+int main() {
+    const Body bodies[] = {
+        { 0.0f, 0.0f, 5.0f, 1.0f },
+        { 0.0f, 0.0f, 5.0f, 20.0f },
+        { 3.3f, -7.1f, 2.0f, 8.0f },
+        { -61.7f, 42.25f, 11.5f, 0.37f },
+        { 95.0f, 90.0f, 8.0f, 5.0f },
+    };
+    const float minDeformations[] = { -5.0f, -std::numeric_limits<float>::infinity() };
+    const char* kernels[] = { "scalar", "sse4.1", "avx2" };
+
+    int failures = 0;
+    for (const char* kernel : kernels) {
+        if (!forceGridKernel(kernel)) {
+            std::printf("skip %s: not supported by this CPU\n", kernel);
+            continue;
+        }
+        int64_t worst = 0;
+        bool failed = false;
+        std::mt19937 random(12345);
+        for (const Body& body : bodies) {
+            std::vector<Row> rows = testRows(body, random);
+            for (float minDeformation : minDeformations) {
+                int64_t ulps = checkRows(body, rows, minDeformation, kernel);
+                worst = std::max(worst, ulps);
+                failed = failed || ulps > MAX_ULPS;
+            }
+        }
+        if (failed) {
+            ++failures;
+        }
+        else {
+            std::printf("ok   %s: worst error %lld ulp (bound %lld)\n", kernel, (long long)worst, (long long)MAX_ULPS);
+        }
+    }
+    std::printf("%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
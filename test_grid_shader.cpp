@@ -0,0 +1,320 @@
+// Checks that the grid vertex shader deforms the lattice the way the CPU does.
+//
+// Runs GRID_VERTEX_SHADER_SOURCE itself (grid_shader.h) in a headless GL context, with the
+// camera and model set to identity so gl_Position is the deformed vertex, and captures it with
+// transform feedback. The lattice goes in both ways the app feeds it, as aPos and rebuilt from
+// gl_VertexID, for even and odd grid sizes. Single bodies must match generateGrid() and a
+// scattered set generateField() (body_field.h), within SHADER_TOLERANCE_PER_STRENGTH times
+// the strengths involved. Exits with SKIP_CODE, which ctest reports as skipped, when no GL
+// 3.3 context can be created.
+//
+//   spacetime-test-grid-shader
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "body_field.h"
+#include "curvature.h"
+#include "grid_shader.h"
+#include "headless_context.h"
+#include "radial_profile.h"
+#include "thread_pool.h"
+
+namespace {
+
+const int SKIP_CODE = 77;
+
+// The shader reads the baked softened profile through linear texture filtering, generateGrid()
+// evaluates it exactly: the table is within ProfileTable::MAX_ERROR (2e-4) per unit strength,
+// and the rest covers the filter's fixed-point weights (8 bits on typical GPUs).
+const float SHADER_TOLERANCE_PER_STRENGTH = 5e-4f;
+// The CPU tests the rim on the distance and the shader on its square; within this much of
+// u = 1 the two may fall on opposite sides, and such vertices are left out.
+const float RIM_BAND = 1e-5f;
+
+struct Case {
+    float x, z, radius, strength;
+};
+
+// The grid program's uniforms and GL objects, set up as main.cpp sets them for deformOnGpu.
+struct GridShader {
+    GLuint program = 0;
+    GLuint vao = 0;
+    GLuint latticeBuffer = 0;
+    GLuint feedbackBuffer = 0;
+    GLuint cameraBuffer = 0;
+    GLuint bodyBuffers[3] = {};
+    GLuint bodyTextures[3] = {};
+    GLuint profileTexture = 0;
+    GLuint framebuffer = 0;        // the headless context has no default one, and draws need
+    GLuint colorBuffer = 0;        // a complete framebuffer even with rasterization off
+
+    GLint location(const char* name) const { return glGetUniformLocation(program, name); }
+};
+
+bool buildGridShader(GridShader& shader, const ProfileTable& table) {
+    GLuint vertex = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertex, 1, &GRID_VERTEX_SHADER_SOURCE, nullptr);
+    glCompileShader(vertex);
+    GLint ok = 0;
+    glGetShaderiv(vertex, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetShaderInfoLog(vertex, sizeof(log), nullptr, log);
+        std::printf("FAIL grid vertex shader doesn't compile:\n%s\n", log);
+        return false;
+    }
+    shader.program = glCreateProgram();
+    glAttachShader(shader.program, vertex);
+    const char* captured = "gl_Position";
+    glTransformFeedbackVaryings(shader.program, 1, &captured, GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(shader.program);
+    glDeleteShader(vertex);
+    glGetProgramiv(shader.program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetProgramInfoLog(shader.program, sizeof(log), nullptr, log);
+        std::printf("FAIL grid vertex shader doesn't link:\n%s\n", log);
+        return false;
+    }
+
+    const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    float camera[48];
+    for (int m = 0; m < 3; ++m) {
+        std::copy(identity, identity + 16, camera + m * 16);
+    }
+    glGenBuffers(1, &shader.cameraBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, shader.cameraBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(camera), camera, GL_STATIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, shader.cameraBuffer);
+    glUniformBlockBinding(shader.program, glGetUniformBlockIndex(shader.program, "Camera"), 0);
+
+    const GLenum bodyTextureFormats[3] = { GL_RGBA32F, GL_R32I, GL_R32I };
+    glGenBuffers(3, shader.bodyBuffers);
+    glGenTextures(3, shader.bodyTextures);
+    for (int i = 0; i < 3; ++i) {
+        glBindBuffer(GL_TEXTURE_BUFFER, shader.bodyBuffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_BUFFER, shader.bodyTextures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, bodyTextureFormats[i], shader.bodyBuffers[i]);
+    }
+    glGenTextures(1, &shader.profileTexture);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_1D, shader.profileTexture);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_R32F, table.sampleCount(), 0, GL_RED, GL_FLOAT, table.data());
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+
+    glUseProgram(shader.program);
+    glUniform1i(shader.location("bodies"), 0);
+    glUniform1i(shader.location("tileStart"), 1);
+    glUniform1i(shader.location("tileBodies"), 2);
+    glUniform1i(shader.location("profileTable"), 3);
+    glUniform1f(shader.location("profileTableSize"), (float)ProfileTable::PROFILE_TABLE_SIZE);
+    glUniform1f(shader.location("gridScale"), GRID_SCALE);
+    glUniform1i(shader.location("tileSize"), BODY_TILE_SIZE);
+    glUniform1i(shader.location("deformOnGpu"), 1);
+    glUniform1i(shader.location("relativeHeights"), 0);
+    glUniform1i(shader.location("separateHeights"), 0);
+    glUniformMatrix4fv(shader.location("model"), 1, GL_FALSE, identity);
+
+    glGenVertexArrays(1, &shader.vao);
+    glGenBuffers(1, &shader.latticeBuffer);
+    glGenBuffers(1, &shader.feedbackBuffer);
+    glGenRenderbuffers(1, &shader.colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, shader.colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, 1, 1);
+    glGenFramebuffers(1, &shader.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, shader.framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, shader.colorBuffer);
+    glEnable(GL_RASTERIZER_DISCARD);
+    return true;
+}
+
+void destroyGridShader(GridShader& shader) {
+    glDeleteProgram(shader.program);
+    glDeleteVertexArrays(1, &shader.vao);
+    glDeleteBuffers(1, &shader.latticeBuffer);
+    glDeleteBuffers(1, &shader.feedbackBuffer);
+    glDeleteBuffers(1, &shader.cameraBuffer);
+    glDeleteBuffers(3, shader.bodyBuffers);
+    glDeleteTextures(3, shader.bodyTextures);
+    glDeleteTextures(1, &shader.profileTexture);
+    glDeleteFramebuffers(1, &shader.framebuffer);
+    glDeleteRenderbuffers(1, &shader.colorBuffer);
+}
+
+// Runs the shader over the flat gridSize lattice with bodies binned as bins; returns each
+// vertex's gl_Position as xyzw.
+std::vector<float> runGridShader(GridShader& shader, const std::vector<Body>& bodies, const BodyBins& bins, float minDeformation, bool fromVertexId) {
+    int gridSize = bins.gridSize;
+    std::vector<float> texels;
+    for (const Body& body : bodies) {
+        texels.insert(texels.end(), { body.x, body.z, body.radius, body.strength });
+    }
+    const void* data[3] = { texels.data(), bins.tileStart.data(), bins.bodyIndices.data() };
+    size_t sizes[3] = { texels.size() * sizeof(float), bins.tileStart.size() * sizeof(int), bins.bodyIndices.size() * sizeof(int) };
+    for (int i = 0; i < 3; ++i) {
+        glBindBuffer(GL_TEXTURE_BUFFER, shader.bodyBuffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(sizes[i], 16), nullptr, GL_STREAM_DRAW);
+        if (sizes[i] > 0) {
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, sizes[i], data[i]);
+        }
+    }
+
+    glUniform1i(shader.location("gridSize"), gridSize);
+    glUniform1i(shader.location("tilesPerSide"), bins.tilesPerSide);
+    glUniform1f(shader.location("farField"), bins.farField);
+    glUniform1f(shader.location("minDeformation"), minDeformation);
+    glUniform1i(shader.location("latticeFromVertexId"), fromVertexId);
+
+    int count = gridSize * gridSize;
+    glBindVertexArray(shader.vao);
+    if (fromVertexId) {
+        glDisableVertexAttribArray(0);
+    }
+    else {
+        std::vector<float> flat((size_t)count * 3);
+        for (int z = 0; z < gridSize; ++z) {
+            for (int x = 0; x < gridSize; ++x) {
+                float* vertex = &flat[((size_t)z * gridSize + x) * 3];
+                vertex[0] = gridCoordinate(x, gridSize);
+                vertex[1] = 0.0f;
+                vertex[2] = gridCoordinate(z, gridSize);
+            }
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, shader.latticeBuffer);
+        glBufferData(GL_ARRAY_BUFFER, flat.size() * sizeof(float), flat.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+    }
+
+    std::vector<float> positions((size_t)count * 4);
+    glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, shader.feedbackBuffer);
+    glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, positions.size() * sizeof(float), nullptr, GL_STREAM_READ);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, shader.feedbackBuffer);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, count);
+    glEndTransformFeedback();
+    glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, positions.size() * sizeof(float), positions.data());
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR) {
+        std::printf("GL error 0x%04x running the grid shader\n", error);
+    }
+    return positions;
+}
+
+// Compares the shader's vertices with the CPU's xyz vertices; prints one line either way.
+bool compare(const char* label, int gridSize, const std::vector<Body>& bodies, const std::vector<float>& expected, float tolerance, GridShader& shader,
+    const BodyBins& bins, float minDeformation) {
+    float worst = 0.0f;
+    int skipped = 0;
+    for (bool fromVertexId : { false, true }) {
+        std::vector<float> positions = runGridShader(shader, bodies, bins, minDeformation, fromVertexId);
+        for (int v = 0; v < gridSize * gridSize; ++v) {
+            const float* cpu = &expected[(size_t)v * 3];
+            const float* gpu = &positions[(size_t)v * 4];
+            bool nearRim = false;
+            for (const Body& body : bodies) {
+                float distX = cpu[0] - body.x;
+                float distZ = cpu[2] - body.z;
+                float influence = body.radius * 2.5f;
+                nearRim = nearRim || std::fabs((distX * distX + distZ * distZ) / (influence * influence) - 1.0f) < RIM_BAND;
+            }
+            if (nearRim) {
+                skipped += fromVertexId ? 0 : 1;
+                continue;
+            }
+            float positionError = std::max(std::fabs(gpu[0] - cpu[0]), std::fabs(gpu[2] - cpu[2]));
+            float heightError = std::fabs(gpu[1] - cpu[1]);
+            worst = std::max(worst, heightError);
+            if (positionError > 1e-5f * GRID_SCALE || heightError > tolerance) {
+                std::printf("FAIL grid %d %s: vertex %d (%s) at (%g, %g) y %g, CPU (%g, %g) y %g\n",
+                    gridSize, label, v, fromVertexId ? "gl_VertexID" : "aPos", gpu[0], gpu[2], gpu[1], cpu[0], cpu[2], cpu[1]);
+                return false;
+            }
+        }
+    }
+    std::printf("ok   grid %d %s: max height error %.2e (tolerance %.2e), %d rim vertices skipped\n", gridSize, label, worst, tolerance, skipped);
+    return true;
+}
+
+}
+
+int main() {
+    if (!createHeadlessContext()) {
+        std::printf("skip: no OpenGL 3.3 context\n");
+        return SKIP_CODE;
+    }
+    // GLEW built for GLX reports a missing X display under EGL even though the GL entry points loaded fine.
+    GLenum glewStatus = glewInit();
+    if (glewStatus != GLEW_OK && glewStatus != GLEW_ERROR_NO_GLX_DISPLAY) {
+        std::printf("skip: GLEW failed to initialize\n");
+        destroyHeadlessContext();
+        return SKIP_CODE;
+    }
+    std::printf("%s, %s\n", headlessContextKind(), (const char*)glGetString(GL_RENDERER));
+
+    const int gridSizes[] = { 2, 3, 7, 64, 65, 200, 201, 333 };
+    const Case cases[] = {
+        { 0.0f, 0.0f, 5.0f, 0.5f },
+        { 0.0f, 0.0f, 5.0f, 5.0f },
+        { 0.0f, 0.0f, 5.0f, 20.0f },   // deep enough to hit the minDeformation floor
+        { 3.3f, -7.1f, 2.0f, 8.0f },   // off the lattice points
+        { 95.0f, 90.0f, 8.0f, 5.0f },  // well partly off the grid
+    };
+    // Wells in several tiles, two of them overlapping, for the bins' tile lookup.
+    const std::vector<Body> scattered = {
+        { 0.0f, 0.0f, 5.0f, 5.0f }, { 12.0f, 3.0f, 3.0f, 2.0f }, { -60.0f, 40.0f, 6.0f, 1.5f },
+        { 70.0f, -75.0f, 4.0f, 3.0f }, { -20.0f, -88.0f, 2.5f, 0.8f },
+    };
+    const float minDeformation = -5.0f;
+    ProfileTable table(RadialProfile::Softened);
+    ThreadPool pool;
+
+    GridShader shader;
+    if (!buildGridShader(shader, table)) {
+        destroyGridShader(shader);
+        destroyHeadlessContext();
+        return 1;
+    }
+
+    int failures = 0;
+    std::vector<float> vertices;
+    for (int gridSize : gridSizes) {
+        for (const Case& c : cases) {
+            generateGrid(vertices, c.x, c.z, c.radius, c.strength, minDeformation, gridSize, pool);
+            std::vector<Body> bodies = { { c.x, c.z, c.radius, c.strength } };
+            BodyBins bins;
+            binBodies(bodies, gridSize, bins);
+            char label[96];
+            std::snprintf(label, sizeof(label), "body (%g, %g) r %g s %g", c.x, c.z, c.radius, c.strength);
+            if (!compare(label, gridSize, bodies, vertices, SHADER_TOLERANCE_PER_STRENGTH * c.strength, shader, bins, minDeformation)) {
+                ++failures;
+            }
+        }
+
+        BodyBins bins;
+        binBodies(scattered, gridSize, bins);
+        bins.profile = &table;
+        generateField(vertices, scattered, bins, minDeformation, pool);
+        float strengths = 0.0f;
+        for (const Body& body : scattered) {
+            strengths += body.strength;
+        }
+        if (!compare("scattered bodies", gridSize, scattered, vertices, SHADER_TOLERANCE_PER_STRENGTH * strengths, shader, bins, minDeformation)) {
+            ++failures;
+        }
+    }
+
+    destroyGridShader(shader);
+    destroyHeadlessContext();
+    std::printf("%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,79 @@
+// Checks computeLowestGridY() against the full scan computeLowestGridYScan(), bit for bit.
+//
+// curvature.h promises the O(1) answer is exactly the scan's. Random bodies, on and off the
+// grid, some centred on a lattice vertex or halfway between two, with radii from a fraction
+// of a cell to most of the grid, masses of both signs (negative ones take the scan), floors
+// from none to shallower than the well, at grid sizes from 2 to MAX_CHECKED_SIZE.
+//
+//   spacetime-test-lowest-grid-y
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+
+#include "curvature.h"
+
+namespace {
+
+const int CASE_COUNT = 2400;
+const int MAX_CHECKED_SIZE = 333;
+
+uint32_t floatBits(float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof bits);
+    return bits;
+}
+
+}
+
+int main() {
+    std::mt19937 random(2002);
+    std::uniform_int_distribution<int> sizes(2, MAX_CHECKED_SIZE);
+    std::uniform_real_distribution<float> positions(-1.2f * GRID_SCALE, 1.2f * GRID_SCALE);
+    std::uniform_real_distribution<float> logRadii(std::log(0.05f), std::log(40.0f));
+    std::uniform_real_distribution<float> masses(-20.0f, 50.0f);
+    std::uniform_real_distribution<float> floors(-30.0f, 0.0f);
+    std::uniform_int_distribution<int> kinds(0, 3);
+
+    int failures = 0;
+    int negative = 0;
+    for (int i = 0; i < CASE_COUNT; ++i) {
+        int gridSize = sizes(random);
+        float x = positions(random);
+        float z = positions(random);
+        // A quarter of the bodies sit exactly on a lattice vertex and a quarter halfway between
+        // two, where the nearest vertex is decided by rounding.
+        int placement = kinds(random);
+        if (placement <= 1 && gridSize > 2) {
+            std::uniform_int_distribution<int> vertices(0, gridSize - 2);
+            int vx = vertices(random), vz = vertices(random);
+            x = gridCoordinate(vx, gridSize);
+            z = gridCoordinate(vz, gridSize);
+            if (placement == 1) {
+                x = 0.5f * (x + gridCoordinate(vx + 1, gridSize));
+                z = 0.5f * (z + gridCoordinate(vz + 1, gridSize));
+            }
+        }
+        float radius = std::exp(logRadii(random));
+        float mass = masses(random);
+        int floorKind = kinds(random);
+        float minDeformation = floorKind == 0 ? -std::numeric_limits<float>::infinity() : floorKind == 1 ? -5.0f : floors(random);
+        negative += mass < 0.0f;
+
+        float fast = computeLowestGridY(x, z, radius, mass, minDeformation, gridSize);
+        float scan = computeLowestGridYScan(x, z, radius, mass, minDeformation, gridSize);
+        if (floatBits(fast) != floatBits(scan)) {
+            std::printf("FAIL grid %d body (%.9g, %.9g) r %.9g s %.9g floor %.9g: computeLowestGridY %.9g, scan %.9g\n",
+                gridSize, x, z, radius, mass, minDeformation, fast, scan);
+            ++failures;
+        }
+    }
+    if (!failures) {
+        std::printf("ok   %d cases (%d with negative mass) identical to the scan\n", CASE_COUNT, negative);
+    }
+    std::printf("%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
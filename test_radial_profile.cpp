@@ -0,0 +1,121 @@
+// Checks the baked profile tables against the exact profiles they stand for.
+//
+// Every profile's ProfileTable::maxError() must be under ProfileTable::MAX_ERROR. Then
+// accumulateBodyRowTable() is run with each table kernel the CPU has (the scalar loop and the
+// AVX2 gathers) and must stay within MAX_ERROR * strength of the exact well:
+// radialProfileDepth() for every profile, and for the softened one also the analytic kernel
+// curvature.h and accumulateBodyRow() evaluate.
+//
+//   spacetime-test-radial-profile
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "curvature.h"
+#include "grid_kernel.h"
+#include "radial_profile.h"
+
+namespace {
+
+// accumulateBodyRow() tests the rim on the distance, the table kernels on its square; within
+// this much of u = 1 the two may disagree about a vertex, and it is left out of that check.
+const float RIM_BAND = 1e-5f;
+
+struct Case {
+    float x, z, radius, strength;
+};
+
+// Worst error of accumulateBodyRowTable() on one row, per unit strength; prints the first vertex
+// over the bound.
+double checkRow(const ProfileTable& table, const Case& c, float zPos, const std::vector<float>& xs, const char* kernel) {
+    int count = (int)xs.size();
+    std::vector<float> deformation(count, 0.0f), covered(count, 0.0f);
+    std::vector<float> analytic(count, 0.0f), analyticCovered(count, 0.0f);
+    accumulateBodyRowTable(xs.data(), zPos, count, c.x, c.z, c.radius, c.strength, table, deformation.data(), covered.data());
+    accumulateBodyRow(xs.data(), zPos, count, c.x, c.z, c.radius, c.strength, analytic.data(), analyticCovered.data());
+
+    float influence = c.radius * 2.5f;
+    float distZ = zPos - c.z;
+    double bound = ProfileTable::MAX_ERROR * c.strength;
+    double worst = 0.0;
+    for (int i = 0; i < count; ++i) {
+        float distX = xs[i] - c.x;
+        float u = (distX * distX + distZ * distZ) * (1.0f / (influence * influence));
+        bool inside = u < 1.0f;
+        double expected = inside ? -c.strength * radialProfileDepth(table.profile(), u) : 0.0;
+        double expectedCovered = inside ? -c.strength * 0.1f : 0.0;
+        double error = std::fabs(deformation[i] - expected);
+        if (table.profile() == RadialProfile::Softened && std::fabs(u - 1.0f) >= RIM_BAND) {
+            error = std::max(error, (double)std::fabs(deformation[i] - analytic[i]));
+            expectedCovered = analyticCovered[i];
+        }
+        if (error > bound || covered[i] != (float)expectedCovered) {
+            std::printf("FAIL %s %s body (%g, %g) r %g s %g at (%.9g, %.9g): u %.9g, table %.9g, exact %.9g, analytic kernel %.9g, covered far field %g\n",
+                radialProfileName(table.profile()), kernel, c.x, c.z, c.radius, c.strength, xs[i], zPos, u, deformation[i], expected, analytic[i], covered[i]);
+            return std::max(error, bound * 2.0) / c.strength;
+        }
+        worst = std::max(worst, error / c.strength);
+    }
+    return worst;
+}
+
+}
+
+int main() {
+    const RadialProfile profiles[] = { RadialProfile::Softened, RadialProfile::Plummer, RadialProfile::Flamm };
+    const Case cases[] = {
+        { 0.0f, 0.0f, 5.0f, 1.0f },
+        { 3.3f, -7.1f, 2.0f, 8.0f },
+        { -61.7f, 42.25f, 11.5f, 0.37f },
+    };
+    // accumulateBodyRowTable() has a scalar loop and AVX2 gathers; SSE4.1 uses the scalar loop.
+    const char* kernels[] = { "scalar", "avx2" };
+
+    int failures = 0;
+    for (RadialProfile profile : profiles) {
+        ProfileTable table(profile);
+        if (!(table.maxError() < ProfileTable::MAX_ERROR)) {
+            std::printf("FAIL %s: maxError() %.3e, bound %.1e\n", radialProfileName(profile), table.maxError(), ProfileTable::MAX_ERROR);
+            ++failures;
+        }
+        else {
+            std::printf("ok   %s: maxError() %.3e (bound %.1e)\n", radialProfileName(profile), table.maxError(), ProfileTable::MAX_ERROR);
+        }
+
+        for (const char* kernel : kernels) {
+            if (!forceGridKernel(kernel)) {
+                std::printf("skip %s %s: not supported by this CPU\n", radialProfileName(profile), kernel);
+                continue;
+            }
+            std::mt19937 random(2024);
+            double worst = 0.0;
+            for (const Case& c : cases) {
+                float influence = c.radius * 2.5f;
+                std::uniform_real_distribution<float> acrossDisk(-influence * 1.2f, influence * 1.2f);
+                // Rows across the disk, through its centre and grazing its rim; odd lengths so the
+                // gather loop leaves a scalar tail.
+                for (float zOffset : { 0.0f, influence * 0.5f, influence * 0.999f, acrossDisk(random), acrossDisk(random) }) {
+                    std::vector<float> xs;
+                    for (int i = 0; i < 203; ++i) {
+                        xs.push_back(c.x + acrossDisk(random));
+                    }
+                    xs.push_back(c.x);
+                    xs.push_back(c.x + influence);
+                    xs.push_back(c.x - influence);
+                    worst = std::max(worst, checkRow(table, c, c.z + zOffset, xs, kernel));
+                }
+            }
+            if (worst > ProfileTable::MAX_ERROR) {
+                ++failures;
+            }
+            else {
+                std::printf("ok   %s %s: worst error %.3e per unit strength\n", radialProfileName(profile), kernel, worst);
+            }
+        }
+    }
+    std::printf("%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
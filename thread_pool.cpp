@@ -0,0 +1,93 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threadCount) {
+    if (threadCount <= 0) {
+        threadCount = (int)std::max(1u, std::thread::hardware_concurrency());
+    }
+    participants = threadCount;
+    queues.reset(new BlockQueue[participants]);
+
+    for (int i = 1; i < participants; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::run(int count, int blockSize, BlockFn fn, void* context) {
+    if (count <= 0) {
+        return;
+    }
+    blockSize = std::max(1, blockSize);
+    int blocks = (count + blockSize - 1) / blockSize;
+
+    if (participants == 1 || blocks == 1) {
+        for (int begin = 0; begin < count; begin += blockSize) {
+            fn(context, 0, begin, std::min(count, begin + blockSize));
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobFn = fn;
+        jobContext = context;
+        jobCount = count;
+        jobBlockSize = blockSize;
+        for (int i = 0; i < participants; ++i) {
+            queues[i].next.store((int)((long long)blocks * i / participants), std::memory_order_relaxed);
+            queues[i].end = (int)((long long)blocks * (i + 1) / participants);
+        }
+        finishedWorkers.store(0, std::memory_order_relaxed);
+        ++generation;
+    }
+    wake.notify_all();
+
+    drain(0);
+
+    while (finishedWorkers.load(std::memory_order_acquire) < participants - 1) {
+        std::this_thread::yield();
+    }
+}
+
+void ThreadPool::drain(int participant) {
+    for (int offset = 0; offset < participants; ++offset) {
+        BlockQueue& queue = queues[(participant + offset) % participants];
+        for (;;) {
+            int block = queue.next.fetch_add(1, std::memory_order_relaxed);
+            if (block >= queue.end) {
+                break;
+            }
+            int begin = block * jobBlockSize;
+            jobFn(jobContext, participant, begin, std::min(jobCount, begin + jobBlockSize));
+        }
+    }
+}
+
+void ThreadPool::workerLoop(int participant) {
+    unsigned seenGeneration = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping) {
+                return;
+            }
+            seenGeneration = generation;
+        }
+
+        drain(participant);
+        finishedWorkers.fetch_add(1, std::memory_order_release);
+    }
+}
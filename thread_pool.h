@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Persistent pool of worker threads for data-parallel loops.
+//
+// parallelFor() splits [0, count) into blocks of blockSize and deals them out as one
+// contiguous run of blocks per participant. A participant that finishes its own run steals
+// the remaining blocks of the others, so uneven blocks still balance. The calling thread
+// takes part as participant 0 and the call returns once every block has run. Calls must not
+// be nested or issued concurrently from several threads.
+class ThreadPool {
+public:
+    // threadCount counts the calling thread; 0 picks std::thread::hardware_concurrency().
+    explicit ThreadPool(int threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return participants; }
+
+    // Calls task(participant, begin, end) for each block; participant is in [0, size()).
+    template <typename Task>
+    void parallelFor(int count, int blockSize, Task&& task) {
+        typedef typename std::remove_reference<Task>::type TaskType;
+        BlockFn invoke = [](void* context, int participant, int begin, int end) {
+            (*static_cast<TaskType*>(context))(participant, begin, end);
+        };
+        run(count, blockSize, invoke, const_cast<void*>(static_cast<const void*>(&task)));
+    }
+
+private:
+    typedef void (*BlockFn)(void*, int, int, int);
+
+    struct alignas(64) BlockQueue {
+        std::atomic<int> next{ 0 };
+        int end = 0;
+    };
+
+    void run(int count, int blockSize, BlockFn fn, void* context);
+    void drain(int participant);
+    void workerLoop(int participant);
+
+    int participants;
+    std::unique_ptr<BlockQueue[]> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    unsigned generation = 0;
+    bool stopping = false;
+    std::atomic<int> finishedWorkers{ 0 };
+
+    BlockFn jobFn = nullptr;
+    void* jobContext = nullptr;
+    int jobCount = 0;
+    int jobBlockSize = 1;
+};
+
+// Lowers target to value if value is smaller. parallelFor blocks combine their minimums
+// through this instead of a per-participant array, so a call needs no heap.
+inline void atomicMin(std::atomic<float>& target, float value) {
+    float current = target.load(std::memory_order_relaxed);
+    while (value < current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
@@ -0,0 +1,117 @@
+#include "transform.h"
+
+#include <cmath>
+
+void identityMatrix(float result[16]) {
+    for (int i = 0; i < 16; ++i) {
+        result[i] = i % 5 == 0 ? 1.0f : 0.0f;
+    }
+}
+
+void multiplyMatrix(const float a[16], const float b[16], float result[16]) {
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            result[i * 4 + j] = 0.0f;
+            for (int k = 0; k < 4; ++k) {
+                result[i * 4 + j] += a[i * 4 + k] * b[k * 4 + j];
+            }
+        }
+    }
+}
+
+void perspectiveMatrix(float fovY, float aspectRatio, float nearZ, float farZ, float result[16]) {
+    float tanHalfFovY = tan(fovY / 2.0f);
+    float range = farZ - nearZ;
+
+    result[0] = 1.0f / (aspectRatio * tanHalfFovY);
+    result[1] = 0.0f;
+    result[2] = 0.0f;
+    result[3] = 0.0f;
+
+    result[4] = 0.0f;
+    result[5] = 1.0f / tanHalfFovY;
+    result[6] = 0.0f;
+    result[7] = 0.0f;
+
+    result[8] = 0.0f;
+    result[9] = 0.0f;
+    result[10] = -((farZ + nearZ) / range);
+    result[11] = -1.0f;
+
+    result[12] = 0.0f;
+    result[13] = 0.0f;
+    result[14] = -((2.0f * farZ * nearZ) / range);
+    result[15] = 0.0f;
+}
+
+void lookAtMatrix(float eyeX, float eyeY, float eyeZ, float centerX, float centerY, float centerZ, float upX, float upY, float upZ, float result[16]) {
+    float forward[3];
+    forward[0] = centerX - eyeX;
+    forward[1] = centerY - eyeY;
+    forward[2] = centerZ - eyeZ;
+
+    float forwardLength = sqrt(forward[0] * forward[0] + forward[1] * forward[1] + forward[2] * forward[2]);
+    forward[0] /= forwardLength;
+    forward[1] /= forwardLength;
+    forward[2] /= forwardLength;
+
+    float right[3];
+    right[0] = upY * forward[2] - upZ * forward[1];
+    right[1] = upZ * forward[0] - upX * forward[2];
+    right[2] = upX * forward[1] - upY * forward[0];
+
+    float rightLength = sqrt(right[0] * right[0] + right[1] * right[1] + right[2] * right[2]);
+    right[0] /= rightLength;
+    right[1] /= rightLength;
+    right[2] /= rightLength;
+
+    float up[3];
+    up[0] = forward[1] * right[2] - forward[2] * right[1];
+    up[1] = forward[2] * right[0] - forward[0] * right[2];
+    up[2] = forward[0] * right[1] - forward[1] * right[0];
+
+    result[0] = right[0];
+    result[1] = up[0];
+    result[2] = -forward[0];
+    result[3] = 0.0f;
+
+    result[4] = right[1];
+    result[5] = up[1];
+    result[6] = -forward[1];
+    result[7] = 0.0f;
+
+    result[8] = right[2];
+    result[9] = up[2];
+    result[10] = -forward[2];
+    result[11] = 0.0f;
+
+    result[12] = -(right[0] * eyeX + right[1] * eyeY + right[2] * eyeZ);
+    result[13] = -(up[0] * eyeX + up[1] * eyeY + up[2] * eyeZ);
+    result[14] = -(-forward[0] * eyeX - forward[1] * eyeY - forward[2] * eyeZ);
+    result[15] = 1.0f;
+}
+
+void extractFrustumPlanes(const float clip[16], float planes[6][4]) {
+    // Row r of the matrix is clip[r], clip[4 + r], clip[8 + r], clip[12 + r]; the planes are
+    // row 3 plus or minus rows 0 (left, right), 1 (bottom, top) and 2 (near, far).
+    for (int p = 0; p < 6; ++p) {
+        int row = p / 2;
+        float sign = (p % 2 == 0) ? 1.0f : -1.0f;
+        for (int c = 0; c < 4; ++c) {
+            planes[p][c] = clip[c * 4 + 3] + sign * clip[c * 4 + row];
+        }
+    }
+}
+
+bool boxInFrustum(const float planes[6][4], const float boxMin[3], const float boxMax[3]) {
+    for (int p = 0; p < 6; ++p) {
+        // The corner furthest along the plane normal.
+        float x = planes[p][0] >= 0.0f ? boxMax[0] : boxMin[0];
+        float y = planes[p][1] >= 0.0f ? boxMax[1] : boxMin[1];
+        float z = planes[p][2] >= 0.0f ? boxMax[2] : boxMin[2];
+        if (planes[p][0] * x + planes[p][1] * y + planes[p][2] * z + planes[p][3] < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
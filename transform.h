@@ -0,0 +1,16 @@
+#pragma once
+
+const float PI = 3.14159265358979323846f;
+
+// Column-major 4x4 matrices in the layout glUniformMatrix4fv expects with transpose = GL_FALSE.
+
+void identityMatrix(float result[16]);
+void multiplyMatrix(const float a[16], const float b[16], float result[16]);
+void perspectiveMatrix(float fovY, float aspectRatio, float nearZ, float farZ, float result[16]);
+void lookAtMatrix(float eyeX, float eyeY, float eyeZ, float centerX, float centerY, float centerZ, float upX, float upY, float upZ, float result[16]);
+
+// Planes (a, b, c, d) of the frustum of a column-major clip matrix, with a point inside when
+// a * x + b * y + c * z + d >= 0 for all six (Gribb-Hartmann extraction).
+void extractFrustumPlanes(const float clip[16], float planes[6][4]);
+// False only when the axis-aligned box lies entirely outside one of the planes.
+bool boxInFrustum(const float planes[6][4], const float boxMin[3], const float boxMax[3]);
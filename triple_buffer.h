@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+
+// Single-producer, single-consumer triple buffer. The producer fills back() and publish()es
+// it; the consumer's acquire() takes the newest published slot if there is one. Neither side
+// ever waits: a publish swaps the back slot with the shared middle one, an acquire swaps the
+// middle with the front, each a single atomic exchange. Frames the consumer was too slow to
+// take are overwritten. Slots are reused, so vectors inside T keep their capacity.
+template <typename T>
+class TripleBuffer {
+public:
+    T& back() { return slots[backIndex]; }
+    const T& front() const { return slots[frontIndex]; }
+    // Any of the three slots, for sizing them up front before either side starts.
+    T& slot(int index) { return slots[index]; }
+
+    void publish() {
+        backIndex = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Returns true when a newer slot became the front.
+    bool acquire() {
+        if (!(middle.load(std::memory_order_acquire) & FRESH)) {
+            return false;
+        }
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+private:
+    static const int INDEX = 3;
+    static const int FRESH = 4;
+
+    T slots[3];
+    std::atomic<int> middle{ 1 };
+    int backIndex = 0;    // producer only
+    int frontIndex = 2;   // consumer only
+};
@@ -0,0 +1,82 @@
+#include "vertex_format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t magnitude = bits & 0x7fffffff;
+
+    if (magnitude >= 0x7f800000) {
+        // Infinity stays infinity; NaN keeps a quiet payload bit.
+        return (uint16_t)(sign | 0x7c00 | (magnitude > 0x7f800000 ? 0x200 : 0));
+    }
+    if (magnitude >= 0x477ff000) {
+        // 65520 and up round past the largest half, 65504.
+        return (uint16_t)(sign | 0x7c00);
+    }
+    if (magnitude < 0x38800000) {
+        // Below 2^-14 the half is subnormal: round(value / 2^-24).
+        if (magnitude < 0x33000000) {
+            return (uint16_t)sign;
+        }
+        int shift = 126 - (int)(magnitude >> 23);
+        uint32_t mantissa = (magnitude & 0x7fffff) | 0x800000;
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1))) {
+            ++half;
+        }
+        return (uint16_t)(sign | half);
+    }
+
+    // Rebias the exponent and drop 13 mantissa bits; a carry out of the mantissa correctly
+    // bumps the exponent.
+    uint32_t half = (magnitude - 0x38000000) >> 13;
+    uint32_t remainder = magnitude & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        ++half;
+    }
+    return (uint16_t)(sign | half);
+}
+
+float halfToFloat(uint16_t half) {
+    uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    uint32_t bits;
+    if (exponent == 0x1f) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else if (exponent != 0) {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    else {
+        float value = std::ldexp((float)mantissa, -24);
+        return sign ? -value : value;
+    }
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void floatsToHalves(const float* values, int count, int stride, uint16_t* halves) {
+    for (int i = 0; i < count; ++i) {
+        halves[i] = floatToHalf(values[i * stride]);
+    }
+}
+
+void quantizePositions(const float* vertices, size_t vertexCount, float scale, std::vector<int16_t>& quantized) {
+    quantized.resize(vertexCount * 4);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        for (int c = 0; c < 3; ++c) {
+            float unit = std::min(1.0f, std::max(-1.0f, vertices[v * 3 + c] / scale));
+            quantized[v * 4 + c] = (int16_t)std::lround(unit * 32767.0f);
+        }
+        quantized[v * 4 + 3] = 0;
+    }
+}
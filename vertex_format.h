@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 16-bit storage for the compact vertex formats (--compact-vertices): grid heights as IEEE
+// half floats, mesh positions as signed normalized shorts.
+
+// Rounds to the nearest half, ties to even; out-of-range values become infinities.
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t half);
+
+// halves[i] = floatToHalf(values[i * stride]).
+void floatsToHalves(const float* values, int count, int stride, uint16_t* halves);
+
+// xyz positions divided by scale (which must bound them) and rounded to signed normalized
+// shorts, four per vertex with w = 0 so each vertex stays 8-byte aligned. Read back with
+// glVertexAttribPointer(GL_SHORT, normalized) and multiplied by scale.
+void quantizePositions(const float* vertices, size_t vertexCount, float scale, std::vector<int16_t>& quantized);